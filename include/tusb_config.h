@@ -1,5 +1,5 @@
 /*
-    default config for printf
+    default config for printf, plus the USB MIDI port (descriptors in src/HAL/UsbDevice.cpp)
  */
 
 #ifndef _PICO_STDIO_USB_TUSB_CONFIG_H
@@ -13,6 +13,11 @@
 #define CFG_TUD_CDC_RX_BUFSIZE  (256)
 #define CFG_TUD_CDC_TX_BUFSIZE  (256)
 
+// MIDI clock out; the TX buffer holds a few mS of messages should the host be slow to poll
+#define CFG_TUD_MIDI            (1)
+#define CFG_TUD_MIDI_RX_BUFSIZE (64)
+#define CFG_TUD_MIDI_TX_BUFSIZE (128)
+
 // We use a vendor specific interface but with our own driver
 #define CFG_TUD_VENDOR            (0)
 #endif
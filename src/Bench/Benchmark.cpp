@@ -0,0 +1,3251 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//Host-side timing benchmark for the clock engine. Built by env:native only (pio run -e native).
+//Drives Chronos::FastUpdate at the same 40uS cadence as audio_rate_callback in main.cpp, with the CV rate
+//update running every 1mS of simulated time, and reports the wall-clock cost of each fast tick.
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdio.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "HAL/HAL.hpp"
+#include "Chronos.hpp"
+#include "IO/IOHelper.hpp"
+#include "IO/GateSequencer.hpp"
+#include "Util/SnapshotMailbox.hpp"
+#include "Util/CVFilter.hpp"
+#include "IO/Calibration.hpp"
+#include "IO/MidiOut.hpp"
+#include "Util/TraceLog.hpp"
+#include "TraceEvents.h"
+
+#define BENCH_TICK_US 40
+#define BENCH_SLOW_US 1000
+
+/// @brief Checks failed across every section; main returns non-zero if any did
+static uint32_t benchFailures = 0;
+
+/// @brief Counts a failed check
+/// @return what the check's row prints for it
+static const char *BenchVerdict(bool isOk, const char *failed = "WRONG")
+{
+    if(!isOk) benchFailures++;
+    return isOk ? "ok" : failed;
+}
+
+/// Tick cost histogram resolution; anything above the last bucket lands in it
+#define BENCH_HIST_NS_PER_BUCKET 10
+#define BENCH_HIST_BUCKETS 10'000
+
+/// @brief Describes one simulated patch
+struct BenchScenario
+{
+    const char *name;
+    /// @brief Raw BPM knob ADC value (0-4095, 4095 = 200BPM)
+    uint16_t bpmKnob;
+    /// @brief Raw swing knob ADC value (0-4095)
+    uint16_t swingKnob;
+    /// @brief Time between CLOCK IN pulses in microseconds, 0 for no external clock
+    uint32_t clockPeriodUs;
+    /// @brief Simulated run length in seconds
+    uint32_t seconds;
+};
+
+/// @brief Timing results of one scenario
+struct BenchResult
+{
+    uint64_t ticks = 0;
+    double totalNs = 0;
+    double worstNs = 0;
+    /// @brief Tick cost histogram, used for percentiles. The worst case on a desktop OS is mostly scheduler noise.
+    uint32_t histogram[BENCH_HIST_BUCKETS] = {};
+
+    double Percentile(double fraction) const
+    {
+        uint64_t target = uint64_t(ticks * fraction);
+        uint64_t seen = 0;
+        for(int i = 0; i < BENCH_HIST_BUCKETS; i++)
+        {
+            seen += histogram[i];
+            if(seen > target) return double(i + 1) * BENCH_HIST_NS_PER_BUCKET;
+        }
+        return worstNs;
+    }
+};
+
+static void RunScenario(const BenchScenario &scenario, BenchResult &result)
+{
+    using Clock = std::chrono::steady_clock;
+
+    Chronos chronos;
+    IOHelper io;
+
+    //--------Power on the simulated panel--------
+    HALSim::Reset();
+    io.Init();
+    HALSim::SetPin(GPIO_PLAY, true);    //all panel inputs are active low with pull-ups
+    HALSim::SetPin(GPIO_CLK, true);
+    HALSim::SetPin(GPIO_RST, true);
+    HALSim::SetPin(GPIO_TMULT_A, true);
+    HALSim::SetPin(GPIO_TMULT_B, true);
+    HALSim::SetAdcChannel(0, scenario.swingKnob);
+    HALSim::SetAdcChannel(1, scenario.bpmKnob);
+    HALSim::SetAdcChannel(2, 2048);     //UD knob, mid position
+    HALSim::SetAdcChannel(3, 2300);     //CVs unpatched (0V)
+    HALSim::SetAdcChannel(4, 2300);
+    HALSim::SetAdcChannel(5, 2300);
+    HALSim::SetAdcChannel(6, 36);
+    io.StartAdcScan();
+
+    chronos.Init(&io);
+    chronos.SetBPM(120);
+    chronos.isPlayMode = true;
+
+    //--------Run--------
+    uint64_t endMicros = uint64_t(scenario.seconds) * 1'000'000;
+    uint64_t nextSlowMicros = 0;
+    uint64_t nextClockMicros = 0;
+    uint64_t lastClockMicros = 0;
+    while(HAL::TimeMicros() < endMicros)
+    {
+        uint64_t now = HAL::TimeMicros();
+
+        //external clock: release the 2mS active-low pulse
+        if(scenario.clockPeriodUs > 0 && now >= lastClockMicros + 2000) HALSim::SetPin(GPIO_CLK, true);
+
+        if(now >= nextSlowMicros)
+        {
+            io.ReadSlowInputs(BENCH_SLOW_US);
+            chronos.SlowUpdate(BENCH_SLOW_US);
+            io.WriteSlowOutputs(BENCH_SLOW_US);
+            nextSlowMicros += BENCH_SLOW_US;
+        }
+
+        Clock::time_point start = Clock::now();
+        io.ReadFastInputs(BENCH_TICK_US);
+        chronos.FastUpdate(BENCH_TICK_US);
+        io.WriteFastOutputs(BENCH_TICK_US);
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        result.ticks++;
+        result.totalNs += ns;
+        if(ns > result.worstNs) result.worstNs = ns;
+        result.histogram[min(int(ns / BENCH_HIST_NS_PER_BUCKET), BENCH_HIST_BUCKETS - 1)]++;
+
+        //external clock: the edge lands between ticks at its exact microsecond, like the hardware edge interrupt
+        if(scenario.clockPeriodUs > 0 && nextClockMicros < now + BENCH_TICK_US)
+        {
+            HALSim::AdvanceMicros(nextClockMicros - now);
+            HALSim::SetPin(GPIO_CLK, false);
+            lastClockMicros = nextClockMicros;
+            nextClockMicros += scenario.clockPeriodUs;
+        }
+        HALSim::AdvanceMicros(now + BENCH_TICK_US - HAL::TimeMicros());
+    }
+}
+
+//-------- Tempo Estimator: per-pulse cost --------
+
+#define BENCH_PULSES 1'000'000
+
+/// @brief The original 32-slot float estimator from Chronos::AddBeatToBPMEstimate, kept as a baseline (minus the printf)
+struct LegacyBPMEstimate
+{
+    uint64_t clockInDiffBuffer[CLOCKIN_BUFFER_SIZE] = {};
+    uint16_t clockInDiffBufferIterator = 0;
+    float estimatedBPM = 120;
+
+    void AddInterval(uint64_t interval)
+    {
+        clockInDiffBuffer[clockInDiffBufferIterator] = interval;
+        clockInDiffBufferIterator++;
+        if(clockInDiffBufferIterator >= CLOCKIN_BUFFER_SIZE) clockInDiffBufferIterator = 0;
+        int elementsAveraged = 0;
+        float average = 0;
+        for(int i = 0; i < CLOCKIN_BUFFER_SIZE; i++)
+        {
+            if(clockInDiffBuffer[i] == 0) continue;
+            average += clockInDiffBuffer[i]/1'000'000.0f;
+            elementsAveraged++;
+        }
+        average /= (double)elementsAveraged;
+        estimatedBPM = (1.0f/average) * (60.0f/24.0f)*0.9999f;
+    }
+};
+
+/// @brief 120BPM at 24PPQN with +-50uS of jitter
+static uint32_t JitteredInterval(uint32_t &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return 20'833 - 50 + (seed >> 16) % 101;
+}
+
+template <typename Estimator>
+static double TimeEstimator(Estimator &estimator)
+{
+    using Clock = std::chrono::steady_clock;
+    uint32_t seed = 1;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < BENCH_PULSES; i++)
+    {
+        estimator.AddInterval(JitteredInterval(seed));
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_PULSES;
+}
+
+static void RunEstimatorBenchmark()
+{
+    static LegacyBPMEstimate legacy;
+    static TempoEstimator<CLOCKIN_BUFFER_SIZE> estimator;
+    estimator.Clear();
+
+    double legacyNs = TimeEstimator(legacy);
+    double estimatorNs = TimeEstimator(estimator);
+    float estimatorBPM = 16.0f * 60'000'000.0f / (float(estimator.GetPeriodMicros16()) * 24.0f) * 0.9999f;
+
+    printf("\n%-28s %12s %12s\n", "tempo estimator", "ns/pulse", "BPM");
+    printf("%-28s %12.1f %12.3f\n", "legacy float loop", legacyNs, legacy.estimatedBPM);
+    printf("%-28s %12.1f %12.3f\n", "TempoEstimator", estimatorNs, estimatorBPM);
+
+    //a stalled clock clamps every interval to the longest stored; a full window of them must not wrap the x16 sum
+    estimator.Clear();
+    for(int i = 0; i < CLOCKIN_BUFFER_SIZE; i++) estimator.AddInterval(UINT32_MAX);
+    uint32_t expected16 = TempoEstimator<CLOCKIN_BUFFER_SIZE>::MAX_INTERVAL << 4;
+    printf("\n%-28s %12s %12s\n", "longest interval", "period uS", "expected");
+    printf("%-28s %12u %12u %12s\n", "full window, clamped", estimator.GetPeriodMicros16() >> 4, expected16 >> 4,
+        BenchVerdict(estimator.GetPeriodMicros16() == expected16));
+}
+
+//-------- PLL: lock time and residual phase error --------
+
+/// Phase error against the jitter-free clock (RMS, once locked) a follower must stay within
+#define BENCH_PLL_RMS_US 500
+/// Worst phase error once locked; past this a doubled hit starts to sound like a flam
+#define BENCH_PLL_WORST_US 2000
+/// Pulses a tempo step may take to relock: the ones thrown away, the one that re-measures, PLL_LOCK_PULSES clean
+/// ones, and two more for where the step falls between pulses
+#define BENCH_PLL_RELOCK_PULSES (PLL_GLITCH_PULSES + 1 + PLL_LOCK_PULSES + 2)
+/// How far the NCO may end up from the clock's tempo; a tempo readout rounds to whole BPM
+#define BENCH_PLL_BPM_ERROR 0.5
+
+/// @brief Describes one simulated external clock for the PLL
+struct PLLScenario
+{
+    const char *name;
+    uint32_t ppqn;
+    float startBPM;
+    float endBPM;
+    /// @brief Seconds over which the tempo ramps from startBPM to endBPM; 0 steps to endBPM halfway through
+    float rampSeconds;
+    /// @brief Peak uniform jitter added to each edge, in microseconds
+    uint32_t jitterUs;
+    uint32_t seconds;
+};
+
+static void RunPLLScenario(const PLLScenario &scenario)
+{
+    const uint64_t ticksPerPulse = (uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) / scenario.ppqn;
+    PhaseLockedLoop pll;
+    pll.SetTicksPerPulse(ticksPerPulse);
+    pll.Start(uint32_t((uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) * uint64_t(scenario.startBPM) / 60'000'000));
+
+    uint32_t seed = 7;
+    int32_t jitter = 0;             //jitter of the edge in flight
+    double idealEdge = 0;           //edge time without jitter
+    uint64_t nextEdge = 0;
+    uint64_t endMicros = uint64_t(scenario.seconds) * 1'000'000;
+    double stepMicros = scenario.rampSeconds == 0 && scenario.startBPM != scenario.endBPM ? scenario.seconds * 0.5e6 : -1;
+    uint32_t lastTicks = pll.GetTicks();
+    double ncoTicks = 0;            //NCO phase in ticks, unwrapped
+    double firstEdgeTicks = 0;      //NCO phase at the first edge, where the PLL puts its pulse grid
+    int lockPulse = -1;
+    int stepPulse = -1;
+    int relockPulse = -1;
+    bool isUnlockedSinceStep = false;
+    int pulses = 0;
+    double sumSquares = 0;
+    double worst = 0;
+    int measured = 0;
+    for(uint64_t now = 0; now < endMicros; now += BENCH_TICK_US)
+    {
+        pll.Advance(BENCH_TICK_US);
+        ncoTicks += uint32_t(pll.GetTicks() - lastTicks);
+        lastTicks = pll.GetTicks();
+        if(nextEdge > now) continue;
+
+        pll.OnPulse(nextEdge, now);
+        pulses++;
+
+        double seconds = idealEdge / 1e6;
+        double bpm = scenario.endBPM;
+        if(scenario.rampSeconds > 0 && seconds < scenario.rampSeconds)
+            bpm = scenario.startBPM + (scenario.endBPM - scenario.startBPM) * seconds / scenario.rampSeconds;
+        else if(scenario.rampSeconds == 0 && seconds < scenario.seconds / 2.0)
+            bpm = scenario.startBPM;
+        double periodUs = 60e6 / (bpm * scenario.ppqn);
+
+        //NCO phase at the jitter-free edge against the pulses so far: every pulse counts, thrown away or not, and a
+        //pulse the loop took for a slip is a whole pulse out
+        double edgeTicks = ncoTicks + pll.GetTickFraction() / 4294967296.0 - pll.GetFrequency() / 4294967296.0 * (now - idealEdge);
+        if(pulses == 1) firstEdgeTicks = edgeTicks;
+        double ncoPulses = (edgeTicks - firstEdgeTicks) / (ticksPerPulse / 4294967296.0);
+        double errorUs = (pulses - 1 - ncoPulses) * periodUs;
+
+        if(lockPulse < 0 && pll.IsLocked()) lockPulse = pulses;
+        if(stepPulse < 0 && stepMicros >= 0 && idealEdge >= stepMicros) stepPulse = pulses;
+        if(stepPulse >= 0 && !pll.IsLocked()) isUnlockedSinceStep = true;
+        if(stepPulse >= 0 && relockPulse < 0 && pll.IsLocked() && (isUnlockedSinceStep || pulses > stepPulse + BENCH_PLL_RELOCK_PULSES))
+            relockPulse = pulses;
+        //the pulses between a step and the relock are off by the step itself, which no follower can see coming
+        if(stepPulse < 0 ? lockPulse >= 0 : relockPulse >= 0)
+        {
+            //error against the jitter-free clock, which is what the outputs should follow
+            sumSquares += errorUs * errorUs;
+            if(fabs(errorUs) > worst) worst = fabs(errorUs);
+            measured++;
+        }
+
+        idealEdge += periodUs;
+        seed = seed * 1664525u + 1013904223u;
+        jitter = scenario.jitterUs ? int32_t((seed >> 16) % (2 * scenario.jitterUs + 1)) - int32_t(scenario.jitterUs) : 0;
+        nextEdge = uint64_t(idealEdge + jitter);
+    }
+    double rms = measured ? sqrt(sumSquares / measured) : 0.0;
+    double finalBPM = pll.GetFrequency() * 60e6 / (4294967296.0 * CHRONOS_TICKS_PER_QUARTER);
+    int relockPulses = relockPulse < 0 ? -1 : relockPulse - stepPulse;
+    bool isOk = lockPulse >= 0 && rms <= BENCH_PLL_RMS_US && worst <= BENCH_PLL_WORST_US
+        && fabs(finalBPM - scenario.endBPM) <= BENCH_PLL_BPM_ERROR
+        && (stepPulse < 0 || (relockPulse >= 0 && relockPulses <= BENCH_PLL_RELOCK_PULSES && isUnlockedSinceStep));
+    printf("%-28s %12d %12d %12.2f %12.2f %12.2f %12s\n", scenario.name, lockPulse, relockPulses, rms, worst, finalBPM,
+        BenchVerdict(isOk));
+}
+
+static void RunPLLBenchmark()
+{
+    const PLLScenario scenarios[] =
+    {
+        {"120bpm clean",            24, 120, 120, 0,  0,   60},
+        {"120bpm +-100uS jitter",   24, 120, 120, 0,  100, 60},
+        {"ramp 90-160bpm over 30s", 24, 90,  160, 30, 50,  60},
+        {"step 120-90bpm",          24, 120, 90,  0,  50,  60},
+        {"step 120-180bpm",         24, 120, 180, 0,  50,  60},
+        {"step 120-90bpm 1ppqn",    1,  120, 90,  0,  50,  120},
+        {"step 120-180bpm 1ppqn",   1,  120, 180, 0,  50,  120},
+    };
+    //every pulse is scored against the jitter-free clock once locked, except between a step and the relock after it
+    printf("\n%-28s %12s %12s %12s %12s %12s %12s\n", "pll", "lock pulse", "relock", "rms err uS", "worst uS",
+        "final bpm", "result");
+    for(const PLLScenario &scenario : scenarios)
+    {
+        RunPLLScenario(scenario);
+    }
+}
+
+//-------- Time Base: cumulative drift over 24 hours --------
+
+#define BENCH_DRIFT_SECONDS (24ULL * 60 * 60)
+/// Tick rate of the old 512th note time base, for the legacy column
+#define BENCH_LEGACY_TICKS_PER_QUARTER 128
+
+static void RunDriftBenchmark()
+{
+    const float bpms[] = {1.0f, 60.0f, 165.0f, 199.9f};
+
+    //whole ticks are counted, so up to one tick of the error is just the fraction not yet elapsed; anything past that
+    //is drift
+    printf("\n%-28s %12s %12s %12s %12s\n", "24h drift", "ticks", "error ticks", "legacy ppm", "result");
+    for(float bpm : bpms)
+    {
+        PhaseAccumulator timeBase;
+        timeBase.SetBPM(bpm, CHRONOS_TICKS_PER_QUARTER);
+        uint64_t ticks = 0;
+        for(uint64_t t = 0; t < BENCH_DRIFT_SECONDS * 1'000'000; t += BENCH_TICK_US)
+        {
+            ticks += timeBase.Advance(BENCH_TICK_US);
+        }
+
+        //the bpm actually requested, after float rounding, is the reference
+        double idealTicks = double(bpm) * CHRONOS_TICKS_PER_QUARTER * BENCH_DRIFT_SECONDS / 60.0;
+        //the old uint16 micros-per-tick, truncated with floorf (and saturated at low tempos)
+        double legacyMicros = min(floor(60'000'000.0 / (double(bpm) * BENCH_LEGACY_TICKS_PER_QUARTER)), double(UINT16_MAX - 1));
+        double legacyTicks = floor(BENCH_DRIFT_SECONDS * 1e6 / legacyMicros) * (CHRONOS_TICKS_PER_QUARTER / BENCH_LEGACY_TICKS_PER_QUARTER);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%.1fbpm", bpm);
+        double error = double(ticks) - idealTicks;
+        printf("%-28s %12llu %12.3f %12.1f %12s\n", name, (unsigned long long)ticks, error,
+            (legacyTicks - idealTicks) / idealTicks * 1e6, BenchVerdict(fabs(error) <= 1.0));
+    }
+}
+
+//-------- Edge Scheduler: edge placement against an ideal clock --------
+
+/// Simulated alarm interrupt entry, from the alarm coming due to its callback starting
+#define BENCH_ALARM_LATE_US 2
+/// Simulated run time of the fast path callback, from its start to it returning
+#define BENCH_ALARM_RUN_US 6
+
+/// @brief How the fast path is woken
+enum SchedulerMode
+{
+    /// @brief Fixed BENCH_TICK_US alarm
+    SCHEDULER_TICK,
+    /// @brief Alarm re-armed for the next edge as main.cpp does, relative to when it was due
+    SCHEDULER_EDGE,
+    /// @brief As SCHEDULER_EDGE, but returning the delay as a positive number, which re-arms it relative to when the
+    /// @brief callback returned
+    SCHEDULER_EDGE_FROM_RETURN
+};
+
+/// @brief State of the scheduler scenario's alarm callback, which can't take arguments
+struct SchedulerRun
+{
+    Chronos *chronos;
+    IOHelper *io;
+    SchedulerMode mode;
+    double microsPerTick;
+    uint64_t lastMicros;
+    uint64_t targetMicros;
+    /// @brief Time of the first update, where musical time starts
+    uint64_t startMicros;
+    bool previous[NUM_GATE_OUTS];
+    uint64_t wakeups;
+    uint64_t edges;
+    double sumError;
+    double worstError;
+};
+static SchedulerRun schedulerRun;
+
+/// @brief audio_rate_callback from main.cpp, scoring each gate out edge against where it should have been
+static int64_t SchedulerAlarmCallback()
+{
+    //TMULT x1 and the default 50% gate: every edge lands on a multiple of half an output's cycle
+    static const uint32_t divisors[4] = {512 * CHRONOS_TICKS_PER_512TH, 256 * CHRONOS_TICKS_PER_512TH, 128 * CHRONOS_TICKS_PER_512TH, 64 * CHRONOS_TICKS_PER_512TH};
+    SchedulerRun &run = schedulerRun;
+    uint64_t now = HAL::TimeMicros();
+    if(run.wakeups == 0) run.startMicros = run.lastMicros = now;
+    run.chronos->FastUpdate(uint32_t(now - run.lastMicros));
+    run.lastMicros = now;
+    for(int i = 0; i < 4; i++)
+    {
+        bool isOn = run.io->OUT_GATE_PINS & (1UL << (GATE_OUT_PIN_BASE + i));
+        if(run.wakeups > 0 && isOn != run.previous[i])
+        {
+            double period = run.microsPerTick * divisors[i] / 2;
+            double micros = double(now - run.startMicros);
+            double error = fabs(micros - round(micros / period) * period);
+            run.sumError += error;
+            if(error > run.worstError) run.worstError = error;
+            run.edges++;
+        }
+        run.previous[i] = isOn;
+    }
+    run.wakeups++;
+
+    if(run.mode == SCHEDULER_TICK) return -BENCH_TICK_US;
+    uint64_t nextTarget = now + run.chronos->GetMicrosUntilNextEdge();
+    int64_t delay = int64_t(nextTarget - run.targetMicros);
+    run.targetMicros = nextTarget;
+    if(delay < 1) delay = 1;
+    return run.mode == SCHEDULER_EDGE ? -delay : delay;
+}
+
+static void RunSchedulerScenario(const char *name, SchedulerMode mode, float bpm)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    HALSim::SetAlarmTiming(BENCH_ALARM_LATE_US, BENCH_ALARM_RUN_US);
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.isPlayMode = true;
+
+    schedulerRun = SchedulerRun();
+    schedulerRun.chronos = &chronos;
+    schedulerRun.io = &io;
+    schedulerRun.mode = mode;
+    schedulerRun.microsPerTick = 60'000'000.0 / (double(bpm) * CHRONOS_TICKS_PER_QUARTER);
+    HAL::AlarmStart(0, SchedulerAlarmCallback);
+    HALSim::AdvanceMicros(60'000'000);
+
+    //a tick lands an edge up to a tick late; a scheduled wakeup only by the interrupt entry, plus the microsecond
+    //rounding of the alarm. Re-arming from the return drifts without bound, and is only shown for contrast
+    const SchedulerRun &run = schedulerRun;
+    double worstLimit = mode == SCHEDULER_TICK ? BENCH_TICK_US + BENCH_ALARM_LATE_US : BENCH_ALARM_LATE_US + 1;
+    printf("%-28s %12.0f %12llu %12.3f %12.3f %12s\n", name, run.wakeups / 60.0, (unsigned long long)run.edges,
+        run.sumError / run.edges, run.worstError,
+        mode == SCHEDULER_EDGE_FROM_RETURN ? "-" : BenchVerdict(run.worstError <= worstLimit));
+}
+
+//-------- Gate Mask: coincident edges must land in the same pin write --------
+
+static void RunGateMaskScenario(const char *name, float bpm)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.isPlayMode = true;
+
+    //default UD knob and CV: UD is 8 << 7 and UD/2 16 << 7. At the default 50% gate every output changes on each
+    //multiple of half its cycle, so when one changes, every output with a cycle at most half as long changes with it
+    const uint32_t divisors[NUM_GATE_OUTS] = {512, 256, 128, 64, 1024, 2048};
+
+    uint32_t previous = 0;
+    uint64_t updates = 0;
+    uint64_t groups = 0;
+    uint64_t split = 0;
+    uint32_t writesBefore = HALSim::GetGpioWriteCount();
+    for(uint64_t now = 0; now < 60'000'000; now += BENCH_TICK_US)
+    {
+        chronos.FastUpdate(BENCH_TICK_US);
+        io.WriteFastOutputs(BENCH_TICK_US);
+        HALSim::AdvanceMicros(BENCH_TICK_US);
+        updates++;
+
+        //what actually reached the pins in this update
+        uint32_t pins = 0;
+        for(int i = 0; i < NUM_GATE_OUTS; i++) pins |= uint32_t(HAL::GpioGet(GATE_OUT_PIN_BASE + i)) << i;
+        uint32_t changed = pins ^ previous;
+        previous = pins;
+        if(updates == 1 || changed == 0) continue;
+
+        uint32_t expected = 0;
+        for(int i = 0; i < NUM_GATE_OUTS; i++)
+        {
+            if(!(changed & (1 << i))) continue;
+            for(int j = 0; j < NUM_GATE_OUTS; j++) if(divisors[j] * 2 <= divisors[i]) expected |= 1 << j;
+        }
+        if(__builtin_popcount(changed) > 1) groups++;
+        if((changed & expected) != expected) split++;
+    }
+    double writesPerUpdate = double(HALSim::GetGpioWriteCount() - writesBefore) / updates;
+    printf("%-28s %12llu %12.1f %12llu %12s\n", name, (unsigned long long)groups, writesPerUpdate, (unsigned long long)split,
+        BenchVerdict(split == 0));
+}
+
+static void RunGateMaskBenchmark()
+{
+    //the old loop did NUM_GATE_OUTS GpioPuts per update, so every pin of a coincident group went out in its own write
+    printf("\n%-28s %12s %12s %12s %12s\n", "gate mask", "coincident", "writes/upd", "split", "result");
+    RunGateMaskScenario("165bpm", 165);
+    RunGateMaskScenario("97.3bpm", 97.3f);
+}
+
+//-------- Gate Outputs: phase counters against the old per-tick modulo --------
+
+#define BENCH_OUTPUT_STEPS 5'000'000
+
+/// @brief The original gate evaluation from FastUpdate: six CalcGates with hard-wired divisors
+static uint32_t LegacyGateMask(uint32_t position, uint32_t udShift, const volatile uint32_t *gateLength)
+{
+    //outputDivisors was a member array, so the compiler couldn't turn these into masks either
+    volatile uint32_t divisors[NUM_GATE_OUTS] = {512, 256, 128, 64, 8u << udShift, 16u << udShift};
+    uint32_t mask = 0;
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        if((position % divisors[i])*1024 < divisors[i] * *gateLength) mask |= 1 << i;
+    }
+    return mask;
+}
+
+/// @brief Next position of a musical time trajectory: mostly small steps forward, sometimes back (swing, scrub CV)
+/// @brief and now and then a jump (reset, scrub CV patched in)
+static uint32_t NextPosition(uint32_t position, uint32_t &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    uint32_t roll = seed >> 16;
+    if(roll % 10'000 == 0) return 0;
+    if(roll % 5'000 == 1) return position + (seed & 0x0FFF) - 2048;
+    if(roll % 8 == 0) return position - (seed >> 8) % 4;
+    return position + (seed >> 8) % 5;
+}
+
+static void RunGateOutputBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    //--------Default table against the legacy outputs, UD moving now and then--------
+    GateOutputBank<NUM_GATE_OUTS> bank;
+    const uint16_t defaultDivisors[NUM_GATE_OUTS] = {512, 256, 128, 64, 8, 16};
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        GateOutputConfig config;
+        config.divisor = defaultDivisors[i];
+        config.isUserDivision = i >= 4;
+        bank.SetConfig(i, config);
+    }
+    volatile uint32_t gateLength = 512;
+    uint32_t seed = 7;
+    uint32_t position = 0;
+    uint32_t udShift = 7;
+    uint64_t legacyMismatches = 0;
+    for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+    {
+        position = NextPosition(position, seed);
+        if(step % 50'000 == 0) udShift = 1 + (seed >> 24) % 7;
+        bank.SetUDShift(udShift);
+        if(bank.Advance(position) != LegacyGateMask(position, udShift, &gateLength)) legacyMismatches++;
+    }
+
+    //--------Arbitrary tables: counters against the modulo form of the same table--------
+    uint64_t tableMismatches = 0;
+    for(int table = 0; table < 20; table++)
+    {
+        GateOutputBank<NUM_GATE_OUTS> custom;
+        for(int i = 0; i < NUM_GATE_OUTS; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            GateOutputConfig config;
+            config.divisor = 1 + (seed >> 8) % 1536;    //not just powers of two
+            config.gateLength = (seed >> 4) % (GATE_LENGTH_FULL + 1);
+            config.phaseOffset = (seed >> 12) % 2048;
+            config.isUserDivision = (seed >> 30) & 1;
+            //half of them on a rhythm pattern too
+            seed = seed * 1664525u + 1013904223u;
+            if(seed & 1)
+            {
+                config.patternSteps = 1 + (seed >> 8) % RHYTHM_MAX_STEPS;
+                config.pattern = (uint64_t(seed) << 32) ^ (seed * 2654435761u);
+            }
+            //and half on probability, ratchets and humanize
+            if(seed & 2)
+            {
+                config.probability = (seed >> 20) % (GATE_PROBABILITY_FULL + 1);
+                config.ratchets = 1 + (seed >> 4) % GATE_MAX_RATCHETS;
+                config.humanizeTicks = (seed >> 12) % 256;
+            }
+            custom.SetConfig(i, config);
+        }
+        custom.SetSeed(seed);
+        custom.SetUDShift(1 + table % 7);
+        for(int step = 0; step < BENCH_OUTPUT_STEPS / 20; step++)
+        {
+            position = NextPosition(position, seed);
+            int64_t signedPosition = int32_t(position); //steps back past 0 go negative, as a reset plus scrub CV can
+            if(custom.Advance(signedPosition) != custom.GetMaskAt(signedPosition)) tableMismatches++;
+        }
+    }
+
+    //--------Cost per fast update, on a steady play trajectory--------
+    volatile uint32_t sink = 0;
+    position = 0;
+    Clock::time_point start = Clock::now();
+    for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+    {
+        position += step & 1;
+        sink = sink + LegacyGateMask(position, udShift, &gateLength);
+    }
+    double legacyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+    position = 0;
+    start = Clock::now();
+    for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+    {
+        position += step & 1;
+        bank.SetUDShift(udShift);
+        sink = sink + bank.Advance(position);
+    }
+    double bankNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "gate outputs", "vs legacy", "vs modulo", "legacy ns", "counters ns", "result");
+    printf("%-28s %12llu %12llu %12.2f %12.2f %12s\n", "mismatched updates", (unsigned long long)legacyMismatches,
+        (unsigned long long)tableMismatches, legacyNs, bankNs, BenchVerdict(legacyMismatches == 0 && tableMismatches == 0));
+}
+
+//-------- Rhythm Patterns: Euclidean sequences, and staying on step through resets --------
+
+/// @brief Euclidean rhythms from Toussaint, "The Euclidean Algorithm Generates Traditional Musical Rhythms"
+static const struct { uint32_t pulses; uint32_t steps; const char *rhythm; } euclideanReferences[] =
+{
+    {1, 2,  "x."},
+    {1, 3,  "x.."},
+    {1, 4,  "x..."},
+    {4, 12, "x..x..x..x.."},
+    {2, 3,  "x.x"},
+    {2, 5,  "x.x.."},
+    {3, 4,  "x.xx"},
+    {3, 5,  "x.x.x"},
+    {3, 7,  "x.x.x.."},
+    {3, 8,  "x..x..x."},
+    {4, 7,  "x.x.x.x"},
+    {4, 9,  "x.x.x.x.."},
+    {4, 11, "x..x..x..x."},
+    {5, 6,  "x.xxxx"},
+    {5, 7,  "x.xx.xx"},
+    {5, 8,  "x.xx.xx."},
+    {5, 9,  "x.x.x.x.x"},
+    {5, 11, "x.x.x.x.x.."},
+    {5, 12, "x..x.x..x.x."},
+    {5, 13, "x..x.x..x.x.."},
+    {5, 16, "x..x..x..x..x..."},
+    {7, 8,  "x.xxxxxx"},
+    {7, 12, "x.xx.x.xx.x."},
+    {7, 16, "x..x.x.x..x.x.x."},
+    {9, 16, "x.xx.x.x.xx.x.x."},
+    {11, 24, "x..x.x.x.x.x..x.x.x.x.x."},
+    {13, 24, "x.xx.x.x.x.x.xx.x.x.x.x."},
+};
+
+/// @brief Plays Euclidean patterns on eighth note steps at a steady tempo, with RESET IN fired at random times, and
+/// @brief checks each output against its pattern at every step
+/// @return steps checked; mismatches written to *mismatches
+static uint64_t RunPatternResetScenario(float bpm, uint64_t *mismatches)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.SetResetQuantize(RESET_QUANTIZE_BEAT);
+    chronos.isPlayMode = true;
+
+    //output 0 is the step clock: a plain eighth note division. Resets land on its rising edges
+    const uint32_t stepTicks = CHRONOS_TICKS_PER_QUARTER / 2;
+    const uint64_t patterns[3] = {RhythmPattern::Euclidean(8, 5, 0), RhythmPattern::Euclidean(8, 3, 2),
+        RhythmPattern::Euclidean(13, 5, 0)};
+    const uint32_t patternSteps[3] = {8, 8, 13};
+    GateOutputConfig config;
+    config.divisor = stepTicks;
+    chronos.SetOutputConfig(0, config);
+    for(int i = 0; i < 3; i++)
+    {
+        config.pattern = patterns[i];
+        config.patternSteps = patternSteps[i];
+        chronos.SetOutputConfig(1 + i, config);
+    }
+
+    uint32_t seed = 11;
+    uint64_t step = 0;
+    uint64_t checked = 0;
+    uint64_t nextResetMicros = 0;
+    bool isResetPending = false;
+    uint32_t previous = 0;
+    uint64_t now = 0;
+    uint64_t last = 0;
+    while(now < 60'000'000)
+    {
+        //RESET IN pulses at random times; the reset itself waits for the next beat
+        if(now >= nextResetMicros)
+        {
+            HALSim::SetPin(GPIO_RST, false);
+            HALSim::SetPin(GPIO_RST, true);
+            isResetPending = true;
+            seed = seed * 1664525u + 1013904223u;
+            nextResetMicros = now + 700'000 + (seed >> 8) % 3'000'000; //over a beat, so only one is ever waiting
+        }
+
+        chronos.FastUpdate(uint32_t(now - last));
+        last = now;
+        uint32_t gates = io.OUT_GATE_PINS >> GATE_OUT_PIN_BASE;
+        if(gates & ~previous & 1)
+        {
+            //a reset taken in this update starts every pattern again
+            if(isResetPending && !chronos.IsResetPending())
+            {
+                step = 0;
+                isResetPending = false;
+            }
+            for(int i = 0; i < 3; i++)
+            {
+                bool isExpected = (patterns[i] >> (step % patternSteps[i])) & 1;
+                if(bool(gates & (2 << i)) != isExpected) (*mismatches)++;
+            }
+            step++;
+            checked++;
+        }
+        previous = gates;
+
+        uint32_t sleep = min(chronos.GetMicrosUntilNextEdge(), uint32_t(nextResetMicros > now ? nextResetMicros - now : 1));
+        now += sleep;
+        HALSim::AdvanceMicros(sleep);
+    }
+    return checked;
+}
+
+static void RunPatternBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    //--------Euclidean generator against the published sequences--------
+    uint32_t euclideanMismatches = 0;
+    for(const auto &reference : euclideanReferences)
+    {
+        uint64_t expected = 0;
+        for(uint32_t s = 0; s < reference.steps; s++) if(reference.rhythm[s] == 'x') expected |= uint64_t(1) << s;
+        if(RhythmPattern::Euclidean(reference.steps, reference.pulses, 0) != expected) euclideanMismatches++;
+        //and every rotation of it
+        for(uint32_t r = 1; r < reference.steps; r++)
+        {
+            uint64_t rotated = 0;
+            for(uint32_t s = 0; s < reference.steps; s++)
+            {
+                if(reference.rhythm[(s + r) % reference.steps] == 'x') rotated |= uint64_t(1) << s;
+            }
+            if(RhythmPattern::Euclidean(reference.steps, reference.pulses, r) != rotated) euclideanMismatches++;
+        }
+    }
+
+    //--------Patterns through random resets--------
+    uint64_t resetMismatches = 0;
+    uint64_t resetSteps = RunPatternResetScenario(165, &resetMismatches) + RunPatternResetScenario(97.3f, &resetMismatches);
+
+    //--------Cost per fast update: plain divisions against the same outputs on 64 step patterns--------
+    GateOutputBank<NUM_GATE_OUTS> plain;
+    GateOutputBank<NUM_GATE_OUTS> patterned;
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        GateOutputConfig config;
+        config.divisor = (64u << i) * CHRONOS_TICKS_PER_512TH / 4;
+        plain.SetConfig(i, config);
+        config.pattern = RhythmPattern::Euclidean(RHYTHM_MAX_STEPS, 23 + i, i);
+        config.patternSteps = RHYTHM_MAX_STEPS;
+        patterned.SetConfig(i, config);
+    }
+    volatile uint32_t sink = 0;
+    double ns[2];
+    GateOutputBank<NUM_GATE_OUTS> *banks[2] = {&plain, &patterned};
+    for(int b = 0; b < 2; b++)
+    {
+        int64_t position = 0;
+        Clock::time_point start = Clock::now();
+        for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+        {
+            position += 21 + (step & 1);
+            sink = sink + banks[b]->Advance(position);
+        }
+        ns[b] = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+    }
+
+    printf("\n%-28s %12s %12s %12s %12s\n", "rhythm patterns", "checked", "mismatches", "plain ns", "pattern ns");
+    printf("%-28s %12u %12u\n", "euclidean (all rotations)", uint32_t(sizeof(euclideanReferences) / sizeof(euclideanReferences[0])), euclideanMismatches);
+    printf("%-28s %12llu %12llu %12.2f %12.2f\n", "steps through resets", (unsigned long long)resetSteps,
+        (unsigned long long)resetMismatches, ns[0], ns[1]);
+    if(euclideanMismatches || resetMismatches) benchFailures++;
+}
+
+//-------- Modifiers: probability, ratchets and humanize, replayed from a seed --------
+
+#define BENCH_MODIFIER_CHANGES 4'000
+
+/// @brief One performance: play for a while, fire RESET IN, then record the gate outs' changes from the reset on
+/// @param changes written with BENCH_MODIFIER_CHANGES successive gate masks
+static void RecordModifierPerformance(float bpm, uint32_t seed, uint64_t leadMicros, uint32_t *changes)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.SetRandomSeed(seed);
+    chronos.isPlayMode = true;
+
+    //16ths at 50% probability with up to 8 ticks humanize, 8th note triplets in 3 ratchets at 75%, a 5 of 8
+    //Euclidean at 90% with a wider humanize; the rest stay plain
+    GateOutputConfig config;
+    config.divisor = CHRONOS_TICKS_PER_QUARTER / 4;
+    config.probability = GATE_PROBABILITY_FULL / 2;
+    config.humanizeTicks = 8 * CHRONOS_TICKS_PER_512TH;
+    chronos.SetOutputConfig(3, config);
+    config = GateOutputConfig();
+    config.divisor = CHRONOS_TICKS_PER_QUARTER / 3;
+    config.probability = GATE_PROBABILITY_FULL * 3 / 4;
+    config.ratchets = 3;
+    chronos.SetOutputConfig(4, config);
+    config = GateOutputConfig();
+    config.divisor = CHRONOS_TICKS_PER_QUARTER / 2;
+    config.pattern = RhythmPattern::Euclidean(8, 5, 0);
+    config.patternSteps = 8;
+    config.probability = GATE_PROBABILITY_FULL * 9 / 10;
+    config.humanizeTicks = 20 * CHRONOS_TICKS_PER_512TH;
+    chronos.SetOutputConfig(5, config);
+
+    uint32_t count = 0;
+    uint32_t previous = 0;
+    bool isRecording = false;
+    uint64_t now = 0;
+    uint64_t last = 0;
+    while(count < BENCH_MODIFIER_CHANGES)
+    {
+        if(now == leadMicros)
+        {
+            HALSim::SetPin(GPIO_RST, false);
+            HALSim::SetPin(GPIO_RST, true);
+        }
+        chronos.FastUpdate(uint32_t(now - last));
+        last = now;
+        //from the update that takes the reset on
+        if(now >= leadMicros && !chronos.IsResetPending()) isRecording = true;
+        uint32_t gates = io.OUT_GATE_PINS >> GATE_OUT_PIN_BASE;
+        if(isRecording && (gates != previous || count == 0)) changes[count++] = gates;
+        previous = gates;
+
+        uint32_t sleep = chronos.GetMicrosUntilNextEdge();
+        if(now < leadMicros && now + sleep > leadMicros) sleep = uint32_t(leadMicros - now);
+        now += sleep;
+        HALSim::AdvanceMicros(sleep);
+    }
+}
+
+static void RunModifierBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    //--------Determinism: the same seed plays the same gates after a reset, whatever came before--------
+    static uint32_t reference[BENCH_MODIFIER_CHANGES];
+    static uint32_t other[BENCH_MODIFIER_CHANGES];
+    const uint32_t referenceSeed = 1234;
+    RecordModifierPerformance(120, referenceSeed, 3'100'000, reference);
+    //the same seed must replay exactly; another seed must not, or the seed isn't reaching the dice
+    const struct { const char *name; float bpm; uint32_t seed; uint64_t leadMicros; } performances[] =
+    {
+        {"same seed, same start",      120,   1234, 3'100'000},
+        {"same seed, 97.3bpm, later",  97.3f, 1234, 7'700'000},
+        {"other seed",                 120,   1235, 3'100'000},
+    };
+
+    printf("\n%-28s %12s %12s %12s\n", "modifier replay", "changes", "differ", "result");
+    for(const auto &performance : performances)
+    {
+        RecordModifierPerformance(performance.bpm, performance.seed, performance.leadMicros, other);
+        uint32_t differ = 0;
+        for(uint32_t i = 0; i < BENCH_MODIFIER_CHANGES; i++) if(other[i] != reference[i]) differ++;
+        printf("%-28s %12u %12u %12s\n", performance.name, BENCH_MODIFIER_CHANGES, differ,
+            BenchVerdict(performance.seed == referenceSeed ? differ == 0 : differ > 0));
+    }
+
+    //--------What the dice actually do, over many cycles of a bank--------
+    GateOutputBank<3> bank;
+    GateOutputConfig config;
+    config.divisor = 1024;
+    config.probability = GATE_PROBABILITY_FULL * 3 / 10;
+    bank.SetConfig(0, config);
+    config.probability = GATE_PROBABILITY_FULL;
+    config.ratchets = 4;
+    bank.SetConfig(1, config);
+    config.ratchets = 1;
+    config.humanizeTicks = 200;
+    bank.SetConfig(2, config);
+    bank.SetSeed(99);
+    uint32_t rises[3] = {};
+    uint64_t delaySum = 0;
+    uint32_t worstDelay = 0;
+    uint32_t previous = 0;
+    const uint32_t cycles = 100'000;
+    for(int64_t position = 0; position < int64_t(cycles) * 1024; position++)
+    {
+        uint32_t mask = bank.Advance(position);
+        uint32_t rising = mask & ~previous;
+        for(int i = 0; i < 3; i++) rises[i] += (rising >> i) & 1;
+        if(rising & 4)
+        {
+            uint32_t delay = uint32_t(position % 1024);
+            delaySum += delay;
+            if(delay > worstDelay) worstDelay = delay;
+        }
+        previous = mask;
+    }
+    printf("\n%-28s %12s %12s\n", "modifier statistics", "measured", "expected");
+    printf("%-28s %12.4f %12.4f\n", "30% probability", double(rises[0]) / cycles, 0.3);
+    printf("%-28s %12.4f %12.4f\n", "4 ratchets, pulses/cycle", double(rises[1]) / cycles, 4.0);
+    printf("%-28s %12.1f %12.1f\n", "humanize 200, mean delay", double(delaySum) / rises[2], 100.0);
+    printf("%-28s %12u %12u\n", "humanize 200, worst delay", worstDelay, 200u);
+
+    //--------Cost per fast update: plain divisions against the same outputs with every modifier on--------
+    GateOutputBank<NUM_GATE_OUTS> plain;
+    GateOutputBank<NUM_GATE_OUTS> modified;
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        GateOutputConfig outputConfig;
+        outputConfig.divisor = (64u << i) * CHRONOS_TICKS_PER_512TH / 4;
+        plain.SetConfig(i, outputConfig);
+        outputConfig.probability = GATE_PROBABILITY_FULL * 2 / 3;
+        outputConfig.ratchets = 2 + i % 3;
+        outputConfig.humanizeTicks = 50;
+        modified.SetConfig(i, outputConfig);
+    }
+    volatile uint32_t sink = 0;
+    double ns[2];
+    GateOutputBank<NUM_GATE_OUTS> *banks[2] = {&plain, &modified};
+    for(int b = 0; b < 2; b++)
+    {
+        int64_t position = 0;
+        Clock::time_point start = Clock::now();
+        for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+        {
+            position += 21 + (step & 1);
+            sink = sink + banks[b]->Advance(position);
+        }
+        ns[b] = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+    }
+    Clock::time_point start = Clock::now();
+    for(uint32_t i = 0; i < BENCH_OUTPUT_STEPS; i++) sink = sink + FastRandom::Get(1234, i & 7, i);
+    double randomNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+    printf("\n%-28s %12s %12s %12s\n", "modifier cost", "plain ns", "modified ns", "random ns");
+    printf("%-28s %12.2f %12.2f %12.2f\n", "6 outputs per update", ns[0], ns[1], randomNs);
+}
+
+//-------- Tuplets: every output back in phase at each bar line --------
+
+#define BENCH_TUPLET_BARS 2'000
+
+static void RunTupletScenario(const char *name, float bpm)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.isPlayMode = true;
+
+    //whole notes, then divisions the old 512th note ticks couldn't hold: quarter triplets, quintuplets, septuplets,
+    //dotted eighths (which only line up every third bar) and eighth triplets
+    const uint32_t divisors[NUM_GATE_OUTS] = {CHRONOS_TICKS_PER_WHOLE, CHRONOS_TICKS_PER_WHOLE / 6,
+        CHRONOS_TICKS_PER_WHOLE / 5, CHRONOS_TICKS_PER_WHOLE / 7, CHRONOS_TICKS_PER_QUARTER * 3 / 4,
+        CHRONOS_TICKS_PER_WHOLE / 12};
+    //bars between coincident downbeats of each output
+    const uint32_t barsPerAlignment[NUM_GATE_OUTS] = {1, 1, 1, 1, 3, 1};
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        GateOutputConfig config;
+        config.divisor = divisors[i];
+        chronos.SetOutputConfig(i, config);
+    }
+
+    //the same divisions rounded to 512th note ticks: the best the old time base could do
+    uint32_t legacyMisaligned = 0;
+    double legacyWorst = 0;
+    for(uint32_t bar = 1; bar <= BENCH_TUPLET_BARS; bar++)
+    {
+        for(int i = 1; i < NUM_GATE_OUTS; i++)
+        {
+            if(bar % barsPerAlignment[i]) continue;
+            uint32_t legacyDivisor = max(uint32_t(1), (divisors[i] + CHRONOS_TICKS_PER_512TH / 2) / CHRONOS_TICKS_PER_512TH);
+            uint32_t phase = (bar * 512) % legacyDivisor;
+            double error = min(phase, legacyDivisor - phase) / 512.0 * 4; //in quarter notes
+            if(phase) legacyMisaligned++;
+            if(error > legacyWorst) legacyWorst = error;
+        }
+    }
+
+    //play for the bars with edge scheduled wakeups, checking each downbeat of the whole note out
+    uint32_t previous = 0;
+    uint32_t bars = 0;
+    uint32_t misaligned = 0;
+    uint64_t last = 0;
+    uint64_t now = 0;
+    while(bars < BENCH_TUPLET_BARS)
+    {
+        chronos.FastUpdate(uint32_t(now - last));
+        last = now;
+        uint32_t gates = (io.OUT_GATE_PINS >> GATE_OUT_PIN_BASE) & ((1 << NUM_GATE_OUTS) - 1);
+        uint32_t rising = gates & ~previous;
+        previous = gates;
+        if(rising & 1)
+        {
+            //the first rise is the start of bar 0
+            if(now > 0)
+            {
+                bars++;
+                for(int i = 1; i < NUM_GATE_OUTS; i++)
+                {
+                    if(bars % barsPerAlignment[i] == 0 && !(rising & (1 << i))) misaligned++;
+                }
+            }
+        }
+
+        uint32_t sleep = chronos.GetMicrosUntilNextEdge();
+        now += sleep;
+        HALSim::AdvanceMicros(sleep);
+    }
+    printf("%-28s %12u %12u %12u %12.3f %12s\n", name, bars, misaligned, legacyMisaligned, legacyWorst,
+        BenchVerdict(misaligned == 0));
+}
+
+static void RunTupletBenchmark()
+{
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "tuplet bar lines", "bars", "misaligned", "legacy misal", "legacy qn", "result");
+    RunTupletScenario("165bpm", 165);
+    RunTupletScenario("97.3bpm", 97.3f);
+}
+
+//-------- MIDI Clock Out: the USB byte stream, timestamped --------
+
+#define BENCH_MIDI_SECONDS 60
+/// Period of the CV rate loop on core 0
+#define BENCH_MIDI_LOOP_US 1000
+/// Most a timestamped clock may be off its spacing, across the reset too: the default reset keeps the clock grid
+#define BENCH_MIDI_TIMESTAMPED_WORST_US 5
+
+/// @brief Plays for a minute with a RESET IN pulse and a stop near the end, the fast path on its scheduled wakeups
+/// @brief and the core 0 loop sending MIDI, then checks the messages that left the simulated USB port
+/// @param isTimestamped true: MidiOut sends each message its latency after its timestamp. false: every waiting
+/// @param isTimestamped message goes out whenever the 1mS loop comes round
+static void RunMidiClockScenario(const char *name, float bpm, bool isTimestamped)
+{
+    Chronos chronos;
+    IOHelper io;
+    MidiOut midiOut;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.isPlayMode = true;
+
+    const uint64_t endMicros = BENCH_MIDI_SECONDS * 1'000'000ULL;
+    const uint64_t resetMicros = 20'000'000;
+    const uint64_t stopMicros = endMicros - 1'000'000;
+    uint64_t now = 0;
+    uint64_t fastNext = 0;
+    uint64_t fastLast = 0;
+    uint64_t slowNext = 0;
+    while(now < endMicros)
+    {
+        if(now == fastNext)
+        {
+            chronos.FastUpdate(uint32_t(now - fastLast));
+            fastLast = now;
+            fastNext = now + chronos.GetMicrosUntilNextEdge();
+        }
+        if(now == slowNext)
+        {
+            slowNext = now + BENCH_MIDI_LOOP_US;
+            if(isTimestamped)
+            {
+                slowNext = min(slowNext, midiOut.Service(chronos.GetMidiEvents(), now));
+            }
+            else
+            {
+                MidiEvent event;
+                while(chronos.GetMidiEvents().Pop(&event)) HAL::MidiWrite(event.bytes, event.length);
+            }
+        }
+        if(now == resetMicros)
+        {
+            HALSim::SetPin(GPIO_RST, false);
+            HALSim::SetPin(GPIO_RST, true);
+        }
+        if(now == stopMicros) chronos.isPlayMode = false;
+
+        uint64_t next = min(min(fastNext, slowNext), endMicros);
+        if(now < resetMicros) next = min(next, resetMicros);
+        if(now < stopMicros) next = min(next, stopMicros);
+        HALSim::AdvanceMicros(next - now);
+        now = next;
+    }
+
+    //clock spacing against the tempo, across the reset but not the stop
+    const double idealInterval = 60'000'000.0 / (double(bpm) * MIDI_CLOCK_PPQN);
+    uint32_t count = min(HALSim::GetMidiLogCount(), uint32_t(HAL_SIM_MIDI_LOG_SIZE));
+    uint32_t clocks = 0;
+    uint32_t starts = 0;
+    uint32_t stops = 0;
+    uint32_t songPositions = 0;
+    uint64_t lastClockMicros = 0;
+    double sumError = 0;
+    double worstError = 0;
+    bool isOrderOk = count > 0 && HALSim::GetMidiLogEntry(0).bytes[0] == MIDI_START;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const MidiLogEntry &entry = HALSim::GetMidiLogEntry(i);
+        switch(entry.bytes[0])
+        {
+            case MIDI_TIMING_CLOCK:
+                if(clocks > 0)
+                {
+                    double error = fabs(double(entry.timeMicros - lastClockMicros) - idealInterval);
+                    sumError += error;
+                    if(error > worstError) worstError = error;
+                }
+                lastClockMicros = entry.timeMicros;
+                clocks++;
+                break;
+            case MIDI_START:    starts++; break;
+            case MIDI_STOP:     stops++; isOrderOk = isOrderOk && i == count - 1; break;
+            case MIDI_SONG_POSITION:
+                songPositions++;
+                //back to the top, and the clock at the top right behind it
+                isOrderOk = isOrderOk && entry.bytes[1] == 0 && entry.bytes[2] == 0 && i + 1 < count
+                    && HALSim::GetMidiLogEntry(i + 1).bytes[0] == MIDI_TIMING_CLOCK;
+                break;
+        }
+    }
+    //sent from the loop, a clock can go out up to a loop late
+    double worstLimit = isTimestamped ? BENCH_MIDI_TIMESTAMPED_WORST_US : BENCH_MIDI_LOOP_US;
+    printf("%-28s %12u %12.3f %12.3f %12s %12s\n", name, clocks, sumError / (clocks - 1), worstError,
+        BenchVerdict(worstError <= worstLimit), BenchVerdict(isOrderOk && starts == 1 && stops == 1 && songPositions == 1));
+}
+
+/// @brief Plays the clock out a beat, one update per clock, then moves it on by some ticks in one update, as a
+/// @brief Continue from further on without a Stop does, and plays on another beat
+/// @note A jump of more than a clock has to be relocated to with a Song Position Pointer to the 16th at or just after
+/// @note where it landed (a clock's move must not be), nothing may burst out, and the clocks carry on one per update
+static void RunMidiJumpScenario(const char *name, int64_t jumpTicks)
+{
+    const uint32_t ticksPerClock = CHRONOS_TICKS_PER_QUARTER / MIDI_CLOCK_PPQN;
+    const int64_t ticksPerSongPosition = int64_t(ticksPerClock) * MIDI_CLOCKS_PER_SONG_POSITION;
+    const uint64_t microsPerClock = 60'000'000 / (120 * MIDI_CLOCK_PPQN);
+    MidiClockGenerator generator;
+    generator.SetTicksPerQuarter(CHRONOS_TICKS_PER_QUARTER);
+    MidiEventFIFO events;
+    MidiEvent event;
+    int64_t position = 0;
+    uint64_t now = 0;
+    generator.Update(position, true, now, events);
+    for(int i = 0; i < MIDI_CLOCK_PPQN; i++)
+    {
+        position += ticksPerClock;
+        now += microsPerClock;
+        generator.Update(position, true, now, events);
+    }
+    while(events.Pop(&event)) {}
+
+    position += jumpTicks;
+    now += microsPerClock;
+    const int64_t landing = position;
+    generator.Update(position, true, now, events);
+    uint32_t jumpMessages = 0;
+    int64_t songPosition = -1;
+    while(events.Pop(&event))
+    {
+        jumpMessages++;
+        if(event.bytes[0] == MIDI_SONG_POSITION) songPosition = event.bytes[1] | (event.bytes[2] << 7);
+    }
+    uint32_t lateClocks = 0;
+    for(int i = 0; i < MIDI_CLOCK_PPQN; i++)
+    {
+        position += ticksPerClock;
+        now += microsPerClock;
+        generator.Update(position, true, now, events);
+        uint32_t clocks = 0;
+        while(events.Pop(&event)) clocks += event.bytes[0] == MIDI_TIMING_CLOCK;
+        if(clocks > 1) lateClocks++;
+    }
+
+    bool isRelocated = songPosition >= 0 && songPosition * ticksPerSongPosition > landing - int64_t(ticksPerClock)
+        && songPosition * ticksPerSongPosition < landing + ticksPerSongPosition;
+    bool isOk = (jumpTicks > ticksPerClock ? isRelocated : songPosition < 0) && jumpMessages <= 2 && lateClocks == 0
+        && events.GetOverflowCount() == 0;
+    printf("%-28s %12u %12lld %12u %12s\n", name, jumpMessages, (long long)songPosition, events.GetOverflowCount(), BenchVerdict(isOk));
+}
+
+static void RunMidiClockBenchmark()
+{
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "midi clock out", "clocks", "mean err uS", "worst uS", "spacing", "messages");
+    RunMidiClockScenario("1mS loop, 165bpm", 165, false);
+    RunMidiClockScenario("timestamped, 165bpm", 165, true);
+    RunMidiClockScenario("1mS loop, 97.3bpm", 97.3f, false);
+    RunMidiClockScenario("timestamped, 97.3bpm", 97.3f, true);
+
+    printf("\n%-28s %12s %12s %12s %12s\n", "midi clock out jump", "messages", "song pos", "overflows", "result");
+    //the jumps land part way into a clock, as following a clock in does
+    const int64_t ticksPerClock = CHRONOS_TICKS_PER_QUARTER / MIDI_CLOCK_PPQN;
+    RunMidiJumpScenario("on a clock", ticksPerClock);
+    RunMidiJumpScenario("on 2 1/3 clocks", ticksPerClock * 7 / 3);
+    RunMidiJumpScenario("on 64 bars and 1/3 clock", int64_t(CHRONOS_TICKS_PER_WHOLE) * 64 + ticksPerClock / 3);
+}
+
+//-------- MIDI Clock In: following a DAW over USB --------
+
+/// How the simulated host's MIDI reaches the fast path
+enum BenchMidiDelivery
+{
+    /// @brief Each message is stamped the moment it was sent: the best any link could do
+    BENCH_MIDI_EXACT,
+    /// @brief Full speed USB stamped in the USB interrupt: messages wait for the next 1mS frame and share its stamp
+    BENCH_MIDI_USB_FRAMES,
+    /// @brief The same frames, but only picked up (and stamped) when tud_task is next polled, about once a mS and out
+    /// @brief of step with the frames. This is what the firmware does
+    BENCH_MIDI_POLLED
+};
+
+/// @brief A recorded MIDI clock stream: what a DAW sends, and when
+struct BenchMidiStream
+{
+    /// @brief Messages in send order
+    struct Message
+    {
+        uint64_t sendMicros;
+        uint8_t bytes[3];
+        uint8_t length;
+    };
+    std::vector<Message> messages;
+    /// @brief Where each song clock really fell (the host's own grid, before its send jitter), per Start or Continue:
+    /// @brief segmentClocks[s][i] is song clock segmentFirst[s] + i of segment s
+    std::vector<std::vector<uint64_t>> segmentClocks;
+    std::vector<uint32_t> segmentFirst;
+    float endBPM = 0;
+
+    void Add(uint64_t sendMicros, uint8_t b0, uint8_t b1 = 0, uint8_t b2 = 0, uint8_t length = 1)
+    {
+        messages.push_back({sendMicros, {b0, b1, b2}, length});
+    }
+};
+
+/// @brief Records a host playing: clocks from the start, Start after two beats, an optional Stop, SPP and Continue
+/// @param fromBPM tempo at the Start; the tempo moves linearly per clock to toBPM by the end
+/// @param jitterMicros the host's send jitter, uniform +/-
+/// @param stopMicros when to stop (0 for never); it continues from songPosition 16ths two seconds later
+/// @param isClockedWhileStopped whether the host keeps sending clocks while stopped
+static void RecordMidiStream(BenchMidiStream &stream, float fromBPM, float toBPM, uint32_t jitterMicros,
+    uint64_t endMicros, uint64_t stopMicros, uint32_t songPosition, bool isClockedWhileStopped)
+{
+    uint32_t seed = 5;
+    double micros = 50'000;
+    uint32_t clocks = 0;
+    uint32_t totalClocks = uint32_t(endMicros / (60e6 / (fmax(fromBPM, toBPM) * MIDI_CLOCK_PPQN)));
+    int segment = -1;
+    uint32_t songClock = 0;
+    bool isPlaying = false;
+    bool hasStopped = false;
+    const uint64_t continueMicros = stopMicros + 2'000'000;
+    while(micros < endMicros)
+    {
+        double bpm = fromBPM + (toBPM - fromBPM) * fmin(double(clocks) / totalClocks, 1.0);
+        double period = 60e6 / (bpm * MIDI_CLOCK_PPQN);
+        seed = seed * 1664525u + 1013904223u;
+        double jitter = jitterMicros ? (double(seed >> 8) / double(1 << 24) * 2 - 1) * jitterMicros : 0;
+        uint64_t send = uint64_t(micros + jitter);
+
+        //transport messages go out just ahead of the clock they belong to
+        if(!isPlaying && !hasStopped && clocks == 2 * MIDI_CLOCK_PPQN)
+        {
+            stream.Add(send - 1, MIDI_START);
+            isPlaying = true;
+            songClock = 0;
+            stream.segmentClocks.emplace_back();
+            stream.segmentFirst.push_back(0);
+            segment++;
+        }
+        else if(isPlaying && stopMicros && micros >= stopMicros && !hasStopped)
+        {
+            stream.Add(send - 1, MIDI_STOP);
+            isPlaying = false;
+            hasStopped = true;
+        }
+        else if(!isPlaying && hasStopped && micros >= continueMicros)
+        {
+            stream.Add(send - 2, MIDI_SONG_POSITION, songPosition & 0x7F, songPosition >> 7, 3);
+            stream.Add(send - 1, MIDI_CONTINUE);
+            isPlaying = true;
+            songClock = songPosition * MIDI_CLOCKS_PER_SONG_POSITION;
+            stream.segmentClocks.emplace_back();
+            stream.segmentFirst.push_back(songClock);
+            segment++;
+        }
+
+        if(isPlaying || isClockedWhileStopped)
+        {
+            stream.Add(send, MIDI_TIMING_CLOCK);
+            if(isPlaying) stream.segmentClocks[segment].push_back(uint64_t(micros));
+            songClock++;
+        }
+        stream.endBPM = float(bpm);
+        micros += period;
+        clocks++;
+    }
+}
+
+/// @brief Results of following one stream
+struct BenchMidiFollowResult
+{
+    uint32_t clocks = 0;
+    double sumPhaseError = 0;
+    double worstPhaseError = 0;
+    double sumDownbeatError = 0;
+    uint32_t downbeats = 0;
+    float estimatedBPM = 0;
+    bool isOrderOk = true;
+};
+
+/// @brief Plays a stream into the simulated USB MIDI port and follows it with Chronos. What the fast path played is
+/// @brief read back from its MIDI clock out, whose clocks are stamped at the moment beatTime crossed them
+static void FollowMidiStream(const BenchMidiStream &stream, BenchMidiDelivery delivery, uint64_t endMicros,
+    BenchMidiFollowResult &result)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(120);
+    chronos.isPlayMode = false;
+
+    //arrival of each message at the USB port, in send order
+    std::vector<uint64_t> arrivals;
+    for(const BenchMidiStream::Message &message : stream.messages)
+    {
+        uint64_t arrival = message.sendMicros;
+        if(delivery != BENCH_MIDI_EXACT) arrival = (arrival / 1000 + 1) * 1000;
+        if(delivery == BENCH_MIDI_POLLED) arrival = ((arrival - 370) / 1000 + 1) * 1000 + 370; //loop out of step
+        arrivals.push_back(arrival);
+    }
+
+    uint32_t next = 0;
+    uint64_t now = 0;
+    uint64_t fastNext = 0;
+    uint64_t fastLast = 0;
+    uint64_t slowNext = 0;
+    const uint32_t skipClocks = 2 * MIDI_CLOCK_PPQN; //let the loop settle after each Start or Continue
+    int segment = -1;
+    uint32_t songClock = 0;
+    uint32_t segmentClocks = 0;
+    uint32_t stops = 0;
+    uint32_t songPositions = 0;
+    while(now < endMicros)
+    {
+        while(next < arrivals.size() && arrivals[next] <= now)
+        {
+            const BenchMidiStream::Message &message = stream.messages[next++];
+            HALSim::ReceiveMidi(message.bytes, message.length);
+        }
+        if(now == fastNext)
+        {
+            chronos.FastUpdate(uint32_t(now - fastLast));
+            fastLast = now;
+            fastNext = now + chronos.GetMicrosUntilNextEdge();
+
+            MidiEvent event;
+            while(chronos.GetMidiEvents().Pop(&event))
+            {
+                switch(event.bytes[0])
+                {
+                    case MIDI_START:
+                    case MIDI_CONTINUE:
+                        if(event.bytes[0] == MIDI_START) songClock = 0;
+                        segment++;
+                        segmentClocks = 0;
+                        result.isOrderOk = result.isOrderOk && segment < int(stream.segmentClocks.size());
+                        break;
+                    case MIDI_SONG_POSITION:
+                        songClock = (event.bytes[1] | (event.bytes[2] << 7)) * MIDI_CLOCKS_PER_SONG_POSITION;
+                        songPositions++;
+                        break;
+                    case MIDI_STOP:
+                        stops++;
+                        break;
+                    case MIDI_TIMING_CLOCK:
+                    {
+                        if(segment < 0 || segment >= int(stream.segmentClocks.size())) { result.isOrderOk = false; break; }
+                        const std::vector<uint64_t> &clocks = stream.segmentClocks[segment];
+                        uint32_t index = songClock - stream.segmentFirst[segment];
+                        if(index < clocks.size())
+                        {
+                            double error = fabs(double(event.timeMicros) - double(clocks[index]));
+                            if(segmentClocks == 0)
+                            {
+                                result.sumDownbeatError += error;
+                                result.downbeats++;
+                            }
+                            else if(segmentClocks >= skipClocks)
+                            {
+                                result.sumPhaseError += error;
+                                if(error > result.worstPhaseError) result.worstPhaseError = error;
+                                result.clocks++;
+                            }
+                        }
+                        //the clock after the last one can go out just before the Stop that follows it has arrived
+                        else if(index > clocks.size()) result.isOrderOk = false;
+                        songClock++;
+                        segmentClocks++;
+                        break;
+                    }
+                }
+            }
+        }
+        if(now == slowNext)
+        {
+            chronos.SlowUpdate(BENCH_SLOW_US);
+            slowNext = now + BENCH_SLOW_US;
+        }
+
+        uint64_t wake = min(min(fastNext, slowNext), endMicros);
+        if(next < arrivals.size()) wake = min(wake, arrivals[next]);
+        HALSim::AdvanceMicros(wake - now);
+        now = wake;
+    }
+    result.estimatedBPM = chronos.GetEstimatedBPM();
+    bool isStopped = stream.segmentClocks.size() > 1;
+    result.isOrderOk = result.isOrderOk && segment + 1 == int(stream.segmentClocks.size())
+        && stops == (isStopped ? 1u : 0u) && songPositions == (isStopped ? 1u : 0u);
+}
+
+static void RunMidiFollowScenario(const char *name, float fromBPM, float toBPM, uint32_t jitterMicros,
+    BenchMidiDelivery delivery, uint64_t stopMicros = 0, bool isClockedWhileStopped = true)
+{
+    const uint64_t endMicros = 60'000'000;
+    BenchMidiStream stream;
+    RecordMidiStream(stream, fromBPM, toBPM, jitterMicros, endMicros, stopMicros, 16, isClockedWhileStopped);
+    BenchMidiFollowResult result;
+    FollowMidiStream(stream, delivery, endMicros, result);
+    printf("%-34s %8u %10.1f %10.1f %11.1f %10.3f %9s\n", name, result.clocks,
+        result.clocks ? result.sumPhaseError / result.clocks : 0.0, result.worstPhaseError,
+        result.downbeats ? result.sumDownbeatError / result.downbeats : 0.0, fabs(result.estimatedBPM - stream.endBPM),
+        BenchVerdict(result.isOrderOk));
+}
+
+static void RunMidiFollowBenchmark()
+{
+    printf("\n%-34s %8s %10s %10s %11s %10s %9s\n", "midi clock in", "clocks", "phase uS", "worst uS",
+        "downbeat uS", "BPM err", "transport");
+    RunMidiFollowScenario("120bpm, stamped on send", 120, 120, 0, BENCH_MIDI_EXACT);
+    RunMidiFollowScenario("120bpm, stamped in USB IRQ", 120, 120, 0, BENCH_MIDI_USB_FRAMES);
+    RunMidiFollowScenario("120bpm, polled", 120, 120, 0, BENCH_MIDI_POLLED);
+    RunMidiFollowScenario("120bpm, polled, 300uS jitter", 120, 120, 300, BENCH_MIDI_POLLED);
+    RunMidiFollowScenario("174bpm, polled, 300uS jitter", 174, 174, 300, BENCH_MIDI_POLLED);
+    RunMidiFollowScenario("63.5bpm, polled, 300uS jitter", 63.5f, 63.5f, 300, BENCH_MIDI_POLLED);
+    RunMidiFollowScenario("90->150bpm ramp, polled", 90, 150, 300, BENCH_MIDI_POLLED);
+    RunMidiFollowScenario("stop, SPP, continue", 120, 120, 300, BENCH_MIDI_POLLED, 30'000'000, true);
+    RunMidiFollowScenario("stop, SPP, continue, no clock", 120, 120, 300, BENCH_MIDI_POLLED, 30'000'000, false);
+}
+
+//-------- Follow Mode: generated CLOCK/RESET streams, scored on the gate outs --------
+//the table is CSV (one header row, then one row per scenario, ended by a blank line) so runs of different firmware
+//versions can be diffed or plotted: sed -n '/^scenario,ppqn/,/^$/p'
+
+#define BENCH_FOLLOW_SECONDS 30
+/// A beat counts as locked within this much of where it belongs
+#define BENCH_FOLLOW_LOCK_US 1000
+/// Beats in a row that must be locked before the loop is
+#define BENCH_FOLLOW_LOCK_BEATS 4
+/// CLOCK IN and RESET IN pulse width (cut down for fast clocks)
+#define BENCH_FOLLOW_PULSE_US 2000
+/// Up to this PPQN a scenario is held to its sparse limits
+#define BENCH_FOLLOW_SPARSE_PPQN 4
+
+/// How a generated clock strays from its grid
+enum BenchJitter
+{
+    BENCH_JITTER_NONE,
+    /// @brief Uniform, +/- jitterMicros
+    BENCH_JITTER_UNIFORM,
+    /// @brief Gaussian, jitterMicros standard deviation
+    BENCH_JITTER_GAUSSIAN
+};
+
+/// @brief Scores a stream must stay within to pass; a missed or spurious gate always fails
+struct BenchFollowLimits
+{
+    /// @brief From the first pulse in, so acquisition counts; negative for a row printed only for information
+    double lockMillis;
+    double rmsMicros;
+    double worstMicros;
+};
+/// Limits of a row that is printed for information and not counted
+#define BENCH_FOLLOW_INFO {-1, 0, 0}
+
+/// @brief One generated CLOCK/RESET stream
+struct BenchFollowScenario
+{
+    const char *name;
+    float fromBPM;
+    /// @brief Tempo at the end: reached linearly over the run, or all at once halfway if isStep
+    float toBPM;
+    bool isStep;
+    BenchJitter jitter;
+    uint32_t jitterMicros;
+    /// @brief Every this many pulses one goes missing (0 for none)
+    uint32_t dropEvery;
+    /// @brief Every this many pulses one triggers twice, a mS apart (0 for none)
+    uint32_t doubleEvery;
+    /// @brief Sends RESET halfway through, two and three quarter beats into a bar
+    bool hasReset;
+    /// @brief Limits from 8 PPQN up
+    BenchFollowLimits limits;
+    /// @brief Limits at 1 and 4 PPQN, where a ramp or step is heard about only a few times a beat
+    BenchFollowLimits sparseLimits;
+};
+
+/// @brief Scores of following one stream
+struct BenchFollowResult
+{
+    uint32_t pulses = 0;
+    uint32_t beats = 0;
+    /// @brief From the first pulse in to the first of BENCH_FOLLOW_LOCK_BEATS locked beats in a row, -1 if never
+    double lockMillis = -1;
+    double sumBPMError = 0;
+    uint32_t bpmSamples = 0;
+    double sumSquaredError = 0;
+    double worstError = 0;
+    uint32_t matched = 0;
+    uint32_t missed = 0;
+    uint32_t spurious = 0;
+
+    bool IsWithin(const BenchFollowLimits &limits) const
+    {
+        return lockMillis >= 0 && lockMillis <= limits.lockMillis && matched &&
+            sqrt(sumSquaredError / matched) <= limits.rmsMicros && worstError <= limits.worstMicros &&
+            missed == 0 && spurious == 0;
+    }
+};
+
+/// @brief A pin change of the generated stream
+struct BenchPinEvent
+{
+    uint64_t micros;
+    uint8_t pin;
+    bool level;
+};
+
+static double FollowBPMAt(const BenchFollowScenario &scenario, double micros)
+{
+    double end = BENCH_FOLLOW_SECONDS * 1e6;
+    if(scenario.isStep) return micros < end / 2 ? scenario.fromBPM : scenario.toBPM;
+    return scenario.fromBPM + (scenario.toBPM - scenario.fromBPM) * fmin(micros / end, 1.0);
+}
+
+/// @brief Generates the stream's pin changes and the beats it means (ideal times, before jitter)
+static void GenerateFollowStream(const BenchFollowScenario &scenario, PPQNType ppqn, std::vector<BenchPinEvent> &pins,
+    std::vector<double> &beats, uint32_t *pulses)
+{
+    const double end = BENCH_FOLLOW_SECONDS * 1e6;
+    uint32_t seed = 11;
+    auto uniform = [&seed]() { seed = seed * 1664525u + 1013904223u; return double(seed >> 8) / double(1 << 24); };
+
+    //reset halfway, on the pulse two and three quarter beats into a bar (on beat 2, at PPQN 1), where the quarter
+    //note gate is low; a reset while it is high just lengthens it
+    uint32_t resetPulse = UINT32_MAX;
+    if(scenario.hasReset)
+    {
+        double beatMicros = 60e6 / scenario.fromBPM;
+        uint32_t bars = uint32_t(end / 2 / (beatMicros * 4));
+        resetPulse = (bars * 4 + 2) * ppqn + ppqn * 3 / 4;
+    }
+
+    double micros = 10'000;
+    uint32_t anchor = 0;
+    for(uint32_t pulse = 0; micros < end; pulse++)
+    {
+        double period = 60e6 / (FollowBPMAt(scenario, micros) * ppqn);
+        if(pulse == resetPulse) anchor = pulse;
+        if((pulse - anchor) % ppqn == 0) beats.push_back(micros);
+
+        double jitter = 0;
+        if(scenario.jitter == BENCH_JITTER_UNIFORM) jitter = (uniform() * 2 - 1) * scenario.jitterMicros;
+        else if(scenario.jitter == BENCH_JITTER_GAUSSIAN)
+        {
+            double u = fmax(uniform(), 1e-9);
+            jitter = sqrt(-2 * log(u)) * cos(2 * 3.14159265358979 * uniform()) * scenario.jitterMicros;
+        }
+        jitter = fmax(fmin(jitter, period / 4), -period / 4);
+        uint64_t edge = uint64_t(micros + jitter);
+        uint64_t width = min(uint64_t(BENCH_FOLLOW_PULSE_US), uint64_t(period / 4));
+
+        if(pulse == resetPulse)
+        {
+            //a sequencer's reset leads the clock it belongs to by a little
+            pins.push_back({edge - 100, GPIO_RST, false});
+            pins.push_back({edge - 100 + BENCH_FOLLOW_PULSE_US, GPIO_RST, true});
+        }
+        bool isDropped = scenario.dropEvery && pulse % scenario.dropEvery == scenario.dropEvery - 1;
+        bool isDoubled = scenario.doubleEvery && pulse % scenario.doubleEvery == scenario.doubleEvery - 1;
+        if(!isDropped)
+        {
+            if(isDoubled)
+            {
+                pins.push_back({edge, GPIO_CLK, false});
+                pins.push_back({edge + 500, GPIO_CLK, true});
+                pins.push_back({edge + 1000, GPIO_CLK, false});
+                pins.push_back({edge + 1000 + width, GPIO_CLK, true});
+            }
+            else
+            {
+                pins.push_back({edge, GPIO_CLK, false});
+                pins.push_back({edge + width, GPIO_CLK, true});
+            }
+            (*pulses)++;
+        }
+        micros += period;
+    }
+    std::stable_sort(pins.begin(), pins.end(), [](const BenchPinEvent &a, const BenchPinEvent &b) { return a.micros < b.micros; });
+}
+
+/// @brief Matches the quarter note gate's rising edges to the beats: each beat owns the time halfway to its
+/// @brief neighbours, its nearest edge there is its own, and any other edge there is spurious
+/// @note The gate is held high while stopped, so the first pulse can't raise it; scoring starts at the beat of its
+/// @note first rising edge, but the lock time runs from the first pulse.
+static void ScoreFollowEdges(const std::vector<double> &beats, const std::vector<uint64_t> &edges, BenchFollowResult &result)
+{
+    //the last beat has no window after it, so it only marks the end
+    uint32_t count = beats.size() > 1 ? uint32_t(beats.size() - 1) : 0;
+    std::vector<double> errors(count, -1);
+    std::vector<uint32_t> extras(count, 0);
+    size_t e = 0;
+    for(uint32_t b = 0; b < count; b++)
+    {
+        double from = b == 0 ? beats[0] - (beats[1] - beats[0]) / 2 : (beats[b - 1] + beats[b]) / 2;
+        double to = (beats[b] + beats[b + 1]) / 2;
+        while(e < edges.size() && double(edges[e]) < from) e++;
+        for(; e < edges.size() && double(edges[e]) < to; e++)
+        {
+            double error = fabs(double(edges[e]) - beats[b]);
+            if(errors[b] < 0) errors[b] = error;
+            else
+            {
+                extras[b]++;
+                errors[b] = fmin(errors[b], error);
+            }
+        }
+    }
+
+    uint32_t first = 0;
+    while(first < count && errors[first] < 0) first++;
+
+    uint32_t lockBeat = count;
+    for(uint32_t b = first; b + BENCH_FOLLOW_LOCK_BEATS <= count && lockBeat == count; b++)
+    {
+        bool isLocked = true;
+        for(uint32_t i = b; i < b + BENCH_FOLLOW_LOCK_BEATS; i++) isLocked = isLocked && errors[i] >= 0 && errors[i] <= BENCH_FOLLOW_LOCK_US;
+        if(isLocked) lockBeat = b;
+    }
+    if(lockBeat < count) result.lockMillis = (beats[lockBeat] - beats[0]) / 1000;
+
+    //once locked, every beat counts; a run that never locks is scored from its first edge
+    result.beats = count - first;
+    for(uint32_t b = lockBeat < count ? lockBeat : first; b < count; b++)
+    {
+        result.spurious += extras[b];
+        if(errors[b] < 0)
+        {
+            result.missed++;
+            continue;
+        }
+        result.matched++;
+        result.sumSquaredError += errors[b] * errors[b];
+        result.worstError = fmax(result.worstError, errors[b]);
+    }
+}
+
+/// @brief Plays a stream into CLOCK IN and RESET IN and follows it, with the fast path woken the way main.cpp's
+/// @brief alarm does. Gate out 0 is set to quarter notes and its rising edges are scored against the stream's beats.
+static void RunFollowScenario(const BenchFollowScenario &scenario, PPQNType ppqn, BenchFollowResult &result)
+{
+    std::vector<BenchPinEvent> pins;
+    std::vector<double> beats;
+    GenerateFollowStream(scenario, ppqn, pins, beats, &result.pulses);
+
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    HALSim::SetPin(GPIO_CLK, true);     //active low inputs, idle
+    HALSim::SetPin(GPIO_RST, true);
+    io.Init();
+    chronos.Init(&io);
+    GateOutputConfig quarters;
+    quarters.divisor = CHRONOS_TICKS_PER_QUARTER;
+    chronos.SetOutputConfig(0, quarters);
+    chronos.SetPPQN(ppqn);
+    chronos.SetBPM(120);
+    chronos.isPlayMode = false;
+
+    std::vector<uint64_t> edges;
+    const uint64_t endMicros = BENCH_FOLLOW_SECONDS * 1'000'000ULL;
+    const double firstBeat = beats.empty() ? 0 : beats[0];
+    size_t next = 0;
+    uint64_t now = 0;
+    uint64_t fastNext = 0;
+    uint64_t fastLast = 0;
+    uint64_t slowNext = 0;
+    bool wasGateOn = false;
+    while(now < endMicros)
+    {
+        while(next < pins.size() && pins[next].micros <= now)
+        {
+            HALSim::SetPin(pins[next].pin, pins[next].level);
+            next++;
+        }
+        if(now == fastNext)
+        {
+            chronos.FastUpdate(uint32_t(now - fastLast));
+            fastLast = now;
+            fastNext = now + chronos.GetMicrosUntilNextEdge();
+            bool isGateOn = (io.OUT_GATE_PINS >> GATE_OUT_PIN_BASE) & 1;
+            //the gate goes high as soon as it is stopped, which is no part of following the stream
+            if(isGateOn && !wasGateOn && next > 0) edges.push_back(now);
+            wasGateOn = isGateOn;
+        }
+        if(now == slowNext)
+        {
+            chronos.SlowUpdate(BENCH_SLOW_US);
+            slowNext = now + BENCH_SLOW_US;
+            //the tempo estimate is judged once the loop has had a few beats to settle
+            if(chronos.isFollowMode && now > firstBeat + 4 * 60e6 / scenario.fromBPM)
+            {
+                result.sumBPMError += fabs(chronos.GetEstimatedBPM() - FollowBPMAt(scenario, double(now)));
+                result.bpmSamples++;
+            }
+        }
+
+        uint64_t wake = min(min(fastNext, slowNext), endMicros);
+        if(next < pins.size()) wake = min(wake, pins[next].micros);
+        HALSim::AdvanceMicros(wake - now);
+        now = wake;
+    }
+    ScoreFollowEdges(beats, edges, result);
+}
+
+static void RunFollowBenchmark()
+{
+    //limits as {lock mS, rms uS, worst uS}. A steady clock locks on the second beat (the gate can't mark the first)
+    //and is followed to within a few times its own jitter. A ramp or step stays within 5 mS, under the 10-20 mS at
+    //which two hits start to sound like a flam. At 1 and 4 PPQN a ramp or step is heard only a few times a beat, so a
+    //ramp takes most of the run to learn and a step leaves a beat or two off the grid whatever the loop does; those
+    //rows are printed for information only
+    const BenchFollowScenario scenarios[] =
+    {
+        {"steady120",       120, 120, false, BENCH_JITTER_NONE,     0,   0, 0, false, {1000, 10,   20},   {1000,  10,    20}},
+        {"uniform250",      120, 120, false, BENCH_JITTER_UNIFORM,  250, 0, 0, false, {1000, 250,  600},  {1000,  250,   600}},
+        {"gaussian150",     120, 120, false, BENCH_JITTER_GAUSSIAN, 150, 0, 0, false, {1000, 200,  500},  {1000,  250,   800}},
+        {"ramp90to150",     90,  150, false, BENCH_JITTER_UNIFORM,  50,  0, 0, false, {4000, 120,  600},  BENCH_FOLLOW_INFO},
+        {"step120to140",    120, 140, true,  BENCH_JITTER_UNIFORM,  50,  0, 0, false, {1000, 800,  5000}, BENCH_FOLLOW_INFO},
+        {"step120to90",     120, 90,  true,  BENCH_JITTER_UNIFORM,  50,  0, 0, false, {1000, 800,  5000}, BENCH_FOLLOW_INFO},
+        {"step120to180",    120, 180, true,  BENCH_JITTER_UNIFORM,  50,  0, 0, false, {1000, 800,  5000}, BENCH_FOLLOW_INFO},
+        {"drop1in7",        120, 120, false, BENCH_JITTER_UNIFORM,  50,  7, 0, false, {1000, 60,   150},  {1000,  60,    150}},
+        {"double1in7",      120, 120, false, BENCH_JITTER_UNIFORM,  50,  0, 7, false, {1000, 300,  600},  {1000,  300,   600}},
+        {"resetmidbar",     120, 120, false, BENCH_JITTER_UNIFORM,  50,  0, 0, true,  {1000, 200,  400},  {1000,  200,   400}},
+    };
+    const PPQNType ppqns[] = {PPQN_1, PPQN_4, PPQN_8, PPQN_16, PPQN_24, PPQN_32, PPQN_48};
+
+    printf("\nfollow mode, %u s per scenario, gate out 0 at quarter notes:\n", BENCH_FOLLOW_SECONDS);
+    printf("scenario,ppqn,pulses,beats,lock_ms,bpm_err,rms_us,worst_us,missed,spurious,result\n");
+    for(const BenchFollowScenario &scenario : scenarios)
+    {
+        for(PPQNType ppqn : ppqns)
+        {
+            BenchFollowResult result;
+            RunFollowScenario(scenario, ppqn, result);
+            const BenchFollowLimits &limits = ppqn <= BENCH_FOLLOW_SPARSE_PPQN ? scenario.sparseLimits : scenario.limits;
+            printf("%s,%u,%u,%u,%.1f,%.3f,%.1f,%.1f,%u,%u,%s\n", scenario.name, uint32_t(ppqn), result.pulses, result.beats,
+                result.lockMillis, result.bpmSamples ? result.sumBPMError / result.bpmSamples : -1.0,
+                result.matched ? sqrt(result.sumSquaredError / result.matched) : -1.0, result.worstError,
+                result.missed, result.spurious, limits.lockMillis < 0 ? "info" : BenchVerdict(result.IsWithin(limits), "FAILED"));
+        }
+    }
+    printf("\n");
+}
+
+//-------- Tempo Glide: step response, quantised changes and phase continuity --------
+
+#define BENCH_GLIDE_FROM_BPM 100.0
+#define BENCH_GLIDE_TO_BPM 150.0
+/// When the slow path asks for the new tempo: 4.2 beats in at 100BPM, so quantised changes have to wait
+#define BENCH_GLIDE_STEP_US 2'530'000
+#define BENCH_GLIDE_SECONDS 8
+
+/// @brief How tempo changes are taken up in one glide scenario (see Chronos::SetTempoGlide)
+struct BenchGlideScenario
+{
+    const char *name;
+    uint32_t glideMicros;
+    float maxBPMPerSecond;
+    TempoQuantize quantize;
+};
+
+/// @brief Plays a gate out at 64th notes under a tempo schedule, with the edge scheduler
+/// @param bpmAt the tempo the slow path asks for at a time; called every mS
+/// @param rises filled with the uS of every rising edge
+template <typename BPMAt>
+static void RecordGlide(const BenchGlideScenario &scenario, BPMAt bpmAt, std::vector<uint64_t> &rises)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    GateOutputConfig sixtyFourths;
+    sixtyFourths.divisor = CHRONOS_TICKS_PER_QUARTER / 16;
+    chronos.SetOutputConfig(0, sixtyFourths);
+    chronos.SetTempoGlide(scenario.glideMicros, scenario.maxBPMPerSecond, scenario.quantize);
+    chronos.SetBPM(bpmAt(0));
+    chronos.isPlayMode = true;
+
+    const uint64_t endMicros = BENCH_GLIDE_SECONDS * 1'000'000ULL;
+    uint64_t now = 0;
+    uint64_t last = 0;
+    uint64_t nextSlow = 0;
+    bool wasHigh = false;
+    while(now < endMicros)
+    {
+        if(now >= nextSlow)
+        {
+            chronos.SetBPM(bpmAt(now));
+            nextSlow += BENCH_SLOW_US;
+        }
+        chronos.FastUpdate(uint32_t(now - last));
+        last = now;
+        bool isHigh = io.OUT_GATE_PINS & (1u << GATE_OUT_PIN_BASE);
+        if(isHigh && !wasHigh) rises.push_back(now);
+        wasHigh = isHigh;
+
+        uint64_t sleep = min(uint64_t(chronos.GetMicrosUntilNextEdge()), nextSlow - now);
+        now += sleep;
+        HALSim::AdvanceMicros(uint32_t(sleep));
+    }
+}
+
+static void RunGlideScenario(const BenchGlideScenario &scenario)
+{
+    std::vector<uint64_t> rises;
+    RecordGlide(scenario, [](uint64_t micros) { return float(micros < BENCH_GLIDE_STEP_US ? BENCH_GLIDE_FROM_BPM : BENCH_GLIDE_TO_BPM); }, rises);
+
+    //tempo of each 64th note, from one rise to the next
+    const double fromPeriod = 60e6 / (BENCH_GLIDE_FROM_BPM * 16);
+    const double toPeriod = 60e6 / (BENCH_GLIDE_TO_BPM * 16);
+    const double change = BENCH_GLIDE_TO_BPM - BENCH_GLIDE_FROM_BPM;
+    size_t first = 0;
+    double t90Ms = -1, t99Ms = -1;
+    double peakBPM = 0, worstRate = 0, previousPeriod = fromPeriod;
+    uint32_t jumps = 0;
+    for(size_t i = 1; i < rises.size(); i++)
+    {
+        double period = double(rises[i] - rises[i - 1]);
+        double bpm = 60e6 / (period * 16);
+        //a jump in musical time shows up as a 64th note shorter than the new tempo's or longer than the old one's,
+        //or as one that goes back toward the old tempo (edges are rounded to the uS, so 2uS either way is noise)
+        if(period < toPeriod - 2 || period > fromPeriod + 2 || period > previousPeriod + 2) jumps++;
+        if(i > 1)
+        {
+            double rate = (bpm - 60e6 / (previousPeriod * 16)) * 2e6 / double(rises[i] - rises[i - 2]);
+            if(rate > worstRate) worstRate = rate;
+        }
+        previousPeriod = period;
+        if(bpm > peakBPM) peakBPM = bpm;
+
+        if(first == 0 && fabs(period - fromPeriod) > 2) first = i;
+        if(first == 0) continue;
+        double progress = (bpm - BENCH_GLIDE_FROM_BPM) / change;
+        if(t90Ms < 0 && progress >= 0.9) t90Ms = (double(rises[i]) - rises[first - 1]) / 1000;
+        if(t99Ms < 0 && progress >= 0.99) t99Ms = (double(rises[i]) - rises[first - 1]) / 1000;
+    }
+    //when, and on which 64th note of the bar (rise 0 is the downbeat), the first 64th note that sped up started;
+    //a change taken up at once lands inside the one it was asked for in, which started before it
+    double startMs = first > 0 ? max(double(rises[first - 1]) - BENCH_GLIDE_STEP_US, 0.0) / 1000 : -1;
+    int startSixtyFourth = first > 0 ? int((first - 1) % 64) : -1;
+    printf("%-28s %10.1f %10d %10.1f %10.1f %10.2f %10.0f %10u\n", scenario.name, startMs, startSixtyFourth, t90Ms,
+        t99Ms, peakBPM - BENCH_GLIDE_TO_BPM, worstRate, jumps);
+}
+
+/// @brief Spread of the 64th note intervals with the slow path's target wandering +-1BPM around 120 every mS, as
+/// @brief knob or CV noise would; the first second is left out, so the glide from the first reading has settled
+static double GlideNoiseJitter(const BenchGlideScenario &scenario)
+{
+    uint32_t seed = 4242;
+    std::vector<uint64_t> rises;
+    RecordGlide(scenario, [&seed](uint64_t) { seed = seed * 1664525u + 1013904223u; return 120.0f + float(seed >> 8) / float(1 << 23) - 1; }, rises);
+    double sum = 0, sumSquared = 0;
+    uint32_t count = 0;
+    for(size_t i = 1; i < rises.size(); i++)
+    {
+        if(rises[i - 1] < 1'000'000) continue;
+        double period = double(rises[i] - rises[i - 1]);
+        sum += period;
+        sumSquared += period * period;
+        count++;
+    }
+    return sqrt(sumSquared / count - (sum / count) * (sum / count));
+}
+
+static void RunGlideBenchmark()
+{
+    const BenchGlideScenario scenarios[] =
+    {
+        {"step, no glide",              0,       0,   TEMPO_QUANTIZE_OFF},
+        {"glide 50mS (default)",        50'000,  0,   TEMPO_QUANTIZE_OFF},
+        {"glide 250mS",                 250'000, 0,   TEMPO_QUANTIZE_OFF},
+        {"ramp 100BPM/s",               0,       100, TEMPO_QUANTIZE_OFF},
+        {"glide 250mS, 100BPM/s max",   250'000, 100, TEMPO_QUANTIZE_OFF},
+        {"glide 50mS on the beat",      50'000,  0,   TEMPO_QUANTIZE_BEAT},
+        {"glide 50mS on the bar",       50'000,  0,   TEMPO_QUANTIZE_BAR},
+    };
+
+    printf("\ntempo %.0f to %.0fBPM, asked for %.2f beats in; 64th notes of gate out 0:\n", BENCH_GLIDE_FROM_BPM,
+        BENCH_GLIDE_TO_BPM, BENCH_GLIDE_STEP_US * BENCH_GLIDE_FROM_BPM / 60e6);
+    printf("%-28s %10s %10s %10s %10s %10s %10s %10s\n", "tempo glide", "starts mS", "on 64th", "90% mS", "99% mS",
+        "overshoot", "BPM/s", "jumps");
+    for(const BenchGlideScenario &scenario : scenarios) RunGlideScenario(scenario);
+
+    printf("%-28s %10s %10s %10s\n", "target 120+-1BPM every mS", "no glide", "50mS", "250mS");
+    printf("%-28s %10.2f %10.2f %10.2f\n", "64th note spread uS", GlideNoiseJitter(scenarios[0]),
+        GlideNoiseJitter(scenarios[1]), GlideNoiseJitter(scenarios[2]));
+}
+
+//-------- Reset: RESET IN to the outputs realigning, by quantisation --------
+
+#define BENCH_RESET_SECONDS 120
+#define BENCH_RESET_BPM 120.0
+/// PPQN of the generated CLOCK IN when following
+#define BENCH_RESET_PPQN 24
+/// Most a quantised reset's rise may be off its boundary
+#define BENCH_RESET_BOUNDARY_US 2
+/// Most a later bar start may be off the reset's grid: half a tick at BENCH_RESET_BPM, and a little over
+#define BENCH_RESET_GRID_US 20
+
+/// @brief Timing of the resets in one scenario, uS
+struct BenchResetResult
+{
+    uint32_t resets = 0;
+    double sumLatency = 0;
+    double worstLatency = 0;
+    /// @brief How far the rise that the reset made was from the boundary it should have been on
+    double worstOffBoundary = 0;
+    /// @brief How far any later bar start was from the grid the reset set up
+    double worstOffGrid = 0;
+    /// @brief Whether the resets waited for a boundary, rather than landing on the pulse
+    bool isQuantised = false;
+};
+
+/// @brief Plays (or follows an exact 120BPM CLOCK IN) with RESET IN pulsed at random times between the fast path's
+/// @brief wakeups, as the edge interrupt would. Gate out 0 is set to rise on each bar start only, so every rise is a
+/// @brief bar start on the grid or the one a reset just made; both are compared with the ideal timeline, which is
+/// @brief worked out from the pulse times alone. Pulses are kept clear of the gate's high time, where a reset would
+/// @brief leave it high and make no rise to time.
+static void RunResetScenario(ResetQuantize quantize, bool isFollowing, BenchResetResult &result)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    HALSim::SetPin(GPIO_CLK, true);
+    HALSim::SetPin(GPIO_RST, true);
+    io.Init();
+    chronos.Init(&io);
+    GateOutputConfig bars;
+    bars.divisor = CHRONOS_TICKS_PER_WHOLE;
+    bars.gateLength = GATE_LENGTH_FULL / 64;
+    chronos.SetOutputConfig(0, bars);
+    chronos.SetPPQN(PPQNType(BENCH_RESET_PPQN));
+    chronos.SetResetQuantize(quantize);
+    chronos.SetBPM(BENCH_RESET_BPM);
+    chronos.isPlayMode = !isFollowing;
+
+    const double microsPerTick = 60e6 / (BENCH_RESET_BPM * CHRONOS_TICKS_PER_QUARTER);
+    const double microsPerPulse = 60e6 / (BENCH_RESET_BPM * BENCH_RESET_PPQN);
+    const double barMicros = microsPerTick * CHRONOS_TICKS_PER_WHOLE;
+    const uint32_t quanta[] = {0, CHRONOS_TICKS_PER_QUARTER / 4, CHRONOS_TICKS_PER_QUARTER / 2, CHRONOS_TICKS_PER_QUARTER,
+        CHRONOS_TICKS_PER_WHOLE};
+    if(quantize == RESET_QUANTIZE_DEFAULT) quantize = isFollowing ? RESET_QUANTIZE_IMMEDIATE : RESET_QUANTIZE_8TH;
+    const double quantum = quanta[quantize];
+    result.isQuantised = quantum > 0;
+    const double graceTicks = CHRONOS_RESET_GRACE_US / microsPerTick;
+    const double gateTicks = CHRONOS_TICKS_PER_WHOLE / 64.0;
+    const uint64_t endMicros = BENCH_RESET_SECONDS * 1'000'000ULL;
+
+    //musical time is 0 here: the first update when playing, the first pulse when following
+    double anchor = isFollowing ? 1000 : 0;
+    uint64_t pulse = 0;
+    uint64_t nextPulse = isFollowing ? 1000 : UINT64_MAX;
+    uint32_t seed = 5;
+    uint64_t nextReset = 1'500'000;
+    double lastReset = -1;
+    double ideal = 0;
+    bool isAwaitingRise = false;
+    uint64_t now = 0;
+    uint64_t fastNext = 0;
+    uint64_t fastLast = 0;
+    bool wasGateOn = false;
+    while(now < endMicros)
+    {
+        if(now == nextPulse)
+        {
+            HALSim::SetPin(GPIO_CLK, false);
+            HALSim::SetPin(GPIO_CLK, true);
+            pulse++;
+            nextPulse = 1000 + uint64_t(llround(pulse * microsPerPulse));
+        }
+        //where the boundary is, from the timeline the last reset set up
+        double position = fmod((double(now) - anchor) / microsPerTick, CHRONOS_TICKS_PER_WHOLE);
+        if(now == nextReset && position < gateTicks + graceTicks) nextReset += 50'000;
+        if(now == nextReset)
+        {
+            HALSim::SetPin(GPIO_RST, false);
+            HALSim::SetPin(GPIO_RST, true);
+            double sinceBoundary = quantum > 0 ? fmod(position, quantum) : 0;
+            ideal = sinceBoundary <= graceTicks ? now - sinceBoundary * microsPerTick : now + (quantum - sinceBoundary) * microsPerTick;
+            lastReset = double(now);
+            isAwaitingRise = true;
+            //more than a bar apart, so only one is ever waiting
+            seed = seed * 1664525u + 1013904223u;
+            nextReset = now + 2'500'000 + (seed >> 8) % 3'000'000;
+        }
+        if(now == fastNext)
+        {
+            chronos.FastUpdate(uint32_t(now - fastLast));
+            fastLast = now;
+            fastNext = now + chronos.GetMicrosUntilNextEdge();
+            bool isGateOn = (io.OUT_GATE_PINS >> GATE_OUT_PIN_BASE) & 1;
+            if(isGateOn && !wasGateOn && now > 10'000)
+            {
+                double rise = double(now);
+                if(isAwaitingRise && rise >= lastReset)
+                {
+                    double latency = rise - lastReset;
+                    result.sumLatency += latency;
+                    result.worstLatency = max(result.worstLatency, latency);
+                    result.worstOffBoundary = max(result.worstOffBoundary, fabs(rise - ideal));
+                    result.resets++;
+                    anchor = ideal;
+                    isAwaitingRise = false;
+                }
+                else if(!isAwaitingRise)
+                {
+                    double bars = (rise - anchor) / barMicros;
+                    result.worstOffGrid = max(result.worstOffGrid, fabs(bars - round(bars)) * barMicros);
+                }
+            }
+            wasGateOn = isGateOn;
+        }
+
+        uint64_t wake = min(min(fastNext, nextReset), min(nextPulse, endMicros));
+        HALSim::AdvanceMicros(wake - now);
+        now = wake;
+    }
+}
+
+static void RunResetBenchmark()
+{
+    const char *names[] = {"immediate", "16th", "8th", "beat", "bar", "default"};
+    printf("\n%-28s %10s %10s %10s %10s %10s %10s\n", "reset in to outputs", "resets", "mean uS", "worst uS",
+        "boundary", "grid uS", "result");
+    for(int isFollowing = 0; isFollowing < 2; isFollowing++)
+    {
+        for(int quantize = RESET_QUANTIZE_IMMEDIATE; quantize <= RESET_QUANTIZE_DEFAULT; quantize++)
+        {
+            BenchResetResult result;
+            RunResetScenario(ResetQuantize(quantize), isFollowing, result);
+            char name[40];
+            snprintf(name, sizeof(name), "%s, %s", isFollowing ? "follow" : "play", names[quantize]);
+            //a quantised reset lands on its boundary to the uS; an immediate one on the next update, and within half a
+            //tick of the pulse musically
+            bool isOk = result.resets > 0 && result.worstOffGrid <= BENCH_RESET_GRID_US &&
+                result.worstOffBoundary <= (result.isQuantised ? BENCH_RESET_BOUNDARY_US : CHRONOS_MAX_SLEEP_US);
+            printf("%-28s %10u %10.0f %10.0f %10.1f %10.1f %10s\n", name, result.resets, result.sumLatency / result.resets,
+                result.worstLatency, result.worstOffBoundary, result.worstOffGrid, BenchVerdict(isOk, "FAILED"));
+        }
+    }
+}
+
+//-------- Configurations: fast update cost against PPQN and the output table --------
+
+#define BENCH_CONFIG_TICKS 2'000'000
+/// Runs per configuration; the fastest one is kept, the rest is mostly the desktop scheduler
+#define BENCH_CONFIG_RUNS 3
+
+/// @brief Mean ns per fast update at a 40uS tick, playing or following a CLOCK IN at 120BPM
+/// @param ppqn CLOCK IN PPQN to follow, 0 to play from the internal clock
+/// @param isModified put probability, ratchets, humanize and a pattern on every output
+/// @param isSpecialised let the fast path use its builds for the PPQN and the output layout
+/// @param fingerprint written with a hash of every update's gates and musical time, the same for either path
+static double TimeConfiguration(uint32_t ppqn, bool isModified, bool isSpecialised, uint64_t *fingerprint)
+{
+    using Clock = std::chrono::steady_clock;
+
+    double best = 0;
+    for(int run = 0; run < BENCH_CONFIG_RUNS; run++)
+    {
+        Chronos chronos;
+        IOHelper io;
+        HALSim::Reset();
+        HALSim::SetPin(GPIO_CLK, true);
+        HALSim::SetPin(GPIO_RST, true);
+        io.Init();
+        chronos.SetSpecialised(isSpecialised);
+        chronos.Init(&io);
+        if(ppqn > 0) chronos.SetPPQN(PPQNType(ppqn));
+        chronos.SetBPM(120);
+        chronos.isPlayMode = ppqn == 0;
+        for(uint8_t i = 0; i < NUM_GATE_OUTS && isModified; i++)
+        {
+            GateOutputConfig config = chronos.GetOutputConfig(i);
+            config.pattern = RhythmPattern::Euclidean(8, 5, 0);
+            config.patternSteps = 8;
+            config.probability = GATE_PROBABILITY_FULL * 3 / 4;
+            config.ratchets = 2;
+            config.humanizeTicks = 8 * CHRONOS_TICKS_PER_512TH;
+            chronos.SetOutputConfig(i, config);
+        }
+
+        const uint64_t clockPeriod = ppqn > 0 ? 500'000 / ppqn : 0;
+        uint64_t nextClock = 0;
+        double ns = 0;
+        uint64_t hash = 14695981039346656037ULL;
+        for(uint32_t tick = 0; tick < BENCH_CONFIG_TICKS; tick++)
+        {
+            uint64_t now = HAL::TimeMicros();
+            if(clockPeriod > 0 && now >= nextClock)
+            {
+                HALSim::SetPin(GPIO_CLK, false);
+                HALSim::SetPin(GPIO_CLK, true);
+                nextClock += clockPeriod;
+            }
+            Clock::time_point start = Clock::now();
+            chronos.FastUpdate(BENCH_TICK_US);
+            ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            hash = (hash ^ io.OUT_GATE_PINS ^ uint64_t(chronos.GetMicrosUntilNextEdge()) << 32) * 1099511628211ULL;
+            if(tick % 25 == 0) chronos.SlowUpdate(BENCH_SLOW_US);
+            MidiEvent event;
+            while(chronos.GetMidiEvents().Pop(&event)) {}
+            HALSim::AdvanceMicros(BENCH_TICK_US);
+        }
+        ns /= BENCH_CONFIG_TICKS;
+        if(run == 0 || ns < best) best = ns;
+        *fingerprint = hash;
+    }
+    return best;
+}
+
+/// The default gate out layout, as in Chronos.cpp, for timing GateOutputBank::AdvanceLayout on its own
+static constexpr GateOutputDefinition benchLayout[NUM_GATE_OUTS] =
+{
+    {512 * CHRONOS_TICKS_PER_512TH, GATE_LENGTH_FULL / 2, false},
+    {256 * CHRONOS_TICKS_PER_512TH, GATE_LENGTH_FULL / 2, false},
+    {128 * CHRONOS_TICKS_PER_512TH, GATE_LENGTH_FULL / 2, false},
+    {64 * CHRONOS_TICKS_PER_512TH,  GATE_LENGTH_FULL / 2, false},
+    {8 * CHRONOS_TICKS_PER_512TH,   GATE_LENGTH_FULL / 2, true},
+    {16 * CHRONOS_TICKS_PER_512TH,  GATE_LENGTH_FULL / 2, true},
+};
+
+/// @brief ns per gate out update, Advance against AdvanceLayout, on a steady play trajectory; beforehand both follow
+/// @brief a random one (steps back, jumps, resets and UD changes) and are checked against GetMaskAt at every step
+/// @param mismatches written with the steps where either disagreed with GetMaskAt
+static void TimeLayoutAdvance(double *genericNs, double *layoutNs, uint64_t *mismatches)
+{
+    using Clock = std::chrono::steady_clock;
+
+    GateOutputBank<NUM_GATE_OUTS> generic;
+    for(uint32_t i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        GateOutputConfig config;
+        config.divisor = benchLayout[i].divisor;
+        config.gateLength = benchLayout[i].gateLength;
+        config.isUserDivision = benchLayout[i].isUserDivision;
+        generic.SetConfig(i, config);
+    }
+    GateOutputBank<NUM_GATE_OUTS> layout = generic;
+    *mismatches = layout.IsLayout(benchLayout) ? 0 : 1;
+
+    uint32_t seed = 3;
+    uint32_t position = 0;
+    for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+    {
+        position = NextPosition(position, seed);
+        int64_t signedPosition = int32_t(position);
+        if(step % 50'000 == 0)
+        {
+            generic.SetUDShift(1 + (seed >> 24) % 7);
+            layout.SetUDShift(1 + (seed >> 24) % 7);
+        }
+        uint32_t expected = generic.GetMaskAt(signedPosition);
+        bool isOk = generic.Advance(signedPosition) == expected;
+        isOk = layout.AdvanceLayout<benchLayout>(signedPosition) == expected && isOk;
+        if(!isOk) (*mismatches)++;
+    }
+
+    volatile uint32_t sink = 0;
+    int64_t steady = 0;
+    Clock::time_point start = Clock::now();
+    for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+    {
+        steady += 21 + (step & 1);
+        sink = sink + generic.Advance(steady);
+    }
+    *genericNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+    steady = 0;
+    start = Clock::now();
+    for(int step = 0; step < BENCH_OUTPUT_STEPS; step++)
+    {
+        steady += 21 + (step & 1);
+        sink = sink + layout.AdvanceLayout<benchLayout>(steady);
+    }
+    *layoutNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+}
+
+/// @brief ns per PLL pulse (its Advance and OnPulse) on a slightly jittery 24 PPQN clock at 120BPM
+/// @tparam TICKS_PER_PULSE pulse spacing for OnPulse, 0 for the generic one
+template <uint64_t TICKS_PER_PULSE>
+static double TimePllPulses()
+{
+    using Clock = std::chrono::steady_clock;
+
+    PhaseLockedLoop pll;
+    pll.SetTicksPerPulse((uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) / PPQN_24);
+    pll.Start(uint32_t((uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) / 500'000));
+    volatile uint32_t sink = 0;
+    uint64_t now = 0;
+    uint32_t seed = 9;
+    Clock::time_point start = Clock::now();
+    for(int pulse = 0; pulse < BENCH_OUTPUT_STEPS; pulse++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t period = 20'833 + (seed >> 28);
+        pll.Advance(period);
+        now += period;
+        pll.OnPulse<TICKS_PER_PULSE>(now - (seed >> 30), now);
+        sink = sink + pll.GetTicks();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_OUTPUT_STEPS;
+}
+
+/// @brief The fast path's builds for one PPQN and the default output layout (see Chronos::SelectFastPath) against
+/// @brief the generic code, on the same input. The default table has the layout build; the modified one has no build
+/// @brief of its own, so only the PPQN one applies. Both paths must play exactly the same gates.
+static void RunConfigurationBenchmark()
+{
+    const uint32_t ppqns[] = {0, 1, 4, 8, 24, 48};
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "fast update ns by config", "generic", "specialised", "mod generic",
+        "mod special", "same gates");
+    for(uint32_t ppqn : ppqns)
+    {
+        char name[32];
+        if(ppqn == 0) snprintf(name, sizeof(name), "play");
+        else          snprintf(name, sizeof(name), "follow @%uppqn", ppqn);
+        uint64_t plainGeneric, plainSpecialised, modifiedGeneric, modifiedSpecialised;
+        double plain = TimeConfiguration(ppqn, false, false, &plainGeneric);
+        double special = TimeConfiguration(ppqn, false, true, &plainSpecialised);
+        double modified = TimeConfiguration(ppqn, true, false, &modifiedGeneric);
+        double modifiedSpecial = TimeConfiguration(ppqn, true, true, &modifiedSpecialised);
+        printf("%-28s %12.1f %12.1f %12.1f %12.1f %12s\n", name, plain, special, modified, modifiedSpecial,
+            BenchVerdict(plainGeneric == plainSpecialised && modifiedGeneric == modifiedSpecialised));
+    }
+
+    double genericNs, layoutNs;
+    uint64_t mismatches;
+    TimeLayoutAdvance(&genericNs, &layoutNs, &mismatches);
+    printf("%-28s %12s %12s %12s\n", "", "generic ns", "special ns", "mismatches");
+    printf("%-28s %12.2f %12.2f %12llu\n", "gate outs, default layout", genericNs, layoutNs, (unsigned long long)mismatches);
+    if(mismatches) benchFailures++;
+    printf("%-28s %12.2f %12.2f\n", "pll pulse, 24ppqn", TimePllPulses<0>(),
+        TimePllPulses<(uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) / PPQN_24>());
+}
+
+//-------- Swing: table warp against the original cos() curve --------
+
+/// @brief The original double precision curve from Chronos::CalculateSwing, kept as a baseline
+static uint32_t LegacySwing(uint32_t beatTime, uint16_t swing, double swingsPerBar)
+{
+    uint32_t barTime = (beatTime%512)*128;
+    uint32_t swingTime = beatTime + (cos(barTime / (65535/(2*3.141592*swingsPerBar)))*(9300/swingsPerBar) - (9300/swingsPerBar))/128;
+    return lerp((double)beatTime, (double)swingTime, (double)swing/4096.0);
+}
+
+/// Worst disagreement with the old curve in 512th notes at full resolution: the old one truncated to whole 512ths,
+/// plus an eighth for the table's interpolation
+#define BENCH_SWING_WORST_FINE 1.125
+
+static void RunSwingBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const float swingsPerBars[] = {1, 3, 4, 6.5f};
+    const uint16_t amounts[] = {301, 1024, 2048, 4095, 4096};
+
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "swing warp", "legacy ns", "table ns", "worst ticks", "worst fine", "result");
+    for(float swingsPerBar : swingsPerBars)
+    {
+        //the old 512 ticks per bar, where it can be compared tick for tick, and Chronos' own resolution
+        SwingWarp warp;
+        warp.SetSwingsPerBar(swingsPerBar, 512);
+        SwingWarp fineWarp;
+        fineWarp.SetSwingsPerBar(swingsPerBar, CHRONOS_TICKS_PER_WHOLE);
+
+        //worst disagreement over every position of a few bars (skipping the first, where the old curve went negative)
+        int32_t worst = 0;
+        double worstFine = 0; //in 512th notes
+        for(uint16_t amount : amounts)
+        {
+            for(uint32_t beatTime = 512; beatTime < 512 * 8; beatTime++)
+            {
+                uint32_t legacy = LegacySwing(beatTime, amount, swingsPerBar);
+                int32_t difference = abs(int32_t(beatTime - warp.GetDelay(beatTime % 512, amount) - legacy));
+                if(difference > worst) worst = difference;
+                uint32_t fineTicks = (beatTime % 512) * CHRONOS_TICKS_PER_512TH;
+                double fine = beatTime - double(fineWarp.GetDelay(fineTicks, amount)) / CHRONOS_TICKS_PER_512TH;
+                if(fabs(fine - legacy) > worstFine) worstFine = fabs(fine - legacy);
+            }
+        }
+
+        //the host has an FPU, so this understates the gap on the M0+, where every double op is a library call
+        volatile uint32_t sink = 0;
+        Clock::time_point start = Clock::now();
+        for(uint32_t beatTime = 512; beatTime < 512 + BENCH_PULSES; beatTime++) sink = sink + LegacySwing(beatTime, 2048, swingsPerBar);
+        double legacyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_PULSES;
+        start = Clock::now();
+        for(uint32_t barTicks = 0; barTicks < BENCH_PULSES; barTicks++) sink = sink + fineWarp.GetDelay(barTicks % CHRONOS_TICKS_PER_WHOLE, 2048);
+        double tableNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_PULSES;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%.1f swings/bar", swingsPerBar);
+        printf("%-28s %12.1f %12.1f %12i %12.2f %12s\n", name, legacyNs, tableNs, worst, worstFine,
+            BenchVerdict(worst <= 1 && worstFine <= BENCH_SWING_WORST_FINE));
+    }
+}
+
+//-------- Snapshot Mailbox: two threads standing in for the two cores --------
+
+#define BENCH_MAILBOX_WRITES 2'000'000
+
+/// @brief Every field is derived from the same counter, so a torn read shows up as a mismatch
+struct BenchSnapshot
+{
+    uint64_t counter;
+    uint32_t doubled;
+    uint32_t inverted;
+    int16_t low;
+    uint8_t check;
+};
+
+static bool IsConsistent(const BenchSnapshot &snapshot)
+{
+    return snapshot.doubled == uint32_t(snapshot.counter * 2) && snapshot.inverted == ~uint32_t(snapshot.counter)
+        && snapshot.low == int16_t(snapshot.counter) && snapshot.check == uint8_t(snapshot.counter * 7);
+}
+
+static void RunMailboxStress()
+{
+    static SnapshotMailbox<BenchSnapshot> mailbox;
+    std::atomic<bool> isDone{false};
+
+    std::thread writer([&]
+    {
+        for(uint64_t i = 1; i <= BENCH_MAILBOX_WRITES; i++)
+        {
+            mailbox.Write({i, uint32_t(i * 2), ~uint32_t(i), int16_t(i), uint8_t(i * 7)});
+            //a varying gap, so reads land at every point of a write; back to back writes would just starve the reader
+            for(volatile uint32_t spin = 0; spin < (uint32_t(i) * 2654435761u) >> 26; spin++) {}
+        }
+        isDone.store(true, std::memory_order_release);
+    });
+
+    uint64_t reads = 0;
+    uint64_t busy = 0;
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+    uint64_t last = 0;
+    BenchSnapshot snapshot = {};
+    while(!isDone.load(std::memory_order_acquire))
+    {
+        if(!mailbox.TryRead(&snapshot))
+        {
+            busy++;
+            continue;
+        }
+        if(snapshot.counter == 0) continue; //the writer hadn't started yet (asking GetVersion now would be too late)
+        reads++;
+        if(!IsConsistent(snapshot)) torn++;
+        if(snapshot.counter < last) backwards++;
+        last = snapshot.counter;
+    }
+    writer.join();
+    mailbox.Read(&snapshot);
+
+    printf("\n%-28s %12s %12s %12s %12s\n", "snapshot mailbox", "reads", "busy", "torn", "backwards");
+    printf("%-28s %12llu %12llu %12llu %12llu\n", snapshot.counter == BENCH_MAILBOX_WRITES ? "2 threads" : "2 threads (LOST LAST)",
+        (unsigned long long)reads, (unsigned long long)busy, (unsigned long long)torn, (unsigned long long)backwards);
+    if(torn || backwards || snapshot.counter != BENCH_MAILBOX_WRITES) benchFailures++;
+}
+
+//-------- Trace Log: per call cost, what a slow USB port loses, and a two thread stress --------
+
+#define BENCH_TRACE_CALLS 5'000'000
+#define BENCH_TRACE_SECONDS 2
+/// USB serial bytes free per 1mS loop: the CDC TX FIFO (CFG_TUD_CDC_TX_BUFSIZE), emptied once a frame
+#define BENCH_TRACE_ROOM_PER_LOOP 256
+#define BENCH_TRACE_STRESS_RECORDS 40'000
+
+/// @brief One frame parsed back out of the serial log, as tools/trace_decode.py would
+struct BenchTraceFrame
+{
+    uint8_t core;
+    uint8_t argCount;
+    uint16_t id;
+    uint64_t timeMicros;
+    int32_t args[TRACE_MAX_ARGS];
+};
+
+/// @brief Parses the simulated serial log, resyncing on the sync bytes like the decoder
+/// @return frames with a bad checksum or argument count
+static uint32_t ParseTraceLog(std::vector<BenchTraceFrame> &frames)
+{
+    const uint8_t *bytes = HALSim::GetSerialLog();
+    uint32_t count = min(HALSim::GetSerialLogCount(), uint32_t(HAL_SIM_SERIAL_LOG_SIZE));
+    uint32_t bad = 0;
+    uint32_t i = 0;
+    while(i + TRACE_FRAME_SIZE(0) <= count)
+    {
+        if(bytes[i] != TRACE_SYNC_0 || bytes[i + 1] != TRACE_SYNC_1) { i++; continue; }
+        BenchTraceFrame frame;
+        frame.core = bytes[i + 2] >> 4;
+        frame.argCount = bytes[i + 2] & 0x0F;
+        uint32_t length = TRACE_FRAME_SIZE(frame.argCount);
+        if(frame.argCount > TRACE_MAX_ARGS || i + length > count) { bad++; i++; continue; }
+        uint8_t checksum = 0;
+        for(uint32_t j = 2; j < length - 1; j++) checksum += bytes[i + j];
+        if(checksum != bytes[i + length - 1]) { bad++; i++; continue; }
+        frame.id = uint16_t(bytes[i + 3] | bytes[i + 4] << 8);
+        frame.timeMicros = 0;
+        for(uint32_t j = 0; j < 8; j++) frame.timeMicros |= uint64_t(bytes[i + 5 + j]) << (8 * j);
+        for(uint32_t a = 0; a < frame.argCount; a++)
+        {
+            const uint8_t *arg = bytes + i + 13 + 4 * a;
+            frame.args[a] = int32_t(uint32_t(arg[0]) | uint32_t(arg[1]) << 8 | uint32_t(arg[2]) << 16 | uint32_t(arg[3]) << 24);
+        }
+        frames.push_back(frame);
+        i += length;
+    }
+    return bad;
+}
+
+/// @brief Sends everything still in the rings and starts a fresh serial log
+static void FlushTraceLog()
+{
+    HALSim::SetSerialRoom(UINT32_MAX);
+    while(TraceLog::Drain() > 0) {}
+    HALSim::Reset();
+}
+
+/// @brief Checks a parsed log of TRACE_MIDI_IN records numbered 0 up, against the drop reports in it
+/// @return records that went missing without being reported, or were repeated or out of order
+static uint64_t CheckTraceSequence(const std::vector<BenchTraceFrame> &frames, uint64_t *delivered, uint64_t *reported)
+{
+    uint64_t errors = 0;
+    int64_t next = 0;
+    for(const BenchTraceFrame &frame : frames)
+    {
+        if(frame.id == TRACE_DROPPED)
+        {
+            *reported += uint32_t(frame.args[0]);
+            next += frame.args[0]; //the lost ones were the next numbers
+        }
+        else
+        {
+            (*delivered)++;
+            if(frame.args[0] != next) errors++;
+            next = int64_t(frame.args[0]) + 1;
+        }
+    }
+    return errors;
+}
+
+static void RunTraceBenchmark()
+{
+    FlushTraceLog();
+
+    //per call: the trace against formatting the old debug() line, both without the serial port
+    double logNs = 0;
+    for(uint32_t i = 0; i < BENCH_TRACE_CALLS; i += TRACE_RING_SIZE / 2)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t j = 0; j < TRACE_RING_SIZE / 2; j++) TraceLog::Log(TRACE_SET_BPM, int32_t(i + j), 500, 20'000);
+        logNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        HALSim::SetSerialRoom(UINT32_MAX);
+        while(TraceLog::Drain() > 0) {}
+        HALSim::Reset();
+    }
+    char text[64];
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < BENCH_TRACE_CALLS; i++)
+    {
+        sink += snprintf(text, sizeof(text), "CALCULATING VALUES FOR BPM: %f\n", 120.0 + i * 1e-6);
+    }
+    double printfNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n%-28s %12s %12s %12s\n", "trace log per call", "trace ns", "printf ns", "frame bytes");
+    printf("%-28s %12.1f %12.1f %12u\n", "3 args", logNs / BENCH_TRACE_CALLS, printfNs / BENCH_TRACE_CALLS, TRACE_FRAME_SIZE(3));
+
+    //a steady rate of records, drained every mS into a port that takes BENCH_TRACE_ROOM_PER_LOOP bytes a loop
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "trace log, 1mS drain", "logged", "delivered", "dropped", "reported", "check");
+    const uint32_t rates[] = {1'000, 5'000, 10'000, 20'000, 50'000};
+    for(uint32_t rate : rates)
+    {
+        FlushTraceLog();
+        uint32_t droppedBefore = TraceLog::GetDroppedCount();
+        uint64_t logged = 0;
+        uint64_t microsPerRecord = 1'000'000 / rate;
+        for(uint64_t micros = 0; micros < BENCH_TRACE_SECONDS * 1'000'000ULL; micros++)
+        {
+            if(micros % microsPerRecord == 0) TraceLog::Log(TRACE_MIDI_IN, int32_t(logged++));
+            if(micros % 1000 == 999)
+            {
+                HALSim::SetSerialRoom(BENCH_TRACE_ROOM_PER_LOOP);
+                TraceLog::Drain();
+            }
+            HALSim::AdvanceMicros(1);
+        }
+        //one more once there's room, so losses right at the end are reported too
+        HALSim::SetSerialRoom(UINT32_MAX);
+        while(TraceLog::Drain() > 0) {}
+        TraceLog::Log(TRACE_MIDI_IN, int32_t(logged++));
+        TraceLog::Drain();
+
+        std::vector<BenchTraceFrame> frames;
+        uint32_t bad = ParseTraceLog(frames);
+        uint64_t delivered = 0;
+        uint64_t reported = 0;
+        uint64_t errors = CheckTraceSequence(frames, &delivered, &reported) + bad;
+        uint32_t dropped = TraceLog::GetDroppedCount() - droppedBefore;
+        bool isOk = errors == 0 && delivered + reported == logged && reported == dropped;
+        char name[32];
+        snprintf(name, sizeof(name), "%u records/s", rate);
+        printf("%-28s %12llu %12llu %12u %12llu %12s\n", name, (unsigned long long)logged, (unsigned long long)delivered,
+            dropped, (unsigned long long)reported, BenchVerdict(isOk));
+    }
+
+    //a producer thread logging in bursts against a consumer thread draining whenever it likes
+    FlushTraceLog();
+    uint32_t droppedBefore = TraceLog::GetDroppedCount();
+    std::atomic<bool> isDone{false};
+    std::thread producer([&]
+    {
+        for(uint32_t i = 0; i < BENCH_TRACE_STRESS_RECORDS; i++)
+        {
+            TraceLog::Log(TRACE_MIDI_IN, int32_t(i));
+            for(volatile uint32_t spin = 0; spin < (i * 2654435761u) >> 23; spin++) {}
+            if(i % 32 == 0) std::this_thread::yield(); //so the two still interleave on a single CPU host
+        }
+        isDone.store(true, std::memory_order_release);
+    });
+    uint32_t seed = 1;
+    while(!isDone.load(std::memory_order_acquire))
+    {
+        while(TraceLog::Drain() > 0) {}
+        //stall now and then, as a loop busy with something else would, so the ring sometimes fills
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t stall = (seed >> 16) < 0x1000 ? seed >> 12 : 0;
+        for(volatile uint32_t spin = 0; spin < stall; spin++) {}
+    }
+    producer.join();
+    while(TraceLog::Drain() > 0) {}
+    TraceLog::Log(TRACE_MIDI_IN, BENCH_TRACE_STRESS_RECORDS);
+    TraceLog::Drain();
+
+    std::vector<BenchTraceFrame> frames;
+    uint32_t bad = ParseTraceLog(frames);
+    uint64_t delivered = 0;
+    uint64_t reported = 0;
+    uint64_t errors = CheckTraceSequence(frames, &delivered, &reported) + bad;
+    uint32_t dropped = TraceLog::GetDroppedCount() - droppedBefore;
+    bool isOk = errors == 0 && delivered + reported == BENCH_TRACE_STRESS_RECORDS + 1 && reported == dropped;
+    printf("%-28s %12u %12llu %12u %12llu %12s\n", "2 threads", BENCH_TRACE_STRESS_RECORDS + 1, (unsigned long long)delivered,
+        dropped, (unsigned long long)reported, BenchVerdict(isOk));
+    HALSim::Reset();
+}
+
+//-------- ADC Scan: schedule and knob latency against the old blocking reads --------
+
+#define BENCH_ADC_STEPS 200
+/// Main loop pass of the old firmware: 7 blocking 100uS reads plus the 1mS sleep
+#define BENCH_ADC_LEGACY_FRAME_US (7 * 100 + 1000)
+#define BENCH_ADC_FRAME_US 1000
+
+static void RunAdcScanBenchmark()
+{
+    //--------Schedule--------
+
+    //the knobs once a round, the CVs twice
+    const uint8_t rates[7] = {1, 1, 1, 2, 2, 2, 2};
+    AdcScanner scanner;
+    for(int i = 0; i < 7; i++) scanner.SetChannelRate(i, rates[i]);
+    scanner.BuildSchedule();
+    const double dwellMicros = ADC_SCAN_DWELL_SAMPLES * 1e6 / ADC_SCAN_SAMPLE_RATE;
+    const double roundMicros = dwellMicros * scanner.GetNumSlots();
+
+    //a CV has to be fresh for every ReadSlowInputs pass, a knob (at half the rate) for every other one
+    printf("\n%-28s %12s %12s %12s %12s\n", "adc scan channel", "updates/s", "worst gap uS", "ideal gap uS", "result");
+    for(int channel = 0; channel < 7; channel++)
+    {
+        //largest distance between visits, wrapping around the round
+        int visits = 0;
+        int first = -1;
+        int last = -1;
+        int worstGap = 0;
+        for(int s = 0; s < scanner.GetNumSlots(); s++)
+        {
+            if(scanner.GetSlotChannel(s) != channel) continue;
+            if(last >= 0 && s - last > worstGap) worstGap = s - last;
+            if(first < 0) first = s;
+            last = s;
+            visits++;
+        }
+        if(first + scanner.GetNumSlots() - last > worstGap) worstGap = first + scanner.GetNumSlots() - last;
+        char name[32];
+        snprintf(name, sizeof(name), "mux %i", channel);
+        double gapLimit = BENCH_ADC_FRAME_US * 2 / rates[channel];
+        printf("%-28s %12.0f %12.0f %12.0f %12s\n", name, visits * 1e6 / roundMicros, worstGap * dwellMicros, roundMicros / visits,
+            BenchVerdict(worstGap * dwellMicros <= gapLimit));
+    }
+
+    //--------Interrupt cost--------
+
+    using Clock = std::chrono::steady_clock;
+    uint16_t samples[ADC_SCAN_DWELL_SAMPLES];
+    for(int i = 0; i < ADC_SCAN_DWELL_SAMPLES; i++) samples[i] = uint16_t(2000 + i);
+    volatile uint32_t sink = 0;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < BENCH_PULSES; i++) sink = sink + scanner.OnDwellDone(samples, ADC_SCAN_DWELL_SAMPLES);
+    double dwellNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BENCH_PULSES;
+
+    //--------Knob step latency, through ReadSlowInputs--------
+
+    double sumLatency = 0;
+    double worstLatency = 0;
+    double sumLegacy = 0;
+    double worstLegacy = 0;
+    uint32_t seed = 7;
+    for(int step = 0; step < BENCH_ADC_STEPS; step++)
+    {
+        IOHelper io;
+        HALSim::Reset();
+        io.Init();
+        io.StartAdcScan();
+        HALSim::AdvanceMicros(20'000);
+        io.ReadSlowInputs(BENCH_ADC_FRAME_US);
+
+        //turn the BPM knob all the way at a random point of the main loop
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t stepMicros = (seed >> 8) % 5000;
+        uint64_t frame = HAL::TimeMicros();
+        HALSim::AdvanceMicros(stepMicros);
+        uint64_t stepTime = HAL::TimeMicros();
+        HALSim::SetAdcChannel(1, 4000);
+        while(true)
+        {
+            frame += BENCH_ADC_FRAME_US;
+            if(frame < stepTime) continue;
+            HALSim::AdvanceMicros(frame - HAL::TimeMicros());
+            io.ReadSlowInputs(BENCH_ADC_FRAME_US);
+            if(io.IN_BPM_KNOB >= 3600) break;
+        }
+        double latency = double(frame - stepTime);
+        sumLatency += latency;
+        if(latency > worstLatency) worstLatency = latency;
+
+        //the old loop read the BPM knob 200uS into each pass, after the swing knob and its own settling delay
+        uint32_t phase = stepMicros % BENCH_ADC_LEGACY_FRAME_US;
+        double legacy = phase <= 200 ? 200 - phase : BENCH_ADC_LEGACY_FRAME_US - phase + 200;
+        sumLegacy += legacy;
+        if(legacy > worstLegacy) worstLegacy = legacy;
+    }
+
+    //nothing blocks any more, and a knob turn must get through no later than it did through the blocking reads
+    printf("\n%-28s %12s %12s %12s %12s\n", "knob read", "blocked uS", "mean lat uS", "worst lat uS", "result");
+    printf("%-28s %12i %12.0f %12.0f\n", "legacy blocking reads", 7 * 100, sumLegacy / BENCH_ADC_STEPS, worstLegacy);
+    printf("%-28s %12i %12.0f %12.0f %12s\n", "background scan", 0, sumLatency / BENCH_ADC_STEPS, worstLatency,
+        BenchVerdict(worstLatency <= worstLegacy));
+    printf("%-28s %12.1f\n", "scan interrupt ns/dwell", dwellNs);
+}
+
+//-------- CV Filters: step response and noise on synthetic ADC traces --------
+
+/// ReadSlowInputs samples per second
+#define BENCH_CV_RATE 1000
+#define BENCH_CV_NOISE_SAMPLES 20'000
+
+/// @brief The original smoothing from ReadSlowInputs: the previous value seven times plus the new sample, over 8
+struct LegacyCVFilter
+{
+    int16_t raw = 0;
+    int32_t Process(int32_t x)
+    {
+        raw += raw + raw + raw + raw + raw + raw + x;
+        raw /= 8;
+        return raw;
+    }
+    void Reset(int32_t x) { raw = x; }
+};
+
+/// @brief One ADC scan dwell average at a level: ~3LSB RMS of converter noise per sample, and now and then a spike
+static int32_t NoisySample(double level, uint32_t &seed)
+{
+    double sum = 0;
+    for(int i = 0; i < ADC_SCAN_KEEP_SAMPLES; i++)
+    {
+        //sum of uniforms, close enough to gaussian: 12 uniforms in [-0.5, 0.5) have a variance of 1
+        double gaussian = 0;
+        for(int k = 0; k < 12; k++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            gaussian += (seed >> 8) / 16777216.0 - 0.5;
+        }
+        sum += level + 3.0 * gaussian;
+    }
+    seed = seed * 1664525u + 1013904223u;
+    double spike = (seed >> 8) % 200 == 0 ? ((seed & 1) ? 40 : -40) : 0;
+    return int32_t(lround(sum / ADC_SCAN_KEEP_SAMPLES + spike));
+}
+
+/// @brief Steps and holds a filter on noisy samples and prints its row
+/// @param maxRiseMillis 90% rise the filter must beat, 0 for a candidate that is only shown
+/// @return the 90% rise in mS
+template <typename Filter>
+static double RunCVFilterScenario(const char *name, double maxRiseMillis = 0)
+{
+    //--------Step: 0V to 5V on a bipolar CV in (2300 to 340 raw)--------
+    Filter filter;
+    uint32_t seed = 99;
+    filter.Reset(2300);
+    for(int i = 0; i < 200; i++) filter.Process(NoisySample(2300, seed));
+    int rise = -1;
+    int settle = -1;
+    for(int i = 0; i < 500; i++)
+    {
+        int32_t y = filter.Process(NoisySample(340, seed));
+        if(rise < 0 && y <= 340 + 196) rise = i + 1;      //90% of the step
+        if(abs(y - 340) > 4) settle = -1;                   //within 4LSB (about 10mV) and staying there
+        else if(settle < 0) settle = i + 1;
+    }
+
+    //--------Static noise at a steady level--------
+    filter.Reset(1500);
+    for(int i = 0; i < 200; i++) filter.Process(NoisySample(1500, seed));
+    int32_t lowest = INT32_MAX;
+    int32_t highest = INT32_MIN;
+    double sumSquares = 0;
+    uint32_t changes = 0;
+    int32_t last = filter.Process(NoisySample(1500, seed));
+    for(int i = 0; i < BENCH_CV_NOISE_SAMPLES; i++)
+    {
+        int32_t y = filter.Process(NoisySample(1500, seed));
+        lowest = min(lowest, y);
+        highest = max(highest, y);
+        sumSquares += double(y - 1500) * double(y - 1500);
+        if(y != last) changes++;
+        last = y;
+    }
+    double riseMillis = rise * 1000.0 / BENCH_CV_RATE;
+    double rms = sqrt(sumSquares / BENCH_CV_NOISE_SAMPLES);
+    printf("%-28s %12.0f %12.0f %12.2f %12i %12.0f %12s\n", name, riseMillis, settle * 1000.0 / BENCH_CV_RATE, rms,
+        highest - lowest, changes * double(BENCH_CV_RATE) / BENCH_CV_NOISE_SAMPLES,
+        maxRiseMillis > 0 ? BenchVerdict(rise > 0 && riseMillis < maxRiseMillis && rms < 1.0) : "-");
+    return riseMillis;
+}
+
+static void RunCVFilterBenchmark()
+{
+    //the filters IOHelper uses have to step faster than the old 7/8 and hold static noise under a LSB; the rest are
+    //candidates, shown for comparison
+    printf("\n%-28s %12s %12s %12s %12s %12s %12s\n", "cv filter", "90% mS", "settle mS", "rms LSB", "p-p LSB", "changes/s",
+        "result");
+    double legacyRise = RunCVFilterScenario<LegacyCVFilter>("legacy 7/8");
+    RunCVFilterScenario<OnePoleFilter<3>>("one-pole 1/8");
+    RunCVFilterScenario<MedianFilter<5>>("median 5");
+    RunCVFilterScenario<AdaptiveFilter<6, 6>>("adaptive 6,6");
+    RunCVFilterScenario<IOHelper::ScrubCVFilter>("scrub/tmult/swing filter", legacyRise);
+    RunCVFilterScenario<IOHelper::UDCVFilter>("UD filter", legacyRise);
+}
+
+//-------- Calibration: flash record wear levelling and the multiply-shift transform --------
+
+#define BENCH_CAL_SAVES 300
+#define BENCH_CAL_PASSES 2'000
+
+/// @brief The original IOHelper::GetCalibratedValue, kept as a baseline
+static int16_t LegacyCalibratedValue(uint16_t adcValue, uint16_t zero, uint16_t five)
+{
+    long adcValueReal = long(adcValue)*256L;
+    adcValueReal -= long(zero)*256L;
+    adcValueReal *= long((five - zero));
+    adcValueReal /= 4096L;
+    adcValueReal -= long(zero);
+    adcValueReal /= 128L;
+    if(adcValueReal >= INT16_MAX)       adcValueReal = INT16_MAX - 1;
+    else if(adcValueReal <= INT16_MIN)  adcValueReal = INT16_MIN + 1;
+    return adcValueReal;
+}
+
+/// @brief Clears the CRC of the record with the given sequence, as a power cut mid-program would
+static bool CorruptRecord(uint32_t sequence)
+{
+    const uint8_t *storage = HAL::FlashStorage();
+    for(uint32_t offset = 0; offset < HAL_FLASH_STORAGE_SIZE; offset += CAL_RECORD_SIZE)
+    {
+        CalibrationRecord record;
+        memcpy(&record, storage + offset, CAL_RECORD_SIZE);
+        if(record.magic != CAL_RECORD_MAGIC || record.sequence != sequence) continue;
+        uint8_t page[HAL_FLASH_PAGE_SIZE];
+        memset(page, 0xFF, sizeof(page));
+        uint32_t pageOffset = offset & ~uint32_t(HAL_FLASH_PAGE_SIZE - 1);
+        page[offset - pageOffset + offsetof(CalibrationRecord, crc)] = 0;
+        HAL::FlashStorageProgram(pageOffset, page);
+        return true;
+    }
+    return false;
+}
+
+/// @brief Starts the flash over with records 1 to count. With isEraseCut the power went just after the save that
+/// @brief first moved to the second sector had written its record, so the full first sector was never erased
+static void FillCalibrationFlash(Calibration &calibration, uint32_t count, bool isEraseCut)
+{
+    const uint32_t slotsPerSector = HAL_FLASH_SECTOR_SIZE / CAL_RECORD_SIZE;
+    HALSim::WipeFlash();
+    calibration.SetDefaults();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        HALSim::SetFlashPowerCut(isEraseCut && i == slotsPerSector ? 1 : UINT32_MAX);
+        calibration.Save();
+    }
+    HALSim::SetFlashPowerCut(UINT32_MAX);
+}
+
+/// @brief Fills the flash up to a sector switch, then cuts the power after each flash operation of the save that
+/// @brief switches in turn
+/// @return cuts after which the calibration came back as defaults or as anything older than the last record
+static uint32_t CutSectorSwitch(uint32_t count, bool isEraseCut, uint32_t &cuts)
+{
+    uint32_t lost = 0;
+    //at most: erase the other sector, program the record, erase the full sector
+    for(uint32_t operations = 0; operations <= 3; operations++)
+    {
+        Calibration calibration;
+        Calibration loaded;
+        FillCalibrationFlash(calibration, count, isEraseCut);
+        HALSim::SetFlashPowerCut(operations);
+        calibration.Save();
+        HALSim::SetFlashPowerCut(UINT32_MAX);
+        if(!loaded.Load() || loaded.GetSequence() < count) lost++;
+        cuts++;
+    }
+    return lost;
+}
+
+static void RunCalibrationBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    //--------Save/load round trips through the simulated flash sector--------
+    HALSim::WipeFlash();
+    uint32_t erasesBefore = HALSim::GetFlashEraseCount();
+    Calibration saved;
+    Calibration loaded;
+    bool isFreshDefault = !loaded.Load() && loaded.GetSequence() == 0;
+    saved.SetDefaults();
+    uint32_t mismatches = 0;
+    for(int i = 0; i < BENCH_CAL_SAVES; i++)
+    {
+        for(int channel = 0; channel < CAL_NUM_CHANNELS; channel++)
+        {
+            saved.SetPoints(channel, {uint16_t(2200 + (i * 7 + channel) % 200), uint16_t(300 + (i * 13 + channel) % 100)});
+        }
+        if(!saved.Save() || !loaded.Load() || loaded.GetSequence() != saved.GetSequence()) { mismatches++; continue; }
+        for(int channel = 0; channel < CAL_NUM_CHANNELS; channel++)
+        {
+            if(loaded.GetPoints(channel).zero != saved.GetPoints(channel).zero ||
+               loaded.GetPoints(channel).five != saved.GetPoints(channel).five) mismatches++;
+        }
+    }
+    uint32_t erases = HALSim::GetFlashEraseCount() - erasesBefore;
+
+    //a torn newest record falls back to the one before it
+    bool isFallbackOk = CorruptRecord(saved.GetSequence()) && loaded.Load() && loaded.GetSequence() == saved.GetSequence() - 1;
+
+    //the power going at any point of a save that moves to the other sector still leaves a record to load: once onto
+    //a blank sector, and once onto one still holding the records from before the last switch
+    const uint32_t slotsPerSector = HAL_FLASH_SECTOR_SIZE / CAL_RECORD_SIZE;
+    uint32_t cuts = 0;
+    uint32_t cutsLost = CutSectorSwitch(slotsPerSector, false, cuts) + CutSectorSwitch(2 * slotsPerSector, true, cuts);
+    HALSim::WipeFlash();
+
+    //--------Transform against the exact mapping, over every raw value--------
+    const CalibrationPoints pointSets[] = {{2300, 340}, {2305, 350}, {2300, 330}, {2100, 600}, {36, 3010}, {100, 2800}};
+    int32_t worst = 0;
+    for(const CalibrationPoints &points : pointSets)
+    {
+        Calibration calibration;
+        calibration.SetDefaults();
+        uint8_t channel = points.five > points.zero ? CAL_CV_SWING : CAL_CV_UD;
+        calibration.SetPoints(channel, points);
+        double fullScale = channel == CAL_CV_SWING ? CAL_SWING_FULL_SCALE : CAL_BIPOLAR_FULL_SCALE;
+        for(int raw = 0; raw < 4096; raw++)
+        {
+            double exact = (raw - double(points.zero)) * fullScale / (double(points.five) - double(points.zero));
+            int32_t difference = abs(calibration.Apply(channel, raw) - int32_t(lround(exact)));
+            if(difference > worst) worst = difference;
+        }
+    }
+
+    //--------Cost per conversion--------
+    Calibration calibration;
+    calibration.SetDefaults();
+    volatile int32_t sink = 0;
+    volatile uint16_t zero = 2300; //keeps the compiler from folding the divides into constants
+    volatile uint16_t five = 340;
+    Clock::time_point start = Clock::now();
+    for(int pass = 0; pass < BENCH_CAL_PASSES; pass++)
+        for(int raw = 0; raw < 4096; raw++) sink = sink + LegacyCalibratedValue(raw, zero, five);
+    double legacyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (BENCH_CAL_PASSES * 4096.0);
+    start = Clock::now();
+    for(int pass = 0; pass < BENCH_CAL_PASSES; pass++)
+        for(int raw = 0; raw < 4096; raw++) sink = sink + calibration.Apply(CAL_CV_UD, raw);
+    double transformNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (BENCH_CAL_PASSES * 4096.0);
+
+    printf("\n%-28s %12s %12s %12s %12s\n", "calibration", "saves", "erases", "mismatches", "fallback");
+    printf("%-28s %12i %12u %12u %12s\n", isFreshDefault ? "flash record" : "flash record (not blank!)", BENCH_CAL_SAVES, erases,
+        mismatches, BenchVerdict(isFallbackOk, "FAILED"));
+    if(!isFreshDefault || mismatches) benchFailures++;
+    printf("%-28s %12u %12s %12u %12s\n", "power cut mid switch", cuts, "", cutsLost, BenchVerdict(cutsLost == 0, "FAILED"));
+    printf("%-28s %12s %12s %12s\n", "", "legacy ns", "mul-shift ns", "worst LSB");
+    printf("%-28s %12.2f %12.2f %12i\n", "cv conversion", legacyNs, transformNs, worst);
+}
+
+//-------- LEDs: gamma-corrected PWM envelopes against the old software PWM --------
+
+/// Main loop pass length the LED benchmark runs at (update() plus its sleep_us(1000))
+#define BENCH_LED_FRAME_US 1700
+#define BENCH_LED_SECONDS 60
+
+/// @brief The original per-frame software PWM from WriteSlowOutputs, kept as a baseline
+/// @return whether the LED is lit this frame
+static bool LegacyLEDState(LEDState state, uint16_t cycle, bool isButton)
+{
+    switch(state)
+    {
+        case LEDState::SOLID_OFF:       return false;
+        case LEDState::SOLID_ON:        return true;
+        case LEDState::SOLID_HALF:      return cycle%32 > (isButton ? 26 : 28);
+        case LEDState::BLINK_SLOW:      return cycle%8192 > 4096;
+        case LEDState::BLINK_MED:       return cycle%4096 > 2048;
+        case LEDState::BLINK_FAST:      return cycle%2048 > 1024;
+        case LEDState::FADE_SLOWEST:    return cycle%64 > abs(cycle - 32'768)/512;
+        case LEDState::FADE_SLOW:       return cycle%64 > abs((cycle%32'768) - 16'384)/256;
+        case LEDState::FADE_MED:        return cycle%32 > abs((cycle%16'384) - 8'192)/256;
+        case LEDState::FADE_FAST:       return cycle%16 > abs((cycle%8'192) - 4'096)/256;
+        case LEDState::FADE_FASTER:     return cycle%16 > abs((cycle%2'048) - 1'024)/64;
+        case LEDState::FADE_FASTEST:    return cycle%16 > abs((cycle%1'024) - 512)/32;
+    }
+    return false;
+}
+
+static void RunLEDBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    //--------Gamma table sanity--------
+    bool isMonotonic = true;
+    for(int i = 0; i < LED_GAMMA_TABLE_SIZE; i++) isMonotonic = isMonotonic && ledGammaTable.duties[i] <= ledGammaTable.duties[i + 1];
+    bool isEndpointsOk = ledGammaTable.duties[0] == 0 && ledGammaTable.duties[LED_GAMMA_TABLE_SIZE] == 65535;
+    double halfDuty = LEDEnvelope::GammaCorrect(LED_HALF_LEVEL_BUTTON) / 65536.0;
+
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "led state", "legacy ns", "pwm ns", "writes/s", "legacy dark", "pwm dark");
+    const LEDState states[] = {LEDState::SOLID_HALF, LEDState::BLINK_MED, LEDState::FADE_MED, LEDState::FADE_FASTEST};
+    const char *names[] = {"solid half", "blink med", "fade med", "fade fastest"};
+    const uint32_t frames = BENCH_LED_SECONDS * 1'000'000 / BENCH_LED_FRAME_US;
+    for(int s = 0; s < 4; s++)
+    {
+        //--------Legacy: one pin write per frame; the longest dark run is what shows as flicker--------
+        volatile uint32_t sink = 0;
+        uint16_t cycle = 0;
+        uint32_t darkRun = 0;
+        uint32_t longestDark = 0;
+        Clock::time_point start = Clock::now();
+        for(uint32_t f = 0; f < frames; f++)
+        {
+            cycle += BENCH_LED_FRAME_US / 100;
+            bool isLit = LegacyLEDState(states[s], cycle, true);
+            sink = sink + isLit;
+            darkRun = isLit ? 0 : darkRun + 1;
+            if(darkRun > longestDark) longestDark = darkRun;
+        }
+        double legacyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / frames;
+
+        //--------PWM envelope: only writes on change, dark only while the envelope itself is at 0--------
+        LEDEnvelope envelope;
+        envelope.SetHalfLevel(LED_HALF_LEVEL_BUTTON);
+        uint32_t ticks = 0;
+        uint32_t writes = 0;
+        uint32_t darkFrames = 0;
+        uint32_t longestPwmDark = 0;
+        start = Clock::now();
+        for(uint32_t f = 0; f < frames; f++)
+        {
+            ticks += BENCH_LED_FRAME_US / LED_TICK_US;
+            uint16_t duty;
+            if(envelope.Update(states[s], ticks, &duty))
+            {
+                writes++;
+                sink = sink + duty;
+            }
+            darkFrames = envelope.GetLevel(states[s], ticks) == 0 ? darkFrames + 1 : 0;
+            if(darkFrames > longestPwmDark) longestPwmDark = darkFrames;
+        }
+        double pwmNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / frames;
+
+        char legacyDark[16];
+        char pwmDark[16];
+        snprintf(legacyDark, sizeof(legacyDark), "%.1fmS", longestDark * BENCH_LED_FRAME_US / 1000.0);
+        snprintf(pwmDark, sizeof(pwmDark), "%.1fmS", longestPwmDark * BENCH_LED_FRAME_US / 1000.0);
+        printf("%-28s %12.1f %12.1f %12.1f %12s %12s\n", names[s], legacyNs, pwmNs, double(writes) / BENCH_LED_SECONDS, legacyDark, pwmDark);
+    }
+    printf("%-28s %12s %12s %12.3f\n", "gamma table", isMonotonic ? "monotonic" : "NOT MONO", isEndpointsOk ? "0-65535" : "BAD ENDS", halfDuty);
+    if(!isMonotonic || !isEndpointsOk) benchFailures++;
+}
+
+//-------- Gate Sequencer: the PIO + DMA timeline, played back by a software model of GateSequencer.pio --------
+
+/// System clock the firmware runs at (set_sys_clock_khz in main.cpp)
+#define BENCH_CYCLES_PER_MICRO 280
+
+static void RunSequencerScenario(const char *name, float bpm)
+{
+    Chronos chronos;
+    IOHelper io;
+    HALSim::Reset();
+    io.Init();
+    chronos.Init(&io);
+    chronos.SetBPM(bpm);
+    chronos.isPlayMode = true;
+
+    const double microsPerTick = 60'000'000.0 / (double(bpm) * CHRONOS_TICKS_PER_QUARTER);
+    const uint32_t divisors[4] = {512 * CHRONOS_TICKS_PER_512TH, 256 * CHRONOS_TICKS_PER_512TH, 128 * CHRONOS_TICKS_PER_512TH, 64 * CHRONOS_TICKS_PER_512TH};
+    const uint64_t endMicros = 60'000'000;
+    const uint64_t blockCycles = uint64_t(GATE_SEQ_BLOCK_US) * BENCH_CYCLES_PER_MICRO;
+
+    GateTimeline timeline;
+    GateEdge edges[GATE_SEQ_MAX_EDGES];
+    uint32_t words[GATE_SEQ_BLOCK_WORDS];
+    timeline.Reset(0, 0);
+
+    //block k is refilled when block k-2 finishes, i.e. as block k-1 starts; blocks 0 and 1 are filled (idle) at start
+    uint64_t nextBlock = 2;
+    uint64_t playCycle = 0;
+    uint8_t playMask = 0;
+    uint64_t now = 0;
+    uint64_t last = 0;
+    uint64_t nextUpdate = 0;
+    uint64_t wakeups = 0;
+    uint64_t blockErrors = 0;
+    uint64_t numEdges = 0;
+    double sumError = 0;
+    double worstError = 0;
+    for(int i = 0; i < 2; i++)
+    {
+        uint32_t used;
+        timeline.FillBlock(words, GATE_SEQ_BLOCK_WORDS, edges, 0, timeline.GetEncodedCycle() + blockCycles, &used);
+    }
+    playCycle = 2 * blockCycles;
+    while(now < endMicros)
+    {
+        uint64_t fillMicros = (nextBlock - 1) * blockCycles / BENCH_CYCLES_PER_MICRO;
+        if(fillMicros < nextUpdate)
+        {
+            HALSim::AdvanceMicros(fillMicros - now);
+            now = fillMicros;
+
+            //DMA completion interrupt: predict and encode the next block from the state of the last fast update
+            uint64_t blockStart = timeline.GetEncodedCycle();
+            uint64_t blockEnd = blockStart + blockCycles;
+            uint32_t count = chronos.PredictEdges(edges, GATE_SEQ_MAX_EDGES, blockStart, blockEnd, 0, BENCH_CYCLES_PER_MICRO);
+            uint32_t used;
+            uint32_t numWords = timeline.FillBlock(words, GATE_SEQ_BLOCK_WORDS, edges, count, blockEnd, &used);
+
+            //play it: each word drives its mask, then holds for its delay + the program overhead
+            for(uint32_t w = 0; w < numWords; w++)
+            {
+                uint8_t mask = words[w] & 0x3F;
+                //the first two blocks are played before anything was predicted, so skip the edges at their end
+                for(int i = 0; i < 4 && playCycle > 2 * blockCycles; i++)
+                {
+                    if(((mask ^ playMask) >> i) & 1)
+                    {
+                        double period = microsPerTick * divisors[i] / 2;
+                        double micros = double(playCycle) / BENCH_CYCLES_PER_MICRO;
+                        double error = fabs(micros - round(micros / period) * period);
+                        sumError += error;
+                        if(error > worstError) worstError = error;
+                        numEdges++;
+                    }
+                }
+                playMask = mask;
+                playCycle += (words[w] >> 6) + GATE_TIMELINE_OVERHEAD;
+            }
+            if(playCycle != blockEnd) blockErrors++;
+            nextBlock++;
+            continue;
+        }
+
+        //fast updates keep running on the edge scheduler, they just no longer drive the pins
+        HALSim::AdvanceMicros(nextUpdate - now);
+        now = nextUpdate;
+        chronos.FastUpdate(uint32_t(now - last));
+        last = now;
+        wakeups++;
+        nextUpdate = now + chronos.GetMicrosUntilNextEdge();
+    }
+    //the state machine puts every edge on the system clock cycle it was encoded for, and every block must play for
+    //exactly its length or the ones after it slide
+    printf("%-28s %12.0f %12llu %12.3f %12.3f %12s  (%llu bad blocks)\n", name, wakeups / 60.0, (unsigned long long)numEdges,
+        sumError / numEdges, worstError, BenchVerdict(blockErrors == 0 && worstError <= 1.0 / BENCH_CYCLES_PER_MICRO),
+        (unsigned long long)blockErrors);
+}
+
+static void RunSchedulerBenchmark()
+{
+    printf("\n%-28s %12s %12s %12s %12s %12s\n", "edge placement", "wakeups/s", "edges", "mean err uS", "worst uS", "result");
+    RunSchedulerScenario("40uS tick, 165bpm", SCHEDULER_TICK, 165);
+    RunSchedulerScenario("scheduled, 165bpm", SCHEDULER_EDGE, 165);
+    RunSchedulerScenario("from return, 165bpm", SCHEDULER_EDGE_FROM_RETURN, 165);
+    RunSchedulerScenario("40uS tick, 97.3bpm", SCHEDULER_TICK, 97.3f);
+    RunSchedulerScenario("scheduled, 97.3bpm", SCHEDULER_EDGE, 97.3f);
+    RunSchedulerScenario("from return, 97.3bpm", SCHEDULER_EDGE_FROM_RETURN, 97.3f);
+    RunSequencerScenario("PIO timeline, 165bpm", 165);
+    RunSequencerScenario("PIO timeline, 97.3bpm", 97.3f);
+}
+
+int main()
+{
+    const BenchScenario scenarios[] =
+    {
+        {"play 120bpm",             2457, 0,    0,      60},
+        {"play 120bpm, swing",      2457, 4095, 0,      60},
+        {"follow 120bpm @24ppqn",   2457, 0,    20'833, 60},
+        {"follow 200bpm @24ppqn",   2457, 4095, 12'500, 60},
+    };
+
+    static BenchResult r; //histogram is too big for the stack
+
+    printf("%-28s %12s %12s %12s %12s\n", "scenario", "ticks", "ns/tick", "p99.9 ns", "worst ns");
+    for(const BenchScenario &scenario : scenarios)
+    {
+        r = BenchResult();
+        RunScenario(scenario, r);
+        printf("%-28s %12llu %12.1f %12.1f %12.1f\n", scenario.name, (unsigned long long)r.ticks,
+            r.totalNs / r.ticks, r.Percentile(0.999), r.worstNs);
+    }
+
+    RunEstimatorBenchmark();
+    RunPLLBenchmark();
+    RunDriftBenchmark();
+    RunSchedulerBenchmark();
+    RunGateMaskBenchmark();
+    RunGateOutputBenchmark();
+    RunPatternBenchmark();
+    RunModifierBenchmark();
+    RunTupletBenchmark();
+    RunMidiClockBenchmark();
+    RunMidiFollowBenchmark();
+    RunFollowBenchmark();
+    RunGlideBenchmark();
+    RunResetBenchmark();
+    RunConfigurationBenchmark();
+    RunSwingBenchmark();
+    RunMailboxStress();
+    RunTraceBenchmark();
+    RunAdcScanBenchmark();
+    RunCVFilterBenchmark();
+    RunCalibrationBenchmark();
+    RunLEDBenchmark();
+
+    if(benchFailures) printf("\n%u checks FAILED\n", benchFailures);
+    return benchFailures ? 1 : 0;
+}
@@ -6,120 +6,250 @@
 
 #include "Chronos.hpp"
 
+/// @brief Gate outs at power on: cycles of 512, 256, 128 and 64 512th notes, then the user division and half of it,
+/// @brief all with 50% gates. The fast path has a build of the outputs' Advance for it.
+static constexpr GateOutputDefinition defaultLayout[NUM_GATE_OUTS] =
+{
+    {512 * CHRONOS_TICKS_PER_512TH, GATE_LENGTH_FULL / 2, false},
+    {256 * CHRONOS_TICKS_PER_512TH, GATE_LENGTH_FULL / 2, false},
+    {128 * CHRONOS_TICKS_PER_512TH, GATE_LENGTH_FULL / 2, false},
+    {64 * CHRONOS_TICKS_PER_512TH,  GATE_LENGTH_FULL / 2, false},
+    {8 * CHRONOS_TICKS_PER_512TH,   GATE_LENGTH_FULL / 2, true},
+    {16 * CHRONOS_TICKS_PER_512TH,  GATE_LENGTH_FULL / 2, true},
+};
 
 void Chronos::Init(IOHelper *ioh)
 {
 	io = ioh;
-    
-    for(int i = 0; i < CLOCKIN_BUFFER_SIZE; i++)
+    tempoEstimator.Clear();
+    swingWarp.SetSwingsPerBar(CHRONOS_SWINGS_PER_BAR, CHRONOS_TICKS_PER_WHOLE);
+    midiClock.SetTicksPerQuarter(CHRONOS_TICKS_PER_QUARTER);
+
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
     {
-        clockInDiffBuffer[i] = 0;
+        GateOutputConfig config;
+        config.divisor = defaultLayout[i].divisor;
+        config.gateLength = defaultLayout[i].gateLength;
+        config.isUserDivision = defaultLayout[i].isUserDivision;
+        SetOutputConfig(i, config);
     }
 }
 
-bool Chronos::CalcGate(uint32_t thisBeatTime, uint16_t divisor, uint16_t gateLen)
+void Chronos::AdvanceBeatTime(uint32_t ticks)
 {
-    //TODO: change gate generation method to something with better hysterisis prevention
-    return (thisBeatTime%divisor)*1024 < divisor*gateLen;
+    beatTime += ticks;
+    barTicks += ticks;
+    while(barTicks >= CHRONOS_TICKS_PER_WHOLE) barTicks -= CHRONOS_TICKS_PER_WHOLE; //at most once, short of a stall
 }
 
-void Chronos::AddBeatToBPMEstimate()
+void Chronos::ResetBeatTime()
 {
-    //add the length of this pulse to the pulse length buffer
-    uint64_t currentTimeUS = time_us_64();
-    clockInDiffBuffer[clockInDiffBufferIterator] = currentTimeUS - lastClockTime;
-    lastClockTime = currentTimeUS;
-    
-    //increase clockInDiffBufferIterator by one
-    clockInDiffBufferIterator++;
-    if(clockInDiffBufferIterator >= CLOCKIN_BUFFER_SIZE) clockInDiffBufferIterator = 0;
+    beatTime = 0;
+    barTicks = 0;
+}
+
+void Chronos::SetBeatTime(int64_t position)
+{
+    //only on a jump, so the 64 bit division is fine here
+    beatTime = position;
+    barTicks = uint32_t(position % CHRONOS_TICKS_PER_WHOLE);
+}
 
-    //average clockInDiffBuffer time differences and convert to seconds
-    int elementsAveraged = 0;
-    float average = 0;
-    for(int i = 0; i < CLOCKIN_BUFFER_SIZE; i++)
+void Chronos::AddBeatToBPMEstimate(uint64_t edgeMicros)
+{
+    //add the length of this pulse to the running estimate; conversion to BPM happens in SlowUpdate, away from the ISR
+    uint64_t interval = edgeMicros - lastClockTime;
+    lastClockTime = edgeMicros;
+    tempoEstimator.AddInterval(interval > UINT32_MAX ? UINT32_MAX : uint32_t(interval));
+}
+void Chronos::AddBeatToBPMEstimateLastOnly(uint64_t edgeMicros)
+{
+    //clock is (re)starting; intervals from a previous session would only skew the new estimate
+    tempoEstimator.Clear();
+    lastClockTime = edgeMicros;
+}
+
+void Chronos::StartFollowing(uint64_t edgeMicros, ClockSource source)
+{
+    trace(TRACE_FOLLOW_START, int32_t(source));
+    followSource = source;
+    uint32_t ppqn = source == CLOCK_SOURCE_MIDI ? MIDI_CLOCK_PPQN : uint32_t(control.clockPPQN);
+    pll.SetTicksPerPulse((uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) / ppqn);
+    AddBeatToBPMEstimateLastOnly(edgeMicros);
+    pulsesUntilEstimate = source == CLOCK_SOURCE_MIDI ? MIDI_CLOCKS_PER_SONG_POSITION : 1;
+    followPPQN = ppqn;
+    SelectFastPath();
+    //start the NCO at the free-running tempo (ticks per uS, Q32); the second pulse measures the real one
+    pll.Start(uint32_t(timeBase.GetIncrement() >> (PHASE_FRACTION_BITS - 32)));
+    pll.OnPulse(edgeMicros, HAL::TimeMicros());
+    lastPllTicks = pll.GetTicks();
+    isFollowMode = true;
+    isPlayMode = true;
+    externalClockKeepaliveCountdown = control.clockKeepaliveMicros;
+}
+
+template <uint32_t PPQN>
+void Chronos::OnFollowPulseFor(uint64_t edgeMicros, uint64_t nowMicros)
+{
+    //USB frames move MIDI clocks by up to a mS, more than the estimator's outlier tolerance on one 24 PPQN interval,
+    //so those are measured a 16th note at a time instead
+    if(--pulsesUntilEstimate == 0)
+    {
+        AddBeatToBPMEstimate(edgeMicros);
+        pulsesUntilEstimate = followSource == CLOCK_SOURCE_MIDI ? MIDI_CLOCKS_PER_SONG_POSITION : 1;
+    }
+    //the same spacing StartFollowing gave the PLL, as a constant
+    pll.OnPulse<PPQN ? (uint64_t(CHRONOS_TICKS_PER_QUARTER) << 32) / (PPQN ? PPQN : 1) : 0>(edgeMicros, nowMicros);
+    externalClockKeepaliveCountdown = control.clockKeepaliveMicros;
+}
+
+//the builds SelectFastPath picks from
+template void Chronos::OnFollowPulseFor<0>(uint64_t edgeMicros, uint64_t nowMicros);
+template void Chronos::OnFollowPulseFor<PPQN_1>(uint64_t edgeMicros, uint64_t nowMicros);
+template void Chronos::OnFollowPulseFor<PPQN_4>(uint64_t edgeMicros, uint64_t nowMicros);
+template void Chronos::OnFollowPulseFor<PPQN_24>(uint64_t edgeMicros, uint64_t nowMicros);
+template void Chronos::OnFollowPulseFor<PPQN_48>(uint64_t edgeMicros, uint64_t nowMicros);
+
+void Chronos::SelectFastPath()
+{
+    //a PPQN or table without a build of its own runs the generic code, which plays exactly the same
+    switch(control.isSpecialised ? followPPQN : 0)
     {
-        if(clockInDiffBuffer[i] == 0) continue;
-        average += clockInDiffBuffer[i]/1'000'000.0f; //seconds
-        elementsAveraged++;
+        case PPQN_1:    onFollowPulse = &Chronos::OnFollowPulseFor<PPQN_1>; break;
+        case PPQN_4:    onFollowPulse = &Chronos::OnFollowPulseFor<PPQN_4>; break;
+        case PPQN_24:   onFollowPulse = &Chronos::OnFollowPulseFor<PPQN_24>; break;
+        case PPQN_48:   onFollowPulse = &Chronos::OnFollowPulseFor<PPQN_48>; break;
+        default:        onFollowPulse = &Chronos::OnFollowPulseFor<0>; break;
     }
-    average /= (double)elementsAveraged;
-	debug("Average:\t%f\n", average);
-    //Convert to BPM;
-    estimatedBPM = (1.0f/average) * (60.0f/float(clockPPQN))*0.9999f; //better to be slightly under than over to help prevent double-triggering or weirdness
-    debug("Estimated BPM:\t%f\n", estimatedBPM);
+    bool isDefaultLayout = control.isSpecialised && outputs.IsLayout(defaultLayout);
+    advanceOutputs = isDefaultLayout ? &GateOutputBank<NUM_GATE_OUTS>::AdvanceLayout<defaultLayout> : &GateOutputBank<NUM_GATE_OUTS>::Advance;
 }
-void Chronos::AddBeatToBPMEstimateLastOnly()
+
+void Chronos::ProcessMidiIn(uint64_t nowMicros)
 {
-    //add the length of this pulse to the pulse length buffer
-    uint64_t currentTimeUS = time_us_64();
-    lastClockTime = currentTimeUS;
+    const uint32_t ticksPerClock = CHRONOS_TICKS_PER_QUARTER / MIDI_CLOCK_PPQN;
+    bool isFollowingMidi = isFollowMode && followSource == CLOCK_SOURCE_MIDI;
+    MidiEvent event;
+    while(io->PopMidiEvent(&event))
+    {
+        switch(event.bytes[0])
+        {
+            case MIDI_TIMING_CLOCK:
+                if(!isFollowMode) StartFollowing(event.timeMicros, CLOCK_SOURCE_MIDI);
+                else if(isFollowingMidi) OnFollowPulse(event.timeMicros, nowMicros);
+                else break; //CLOCK IN got there first
+                isFollowingMidi = true;
+                if(isMidiResumePending)
+                {
+                    //Start or Continue: this clock is the song position, wherever the NCO is between pulses
+                    int32_t sincePulse = max(pll.GetTicksSincePulse(), int32_t(0));
+                    int64_t position = midiNextClockPosition << control.tmultShift;
+                    SetBeatTime(position + (int64_t(sincePulse) << control.tmultShift));
+                    //MIDI clock out starts from the same clock, stamped with when it was received rather than with this update
+                    midiClock.Update(position, true, event.timeMicros, midiEvents);
+                    lastPllTicks = pll.GetTicks();
+                    isMidiResumePending = false;
+                    isMidiStopped = false;
+                }
+                isPlayMode = !isMidiStopped;
+                if(isPlayMode) midiNextClockPosition += ticksPerClock;
+                break;
+            case MIDI_START:
+                midiNextClockPosition = 0;
+                isMidiResumePending = true;
+                if(isFollowingMidi) isPlayMode = false; //hold until the clock that starts it
+                break;
+            case MIDI_CONTINUE:
+                isMidiResumePending = true;
+                if(isFollowingMidi) isPlayMode = false;
+                break;
+            case MIDI_STOP:
+                isMidiStopped = true;
+                isMidiResumePending = false;
+                if(isFollowingMidi) isPlayMode = false;
+                break;
+            case MIDI_SONG_POSITION:
+                midiNextClockPosition = int64_t(event.bytes[1] | (event.bytes[2] << 7)) * MIDI_CLOCKS_PER_SONG_POSITION * ticksPerClock;
+                break;
+        }
+        //transport only; 24 a beat would flood the log
+        if(event.bytes[0] != MIDI_TIMING_CLOCK) trace(TRACE_MIDI_IN, event.bytes[0], int32_t(midiNextClockPosition));
+    }
 }
 
 void Chronos::CalculateSwing()
 {
-    uint16_t swing = io->IN_SWING_KNOB;
-    if(io->CV_swing > 300) //using swing cv
+    uint16_t swing = control.swingKnob;
+    if(control.swingCV > 300) //using swing cv
     {
-        swing += uint16_t(io->CV_swing); //later clamped to 4096
+        swing += uint16_t(control.swingCV); //later clamped to 4096
         if(swing > 4096)
         {
             swing = 4096;
         }
     }
-    debug("%i\n", io->CV_UD);
-    if(swing > 300) //don't burden the processor with this while swing isn't even on
+    isSwingActive = swing > 300;
+    if(isSwingActive) //don't burden the processor with this while swing isn't even on
     {
-        uint32_t barTime = (beatTimeFinal%512)*128; //bar time from 0-65535
-        //this swing formula was calculated experimentally using the following formula on desmos. N = swings per bar, X and Y range from 0-65535
-        //y=x\ +\ \cos\left(\frac{x}{\left(\frac{65535}{2\pi\ \cdot\ n}\right)}\right)\cdot\left(\frac{9300}{n}\right)-\left(\frac{9300}{n}\right)
-        uint32_t swingTime = beatTimeFinal + (cos(barTime / (65535/(2*3.141592*swingsPerBar)))*(9300/swingsPerBar) - (9300/swingsPerBar))/128;
-        beatTimeFinal = lerp((double)beatTimeFinal, (double)swingTime, (double)swing/4096.0);
+        //table lookup and integer blend; see SwingWarp for the curve
+        beatTimeFinal -= swingWarp.GetDelay(barTicks, swing);
     }
 
-    beatTimeFinal += io->CV_scrub;
+    beatTimeFinal += int32_t(control.scrubCV) * CHRONOS_TICKS_PER_512TH;
 }
 
 void Chronos::FastUpdate(uint32_t deltaMicros)
 {
+    uint64_t edgeMicros;
+    lastUpdateMicros = HAL::TimeMicros();
+    uint32_t previousBarTicks = barTicks;
+
+    //Pick up the slow path's latest settings; if it's mid-write, carry on with the previous ones rather than wait
+    controlMailbox.TryRead(&control);
+    uint32_t tableVersion = outputTableMailbox.GetVersion();
+    GateOutputTable table;
+    if(tableVersion != outputTableVersion && outputTableMailbox.TryRead(&table))
+    {
+        for(int i = 0; i < NUM_GATE_OUTS; i++) outputs.SetConfig(i, table.outputs[i]);
+        outputs.SetSeed(table.randomSeed);
+        outputTableVersion = tableVersion;
+        SelectFastPath();
+    }
+    if((control.playToggles - playTogglesSeen) & 1)
+    {
+        isPlayMode = !isPlayMode;
+    }
+    playTogglesSeen = control.playToggles;
+
+    //Advance the NCO first, so pulses are compared against the phase at their own timestamps
+    if(isFollowMode) pll.Advance(deltaMicros);
+    //USB MIDI clock and transport; a clock can start follow mode here, ahead of CLOCK IN
+    ProcessMidiIn(lastUpdateMicros);
+
     if(isFollowMode)
     {
-        //Check for clock pulse
-        if(io->ProcessClockFlag())
+        //Check for clock pulses (more than one can be waiting if this update ran late)
+        while(io->PopClockEdge(&edgeMicros))
         {
-            //Update running BPM estimate and reset ext clock keepalive
-            AddBeatToBPMEstimate();
-            externalClockKeepaliveCountdown = max(microsPerTimeGradation * CLOCKIN_WAIT_MULT, CLOCKIN_MIN_WAIT);
-            clockPulseCounter++;
+            if(followSource != CLOCK_SOURCE_JACK) continue; //following USB MIDI; the jack waits until it stops
+            //Update running BPM estimate and PLL, and reset ext clock keepalive
+            OnFollowPulse(edgeMicros, lastUpdateMicros);
             isPlayMode = true;
         }
 
-        //Check for reset pulse (after clock, so a full stop doesn't start at an advanced time)
-        if(io->ProcessResetFlag())
+        //Advance time by the NCO's progress; the PLL only ever bends its speed, so this never jumps
+        uint32_t pllTicks = pll.GetTicks();
+        if(isPlayMode) AdvanceBeatTime((pllTicks - lastPllTicks) << control.tmultShift); //x1, x2, x4
+        lastPllTicks = pllTicks;
+
+        //Reset on its boundary (after clock, so the NCO has been pulled to the pulses it came with)
+        if(ProcessReset(deltaMicros))
         {
-            clockPulseCounter = 0;
-            last_beatTime = 0;
-            beatTime = 0;
+            pll.Rebase();
+            lastPllTicks = pll.GetTicks();
         }
-
         if(isPlayMode)
         {
-            //Advance time
-            timeInThisGradation += deltaMicros;
-            if(timeInThisGradation >= microsPerTimeGradation)
-            {
-                timeInThisGradation -= microsPerTimeGradation;
-                if      (io->IN_TMULT_SWITCH == 0) beatTime += 1;
-                else if (io->IN_TMULT_SWITCH == 1) beatTime += 2;
-                else if (io->IN_TMULT_SWITCH == 2) beatTime += 4;
-            }
-
-            //Full quarter note elapsed. snap time to quarter
-            if(clockPulseCounter >= uint16_t(clockPPQN))
-            {
-                clockPulseCounter -= uint16_t(clockPPQN);
-                beatTime = floor(round(beatTime/512.0)*512);
-            }
             beatTimeFinal = beatTime; //TODO: ADD OFFSET CV HERE
             CalculateSwing();
         }
@@ -129,108 +259,295 @@ void Chronos::FastUpdate(uint32_t deltaMicros)
         externalClockKeepaliveCountdown -= deltaMicros;
         if(externalClockKeepaliveCountdown < 0)
         {
+            trace(TRACE_FOLLOW_LOST, control.clockKeepaliveMicros);
             isFollowMode = false;
             isPlayMode = false; //don't keep running if master clock stops!
         }
     }
     else if(isPlayMode)
     {
-        if(io->ProcessClockFlag())
+        if(io->PopClockEdge(&edgeMicros))
         {
-            AddBeatToBPMEstimateLastOnly();
-            isFollowMode = true;
-            isPlayMode = true;
-            externalClockKeepaliveCountdown = max(microsPerTimeGradation * CLOCKIN_WAIT_MULT, CLOCKIN_MIN_WAIT);
+            StartFollowing(edgeMicros, CLOCK_SOURCE_JACK);
         }
 
-        //stop if set to 0BPM, or else it's actually 0.00767988281 BPM, which might spook someone in 2.17 hours!!
-        if(microsPerTimeGradation != UINT16_MAX)
+        //Advance time (0BPM is an increment of 0, so it really stops)
+        AdvanceBeatTime(timeBase.Advance(deltaMicros) << control.tmultShift); //x1, x2, x4
+        //the gates of this update come from the reset position, so patterns start again on step 0 right away
+        ProcessReset(deltaMicros);
+        beatTimeFinal = beatTime; //TODO: ADD OFFSET CV HERE
+        CalculateSwing();
+    }
+    else
+    {
+        if(io->PopClockEdge(&edgeMicros))
         {
-            //Advance time
-            timeInThisGradation += deltaMicros;
-            if(timeInThisGradation >= microsPerTimeGradation)
-            {
-                timeInThisGradation -= microsPerTimeGradation;
-                if      (io->IN_TMULT_SWITCH == 0) beatTime += 1;
-                else if (io->IN_TMULT_SWITCH == 1) beatTime += 2;
-                else if (io->IN_TMULT_SWITCH == 2) beatTime += 4;
-            }
-            beatTimeFinal = beatTime; //TODO: ADD OFFSET CV HERE
-            CalculateSwing();
+            StartFollowing(edgeMicros, CLOCK_SOURCE_JACK);
         }
+        ResetBeatTime();
+        ProcessReset(deltaMicros); //already at the start, so this just clears it
+    }
+    
+    //Tempo for the time until the next update; the time base ran at the old one up to here, so nothing jumps
+    UpdateTempo(deltaMicros, previousBarTicks);
+
+    //Step every gate out's phase counter along to the new position
+    outputs.SetUDShift(clamp((7-control.udIndex) - control.udMult, 1, 7));
+    gateMask = (outputs.*advanceOutputs)(beatTimeFinal);
+    io->OUT_GATE_PINS = uint32_t(gateMask) << GATE_OUT_PIN_BASE;
+
+    //MIDI clock follows the unswung time, so followers get an even clock and do their own swing
+    midiClock.Update(beatTime, isPlayMode, lastUpdateMicros, midiEvents);
+
+    //Let the slow path know where we are
+    ChronosStatus newStatus;
+    newStatus.beatTime = beatTime;
+    newStatus.period16 = tempoEstimator.GetPeriodMicros16();
+    newStatus.isPlayMode = isPlayMode;
+    newStatus.isFollowMode = isFollowMode;
+    newStatus.isResetPending = isResetPending;
+    newStatus.periodsPerQuarter = followSource == CLOCK_SOURCE_MIDI ? MIDI_CLOCK_PPQN / MIDI_CLOCKS_PER_SONG_POSITION : control.clockPPQN;
+    statusMailbox.Write(newStatus);
+}
+
+bool Chronos::ProcessReset(uint32_t deltaMicros)
+{
+    uint64_t edgeMicros;
+    while(io->PopResetEdge(&edgeMicros))
+    {
+        if(isResetPending) continue;
+        isResetPending = true;
+        resetEdgeMicros = edgeMicros;
+        if(!isPlayMode) continue;
 
-        //reset on the beat
-        if((CalcGate(64, gateLen) && !CalcGate(last_beatTime, 64, gateLen)) && io->ProcessResetFlag())
+        //where beatTime was at the pulse: back from now by the time since at the current speed, less how far the
+        //time base already is into its next tick, to the nearest tick (this update's time at most, so a stall can't
+        //overflow it)
+        uint64_t ticksPerMicroQ48 = isFollowMode ? uint64_t(pll.GetFrequency()) << (PHASE_FRACTION_BITS - 32) : timeBase.GetIncrement();
+        uint64_t fractionQ48 = isFollowMode ? uint64_t(pll.GetTickFraction()) << (PHASE_FRACTION_BITS - 32) : timeBase.GetTickFraction();
+        uint32_t sinceMicros = edgeMicros < lastUpdateMicros ? uint32_t(min(lastUpdateMicros - edgeMicros, uint64_t(deltaMicros))) : 0;
+        sinceMicros = min(sinceMicros, uint32_t(0xFFFF));
+        int64_t sinceQ48 = int64_t(ticksPerMicroQ48 * sinceMicros) - int64_t(fractionQ48) + (1LL << (PHASE_FRACTION_BITS - 1));
+        uint32_t sinceTicks = sinceQ48 > 0 ? uint32_t(sinceQ48 >> PHASE_FRACTION_BITS) << control.tmultShift : 0;
+        uint32_t graceTicks = uint32_t((ticksPerMicroQ48 * CHRONOS_RESET_GRACE_US) >> PHASE_FRACTION_BITS) << control.tmultShift;
+        int64_t edgePosition = beatTime - sinceTicks;
+
+        //every quantum divides the bar, so the position in the bar is enough to find the next boundary
+        const uint32_t quanta[] = {0, CHRONOS_TICKS_PER_QUARTER / 4, CHRONOS_TICKS_PER_QUARTER / 2, CHRONOS_TICKS_PER_QUARTER,
+            CHRONOS_TICKS_PER_WHOLE};
+        ResetQuantize quantize = control.resetQuantize;
+        if(quantize == RESET_QUANTIZE_DEFAULT) quantize = isFollowMode ? RESET_QUANTIZE_IMMEDIATE : RESET_QUANTIZE_8TH;
+        uint32_t quantum = quanta[quantize];
+        if(quantum == 0)
         {
-            beatTime = 0;
+            resetPosition = edgePosition;
+            continue;
         }
-
+        int32_t edgeBarTicks = int32_t(barTicks) - int32_t(sinceTicks);
+        while(edgeBarTicks < 0) edgeBarTicks += CHRONOS_TICKS_PER_WHOLE;
+        uint32_t sinceBoundary = uint32_t(edgeBarTicks) % quantum;
+        //a pulse just after a boundary was meant for it (it came with that boundary's clock)
+        if(sinceBoundary <= graceTicks) resetPosition = edgePosition - sinceBoundary;
+        else                            resetPosition = edgePosition + (quantum - sinceBoundary);
     }
-    else
+    //nothing is moving while stopped, so every boundary is now (also for a reset that was waiting when it stopped)
+    if(!isPlayMode) resetPosition = beatTime;
+    if(!isResetPending || beatTime < resetPosition) return false;
+
+    //land on the boundary exactly: whatever this update moved past it, the new bar has moved on by
+    uint32_t overshoot = uint32_t(beatTime - resetPosition);
+    trace(TRACE_RESET, int32_t((barTicks + CHRONOS_TICKS_PER_WHOLE - overshoot % CHRONOS_TICKS_PER_WHOLE) % CHRONOS_TICKS_PER_WHOLE),
+        int32_t(lastUpdateMicros - resetEdgeMicros));
+    ResetBeatTime();
+    AdvanceBeatTime(overshoot);
+    isResetPending = false;
+    return true;
+}
+
+void Chronos::UpdateTempo(uint32_t deltaMicros, uint32_t previousBarTicks)
+{
+    tempoGlide.SetGlide(control.tempoGlideFactor, control.tempoMaxStep);
+    tempoGlide.Advance(deltaMicros);
+
+    uint64_t target = control.timeBaseIncrement;
+    if(target != tempoGlide.GetTarget())
     {
-        if(io->ProcessClockFlag())
+        //a quantised change waits for barTicks to cross into the next beat or bar; it only ever goes back on a new
+        //bar, or a reset to the downbeat
+        bool isOnQuantum = true;
+        if(control.tempoQuantize != TEMPO_QUANTIZE_OFF)
         {
-            AddBeatToBPMEstimateLastOnly();
-            isFollowMode = true;
-            isPlayMode = true;
-            externalClockKeepaliveCountdown = max(microsPerTimeGradation * CLOCKIN_WAIT_MULT, CLOCKIN_MIN_WAIT);
+            isOnQuantum = barTicks < previousBarTicks;
+            if(control.tempoQuantize == TEMPO_QUANTIZE_BEAT)
+            {
+                isOnQuantum |= barTicks / CHRONOS_TICKS_PER_QUARTER != previousBarTicks / CHRONOS_TICKS_PER_QUARTER;
+            }
         }
-        beatTime = 0;
+
+        //nothing to glide from while stopped, or at 0BPM
+        if(!isPlayMode || tempoGlide.GetIncrement() == 0) tempoGlide.Jump(target);
+        else if(isOnQuantum) tempoGlide.SetTarget(target);
     }
-    
-    //TEMPORARY IMPLEMENTATION FOR TESTING, PROBABLY VERY BAD
-    io->OUT_GATES[0] = CalcGate(512, gateLen); //512 512th notes
-    io->OUT_GATES[1] = CalcGate(256, gateLen);
-    io->OUT_GATES[2] = CalcGate(128, gateLen);
-    io->OUT_GATES[3] = CalcGate(64 , gateLen);
+    timeBase.SetIncrement(tempoGlide.GetIncrement());
+}
+
+uint32_t Chronos::GetMicrosUntilNextEdge()
+{
+    if(!isPlayMode) return CHRONOS_MAX_SLEEP_US;
+    if(isSwingActive) return CHRONOS_TICK_US;
+
+    //ticks until the first gate out changes state, MIDI clock is due or a pending reset's boundary comes up
+    uint32_t ticks = min(outputs.TicksUntilNextEdge(), midiClock.TicksUntilNextClock(beatTime));
+    if(isResetPending) ticks = uint32_t(min(int64_t(ticks), resetPosition - beatTime)); //past it, it'd have been taken
+    if(ticks == UINT32_MAX) return CHRONOS_MAX_SLEEP_US;
+
+    //beatTime moves in steps of 1, 2 or 4 time base ticks depending on TMULT; convert to time base ticks, rounding up
+    uint32_t shift = control.tmultShift;
+    uint32_t baseTicks = (ticks + (1u << shift) - 1) >> shift;
+    uint32_t micros = isFollowMode ? pll.GetMicrosUntilTicks(baseTicks) : timeBase.GetMicrosUntilTicks(baseTicks);
+    return clamp(micros, uint32_t(CHRONOS_MIN_SLEEP_US), uint32_t(CHRONOS_MAX_SLEEP_US));
+}
+
+uint32_t Chronos::PredictEdges(GateEdge *edges, uint32_t maxEdges, uint64_t fromCycle, uint64_t toCycle, uint64_t epochMicros, uint32_t cyclesPerMicro)
+{
+    if(maxEdges == 0) return 0;
+
+    //the gate state as of the last update
+    edges[0] = { fromCycle, gateMask };
+    if(!isPlayMode || isSwingActive) return 1;
+
+    //walk the edges forward from the last update: beatTime moves in steps of 1, 2 or 4 time base ticks (TMULT),
+    //so each edge lands on a known time base tick boundary
+    uint64_t updateCycle = (lastUpdateMicros - epochMicros) * cyclesPerMicro;
+    uint32_t shift = control.tmultShift;
+    //step a copy of the phase counters along, so looking ahead costs no modulo either
+    GateOutputBank<NUM_GATE_OUTS> lookahead = outputs;
+    int64_t position = beatTimeFinal;
+    //the update on a pending reset's boundary takes over from there
+    int64_t resetAt = isResetPending ? beatTimeFinal + (resetPosition - beatTime) : INT64_MAX;
+    uint32_t baseTicks = 0;
+    uint32_t count = 1;
+    while(count < maxEdges)
+    {
+        uint32_t ticks = lookahead.TicksUntilNextEdge();
+        if(ticks == UINT32_MAX) break;
+        uint32_t stepTicks = (ticks + (1u << shift) - 1) >> shift;
+        baseTicks += stepTicks;
+        position += stepTicks << shift;
+        if(baseTicks > 0xFFFF) break; //far beyond any window
+        if(position >= resetAt) break;
+        uint64_t untilCycles = isFollowMode ? pll.GetCyclesUntilTicks(baseTicks, cyclesPerMicro) : timeBase.GetCyclesUntilTicks(baseTicks, cyclesPerMicro);
+        if(untilCycles == UINT64_MAX) break;
+        uint64_t cycle = updateCycle + untilCycles;
+        if(cycle >= toCycle) break;
 
-    io->OUT_GATES[4] = CalcGate(8 <<clamp((7-io->IN_UD_INDEX) - io->CV_UD_Mult, 1, 7), gateLen);
-    io->OUT_GATES[5] = CalcGate(16<<clamp((7-io->IN_UD_INDEX) - io->CV_UD_Mult, 1, 7), gateLen);
-    last_beatTime = beatTime;
+        //edges already behind the window only change the state it starts with
+        uint8_t mask = lookahead.Advance(position);
+        if(cycle <= fromCycle) edges[0].mask = mask;
+        else edges[count++] = { cycle, mask };
+    }
+    return count;
 }
 
-//We sacrifice a little bit of accuracy here in exchange for faster calculation and better precision.
+//The increment keeps 48 fractional bits, so the tempo is exact to well under 1ppm; the double math stays in this slow path.
 void Chronos::SetBPM(float exactBPM)
 {
     if(exactBPM == currentExactBPM) return;
     currentExactBPM = exactBPM;
-    debug("CALCULATING VALUES FOR BPM: %f\n", exactBPM);
-    if(exactBPM == 0)
+    pendingControl.timeBaseIncrement = PhaseAccumulator::IncrementForBPM(exactBPM, CHRONOS_TICKS_PER_QUARTER);
+
+    UpdateClockKeepalive();
+    trace(TRACE_SET_BPM, int32_t(exactBPM), int32_t(exactBPM * 1000.0f) % 1000, pendingControl.clockKeepaliveMicros);
+    controlMailbox.Write(pendingControl);
+}
+
+void Chronos::SetTempoGlide(uint32_t glideMicros, float maxBPMPerSecond, TempoQuantize quantize)
+{
+    pendingControl.tempoGlideFactor = TempoGlide::FactorForGlide(glideMicros);
+    pendingControl.tempoMaxStep = TempoGlide::MaxStepForRate(maxBPMPerSecond, CHRONOS_TICKS_PER_QUARTER);
+    pendingControl.tempoQuantize = quantize;
+    controlMailbox.Write(pendingControl);
+}
+
+void Chronos::SetResetQuantize(ResetQuantize quantize)
+{
+    pendingControl.resetQuantize = quantize;
+    controlMailbox.Write(pendingControl);
+}
+
+bool Chronos::IsResetPending()
+{
+    ChronosStatus latest;
+    statusMailbox.Read(&latest);
+    return latest.isResetPending || io->IsResetPending();
+}
+
+void Chronos::UpdateClockKeepalive()
+{
+    //give up on an external clock after CLOCKIN_WAIT_MULT 512th notes, or CLOCKIN_WAIT_PULSES pulses, without a pulse
+    if(currentExactBPM > 0)
     {
-        microsPerTimeGradation = UINT16_MAX; //0BPM
-        return;
+        float microsPerQuarter = 60'000'000.0f / currentExactBPM;
+        float microsPer512th = microsPerQuarter * CHRONOS_TICKS_PER_512TH / CHRONOS_TICKS_PER_QUARTER;
+        float wait = max(microsPer512th * CLOCKIN_WAIT_MULT, microsPerQuarter * CLOCKIN_WAIT_PULSES / pendingControl.clockPPQN);
+        pendingControl.clockKeepaliveMicros = max(int32_t(min(wait, float(INT32_MAX))), CLOCKIN_MIN_WAIT);
     }
-    float b = exactBPM/60.0f;
-    debug("\tBPS: %f\n", b);
-    b = 1/b;
-    debug("\tSPB: %f\n", b);
-    b *= 1'000'000.0f;
-    debug("\tmicros Per beat: %f\n", b);
-    b /= 128.0f; //convert from uS per 4th note to uS per 512th note
-    debug("\tmicros Per 512th: %f\n", b);
+    else pendingControl.clockKeepaliveMicros = CLOCKIN_MIN_WAIT;
+}
 
-    microsPerTimeGradation = uint32_t(floorf(b));
-    debug("\tFINAL VALUE: %u\n", microsPerTimeGradation);
-    debug("\tREAL QN TIME: %u\n", microsPerTimeGradation*64);
+void Chronos::SetPPQN(PPQNType ppqn)
+{
+    pendingControl.clockPPQN = uint8_t(ppqn);
+    UpdateClockKeepalive();
+    controlMailbox.Write(pendingControl);
+}
+
+void Chronos::SetSpecialised(bool isAllowed)
+{
+    pendingControl.isSpecialised = isAllowed;
+    controlMailbox.Write(pendingControl);
+}
+
+void Chronos::SetOutputConfig(uint8_t output, const GateOutputConfig &config)
+{
+    if(output >= NUM_GATE_OUTS) return;
+    pendingOutputTable.outputs[output] = config;
+    outputTableMailbox.Write(pendingOutputTable);
+}
+
+void Chronos::SetRandomSeed(uint32_t seed)
+{
+    pendingOutputTable.randomSeed = seed;
+    outputTableMailbox.Write(pendingOutputTable);
 }
 
 void Chronos::SlowUpdate(uint32_t deltaMicros)
 {
 
 
+    //Where the fast path had got to as of its last update
+    statusMailbox.Read(&status);
+    //a pulse is pending from its edge interrupt on, before the fast path has taken it into its slot
+    bool isResetWaiting = status.isResetPending || io->IsResetPending();
+
 	if(io->ProcessPlayFlag())
     {
-        isPlayMode = !isPlayMode;
+        pendingControl.playToggles++; //the fast path owns play mode, so just count the press
     }
 
-    if(isFollowMode)
+    if(status.isFollowMode)
     {
-        bool isClockLEDOn = beatTime % 64 < 32;
+        bool isClockLEDOn = status.beatTime % (64 * CHRONOS_TICKS_PER_512TH) < 32 * CHRONOS_TICKS_PER_512TH;
         io->SetLEDState(PanelLED::PlayButton, isClockLEDOn?LEDState::SOLID_ON:LEDState::SOLID_HALF);
-        io->SetLEDState(PanelLED::Reset, io->FLAG_RST?LEDState::FADE_FASTEST:LEDState::SOLID_OFF);
+        io->SetLEDState(PanelLED::Reset, isResetWaiting?LEDState::FADE_FASTEST:LEDState::SOLID_OFF);
+        if(status.period16 > 0)
+        {
+            //Convert to BPM; better to be slightly under than over to help prevent double-triggering or weirdness
+            estimatedBPM = (16.0f * 60'000'000.0f / (float(status.period16) * float(status.periodsPerQuarter))) * 0.9999f;
+        }
         SetBPM(estimatedBPM);
     }
-    else if(isPlayMode)
+    else if(status.isPlayMode)
     {
         // -------- Set BPM From Knob --------
         float newBPM = io->IN_BPM_KNOB; //0-4096
@@ -242,14 +559,23 @@ void Chronos::SlowUpdate(uint32_t deltaMicros)
         bpmMod += 1;
         SetBPM(newBPM*bpmMod);
         // -------- Set LEDs --------
-        bool isClockLEDOn = beatTime % 64 < 32;
+        bool isClockLEDOn = status.beatTime % (64 * CHRONOS_TICKS_PER_512TH) < 32 * CHRONOS_TICKS_PER_512TH;
         io->SetLEDState(PanelLED::PlayButton, isClockLEDOn?LEDState::SOLID_ON:LEDState::SOLID_HALF);
         io->SetLEDState(PanelLED::Clock, LEDState::SOLID_OFF);
-        io->SetLEDState(PanelLED::Reset, io->FLAG_RST?LEDState::FADE_FASTEST:LEDState::SOLID_OFF);
+        io->SetLEDState(PanelLED::Reset, isResetWaiting?LEDState::FADE_FASTEST:LEDState::SOLID_OFF);
     }
     else
     {
         io->SetLEDState(PanelLED::PlayButton, LEDState::FADE_SLOW);
-        io->SetLEDState(PanelLED::Reset, io->FLAG_RST?LEDState::FADE_FASTEST:LEDState::SOLID_OFF);
+        io->SetLEDState(PanelLED::Reset, isResetWaiting?LEDState::FADE_FASTEST:LEDState::SOLID_OFF);
     }
+
+    // -------- Hand the inputs to the fast path --------
+    pendingControl.swingKnob = io->IN_SWING_KNOB;
+    pendingControl.swingCV = io->CV_swing;
+    pendingControl.scrubCV = io->CV_scrub;
+    pendingControl.udMult = io->CV_UD_Mult;
+    pendingControl.tmultShift = io->IN_TMULT_SWITCH;
+    pendingControl.udIndex = io->IN_UD_INDEX;
+    controlMailbox.Write(pendingControl);
 }
@@ -6,16 +6,69 @@
 
 #pragma once
 
-#include <cmath>
-
 #include "IO/IOHelper.hpp"
+#include "Timing/TempoEstimator.hpp"
+#include "Timing/PhaseLockedLoop.hpp"
+#include "Timing/PhaseAccumulator.hpp"
+#include "Timing/TempoGlide.hpp"
+#include "Timing/SwingWarp.hpp"
+#include "Timing/GateOutputBank.hpp"
+#include "Timing/MidiClock.hpp"
+#include "Util/SnapshotMailbox.hpp"
+#include "IO/GateTimeline.hpp"
 #include "debug.h"
 #include "MacroMath.h"
 
+/// Resolution of beatTime: 2^7 * 3 * 5 * 7 ticks per quarter note, so straight divisions down to 512th notes and
+/// triplet, quintuplet and septuplet divisions of them all last a whole number of ticks
+#define CHRONOS_TICKS_PER_QUARTER 13440
+#define CHRONOS_TICKS_PER_WHOLE (CHRONOS_TICKS_PER_QUARTER * 4)
+/// One 512th note, the resolution beatTime used to have; knob and CV scalings are still in these
+#define CHRONOS_TICKS_PER_512TH (CHRONOS_TICKS_PER_QUARTER / 128)
+
 #define CLOCKIN_BUFFER_SIZE 32
 
 #define CLOCKIN_MIN_WAIT 100'000
+/// 512th notes without a CLOCK IN pulse before follow mode gives up...
 #define CLOCKIN_WAIT_MULT 32
+/// ...or this many pulse spacings, if that is longer (slow PPQN settings)
+#define CLOCKIN_WAIT_PULSES 3
+
+/// Longest the fast update sleeps, so knob/CV changes, clock pulses and resets are still picked up promptly
+#define CHRONOS_MAX_SLEEP_US 1000
+/// Fast update interval while swing warps beatTime, which the edge scheduler can't predict (25kHz)
+#define CHRONOS_TICK_US 40
+/// Shortest sleep the edge scheduler asks for
+#define CHRONOS_MIN_SLEEP_US 2
+/// Swing cycles per whole note
+#define CHRONOS_SWINGS_PER_BAR 4
+/// Tempo glide time until SetTempoGlide says otherwise: long enough to smooth over knob and CV noise, short enough
+/// that turning the knob still feels immediate
+#define CHRONOS_GLIDE_US 50'000
+
+/// Longest a RESET IN pulse can come after a boundary and still count as on it, so a reset sent with the clock pulse
+/// of a downbeat isn't a whole quantum late
+#define CHRONOS_RESET_GRACE_US 2000
+
+/// @brief Which boundary a RESET IN pulse takes musical time back to the start of the bar on
+enum ResetQuantize : uint8_t
+{
+	RESET_QUANTIZE_IMMEDIATE,
+	RESET_QUANTIZE_16TH,
+	RESET_QUANTIZE_8TH,
+	RESET_QUANTIZE_BEAT,
+	RESET_QUANTIZE_BAR,
+	/// @brief As RESET IN has always worked: the next 8th note in play mode, so MIDI clock out stays on its grid,
+	/// @brief and immediate while following a clock
+	RESET_QUANTIZE_DEFAULT
+};
+
+/// @brief Where a followed clock comes from
+enum ClockSource
+{
+	CLOCK_SOURCE_JACK,
+	CLOCK_SOURCE_MIDI
+};
 
 enum PPQNType
 {
@@ -28,73 +81,222 @@ enum PPQNType
 	PPQN_48 = 48
 };
 
+/// @brief Everything FastUpdate needs from the slow path; published by SlowUpdate and SetBPM
+struct ChronosControl
+{
+	/// @brief Time base increment for the target BPM, Q48 ticks/uS (see PhaseAccumulator::IncrementForBPM); the fast
+	/// @brief path glides to it
+	uint64_t timeBaseIncrement = 0;
+	/// @brief How fast the fast path glides to a new tempo, set by SetTempoGlide (see TempoGlide)
+	uint64_t tempoMaxStep = 0;
+	uint32_t tempoGlideFactor = TempoGlide::FactorForGlide(CHRONOS_GLIDE_US);
+	TempoQuantize tempoQuantize = TEMPO_QUANTIZE_OFF;
+	/// @brief Boundary RESET IN waits for, set by SetResetQuantize
+	ResetQuantize resetQuantize = RESET_QUANTIZE_DEFAULT;
+	/// @brief How long to wait for the next clock in pulse before leaving follow mode
+	int32_t clockKeepaliveMicros = CLOCKIN_MIN_WAIT;
+	/// @brief Number of PLAY button presses so far; the fast path toggles play mode for each one it hasn't seen
+	uint32_t playToggles = 0;
+	/// @brief Copies of the IOHelper inputs the fast path uses, taken at the end of SlowUpdate
+	int16_t swingKnob = 0;
+	int16_t swingCV = 0;
+	int16_t scrubCV = 0;
+	int16_t udMult = 0;
+	uint8_t tmultShift = 0;
+	uint8_t udIndex = 0;
+	/// @brief Pulses per quarter note on CLOCK IN, set by SetPPQN
+	uint8_t clockPPQN = PPQN_24;
+	/// @brief Whether the fast path may use its builds for one PPQN or output layout, set by SetSpecialised
+	bool isSpecialised = true;
+};
+
+/// @brief How every gate out is derived; published by SetOutputConfig and SetRandomSeed
+struct GateOutputTable
+{
+	GateOutputConfig outputs[NUM_GATE_OUTS];
+	/// @brief Seed of the probability and humanize choices; the same seed plays the same choices after a reset
+	uint32_t randomSeed = 0;
+};
+
+/// @brief What the slow path needs to know about the fast path; published at the end of every FastUpdate
+struct ChronosStatus
+{
+	int64_t beatTime = 0;
+	/// @brief Clock in period estimate (uS x16), 0 if there isn't one
+	uint32_t period16 = 0;
+	/// @brief Intervals per quarter note period16 is of: the clock in PPQN, or 4 for USB MIDI (see OnFollowPulse)
+	uint8_t periodsPerQuarter = PPQN_24;
+	bool isPlayMode = false;
+	bool isFollowMode = false;
+	/// @brief A RESET IN pulse is waiting for its boundary
+	bool isResetPending = false;
+};
+
 /// @brief Clock Timing Manager Class
+/// @note FastUpdate and SlowUpdate can run on different cores. Fast path state is only touched by FastUpdate (and the
+/// @note methods it runs with), slow path state only by SlowUpdate and SetBPM; the two only meet through
+/// @note ChronosControl and ChronosStatus snapshots in lock-free mailboxes, so neither side sees a torn value and the
+/// @note fast path never waits on the slow one.
 class Chronos
 {
 	private:
 		/// IO Helper Instance Pointer
 		IOHelper *io;
 
-		/// @brief between 0 and 1024, used in CalcGate
-		int gateLen = 512;
+		//-------- CORE MAILBOXES --------
 
-		/// @brief The current musical time in 512th notes
-		uint32_t beatTime = 0;
-		uint32_t last_beatTime = 0;
+		/// @brief Slow path to fast path
+		SnapshotMailbox<ChronosControl> controlMailbox;
+		/// @brief Fast path to slow path
+		SnapshotMailbox<ChronosStatus> statusMailbox;
+		/// @brief Slow path to fast path, only written when an output is reconfigured
+		SnapshotMailbox<GateOutputTable> outputTableMailbox;
+		/// @brief Fast path: outputTableMailbox version already applied to outputs
+		uint32_t outputTableVersion = 0;
+		/// @brief Slow path: the output table being edited by SetOutputConfig
+		GateOutputTable pendingOutputTable;
+		/// @brief Fast path: the latest consistent control snapshot
+		ChronosControl control;
+		/// @brief Fast path: control.playToggles already acted on
+		uint32_t playTogglesSeen = 0;
+		/// @brief Slow path: the control snapshot being built, published by SlowUpdate and SetBPM
+		ChronosControl pendingControl;
+		/// @brief Slow path: the latest status snapshot
+		ChronosStatus status;
 
-		/// @brief The final beat time, to be modified by CalculateSwing()
-		uint32_t beatTimeFinal = 0;
+		/// @brief The current musical time in ticks (CHRONOS_TICKS_PER_QUARTER); 64 bits, so it never wraps
+		int64_t beatTime = 0;
+		/// @brief Position of beatTime within its bar, kept alongside so swing never has to divide beatTime
+		uint32_t barTicks = 0;
 
-		/// @brief The number of microseconds between incrementations of "time" variable; calculated in SetBPM
-		uint16_t microsPerTimeGradation = 0;
+		/// @brief The final beat time, to be modified by CalculateSwing(); scrub CV can take it below 0
+		int64_t beatTimeFinal = 0;
+
+		/// @brief Free-running time base; beatTime advances by its whole ticks in play mode. Tempo set by tempoGlide
+		PhaseAccumulator timeBase;
+		/// @brief Slews timeBase toward the tempo set in SetBPM
+		TempoGlide tempoGlide;
 		/// @brief Used to prevent setting BPM to its current value
 		float currentExactBPM = 0;
-		
-		/// @brief Microseconds in this time Gradation; when > microsPerTimeGradation, reset and increment beatTime
-		uint16_t timeInThisGradation = 0;
 
-		/// @brief Pretty self explanatory. Number of swing cycles completed per whole note.
-		double swingsPerBar = 4;
+		/// @brief Swing curve, set up for CHRONOS_SWINGS_PER_BAR swing cycles per whole note in Init
+		SwingWarp swingWarp;
+		/// @brief True while CalculateSwing is bending beatTimeFinal, so edges can't be scheduled ahead
+		bool isSwingActive = false;
+
+		/// @brief Phase counter and configuration of each gate out
+		GateOutputBank<NUM_GATE_OUTS> outputs;
+		/// @brief outputs' Advance, or its build for the default layout while the table is that (see SelectFastPath)
+		uint32_t (GateOutputBank<NUM_GATE_OUTS>::*advanceOutputs)(int64_t) = &GateOutputBank<NUM_GATE_OUTS>::Advance;
+		/// @brief Gate out states as of the last FastUpdate, bit i = gate out i
+		uint8_t gateMask = 0;
+		/// @brief HAL::TimeMicros() at the last FastUpdate, i.e. the moment beatTime and the time bases describe
+		uint64_t lastUpdateMicros = 0;
+
+		/// @brief MIDI clock out, stepped from beatTime like the gate outs
+		MidiClockGenerator midiClock;
+		/// @brief Fast path to slow path: timestamped MIDI messages, sent over USB by MidiOut
+		MidiEventFIFO midiEvents;
 
 
 		//-------- EXT CLOCK IN VARIABLES --------
 
-		/// @brief Current PPQN setting. Set by SetPPQN
-		PPQNType clockPPQN = PPQNType::PPQN_24;
-		/// @brief Circular buffer of the time between the most recent clock pulses, used to estimate BPM for interpolation
-		uint64_t clockInDiffBuffer[CLOCKIN_BUFFER_SIZE];
-		/// @brief Write pointer for clockInBuffer
-		uint16_t clockInDiffBufferIterator = 0;
-		/// @brief Current estimated BPM based on clock in timings
+		/// @brief Running estimate of the time between clock pulses, used to estimate BPM for interpolation
+		TempoEstimator<CLOCKIN_BUFFER_SIZE> tempoEstimator;
+		/// @brief Current estimated BPM based on clock in timings. Calculated from tempoEstimator in SlowUpdate
 		float estimatedBPM = 120;
 		/// @brief Time of last clock pulse
 		uint64_t lastClockTime = 0;
 		/// @brief Reset to CLOCK_KEEPALIVE_TIME on each clock in pulse. Used to detect when an external clock is stopped.
 		int32_t externalClockKeepaliveCountdown = 0;
-		/// @brief Used to keep track of when a full quarter note has elapsed
-		uint16_t clockPulseCounter = 0;
+		/// @brief Follows the external clock's phase and tempo; beatTime advances with its NCO in follow mode
+		PhaseLockedLoop pll;
+		/// @brief pll.GetTicks() as of the last update, used to advance beatTime by the NCO's progress
+		uint32_t lastPllTicks = 0;
+		/// @brief Which input follow mode is following; pulses from the other one are ignored until it stops
+		ClockSource followSource = CLOCK_SOURCE_JACK;
+		/// @brief Pulses until the next interval goes into tempoEstimator
+		uint8_t pulsesUntilEstimate = 1;
+		/// @brief Pulses per quarter of the followed clock, fixed when it starts
+		uint32_t followPPQN = PPQN_24;
+		/// @brief OnFollowPulseFor built for the followed clock's PPQN, or the generic one (see SelectFastPath)
+		void (Chronos::*onFollowPulse)(uint64_t edgeMicros, uint64_t nowMicros) = &Chronos::OnFollowPulseFor<0>;
+
+		//-------- RESET IN VARIABLES --------
+
+		/// @brief Set by a RESET IN pulse until beatTime reaches resetPosition; pulses meanwhile are the same reset
+		bool isResetPending = false;
+		/// @brief Timestamp of the pulse the pending reset is for
+		uint64_t resetEdgeMicros = 0;
+		/// @brief beatTime at the boundary the pending reset goes back to the start of the bar on
+		int64_t resetPosition = 0;
+
+		//-------- USB MIDI CLOCK IN VARIABLES --------
+
+		/// @brief Cleared by MIDI Start or Continue, set by Stop. While set, MIDI clocks keep the tempo but don't play
+		/// @note Set from the outset: hosts send clocks while stopped too, so clocks alone never start anything
+		bool isMidiStopped = true;
+		/// @brief Set by Start or Continue: playback picks up on the next MIDI clock, at midiNextClockPosition
+		bool isMidiResumePending = false;
+		/// @brief Song position of the next MIDI clock, in ticks before the TMULT shift. Start sets it to 0 and
+		/// @brief Song Position Pointer to its 16th note; every clock played moves it on by one
+		int64_t midiNextClockPosition = 0;
 		/// @brief Called when clock in goes high, used to update and calculate the input BPM estimate.
-		void AddBeatToBPMEstimate();
+		/// @param edgeMicros timestamp of the clock edge, from the gate in edge interrupt
+		void AddBeatToBPMEstimate(uint64_t edgeMicros);
 		/// @brief Called when clock in goes high, used to update and calculate the input BPM estimate.
+		/// @param edgeMicros timestamp of the clock edge, from the gate in edge interrupt
 		/// @note This version only sets "lastClockTime", with its intended use being to capture the first pulse after
 		/// a long delay that would otherwise incorrectly lower the average BPM estimate.
-		void AddBeatToBPMEstimateLastOnly();
+		void AddBeatToBPMEstimateLastOnly(uint64_t edgeMicros);
+		/// @brief Switches to follow mode on a clock pulse, starting the PLL from the current tempo
+		/// @param edgeMicros timestamp of the clock edge that started the external clock
+		/// @param source where the clock comes from, which sets its PPQN
+		void StartFollowing(uint64_t edgeMicros, ClockSource source);
+		/// @brief Feeds a pulse of the followed clock to the tempo estimate and the PLL, and holds off the keepalive
+		/// @param edgeMicros timestamp of the pulse
+		/// @param nowMicros the time the PLL was last advanced to
+		void OnFollowPulse(uint64_t edgeMicros, uint64_t nowMicros) { (this->*onFollowPulse)(edgeMicros, nowMicros); }
+		/// @brief OnFollowPulse for a clock of PPQN pulses per quarter, so the PLL's pulse spacing is a constant
+		/// @tparam PPQN pulses per quarter of the followed clock, 0 for any (the spacing the PLL was started with)
+		template <uint32_t PPQN>
+		void OnFollowPulseFor(uint64_t edgeMicros, uint64_t nowMicros);
+		/// @brief Thin dispatcher: picks the builds of OnFollowPulse and the gate outs' Advance that fit the followed
+		/// @brief clock and the output table, out of the few there are. Called when either changes.
+		void SelectFastPath();
+		/// @brief Takes the waiting USB MIDI clock and transport messages: clocks are followed like CLOCK IN at 24
+		/// @brief PPQN, Start, Stop and Continue move the transport, Song Position Pointer says where Continue starts
+		/// @param nowMicros the time the PLL was last advanced to
+		void ProcessMidiIn(uint64_t nowMicros);
 
 		// -------- Methods --------
 
-		/// @brief Calculate whether a gate should be on
-		/// @param divisor number of 512th notes the gate cycle should last
-		/// @param gateLen number between 0 and 1024 indicating the gate length
-		/// @return whether the gate should be on
-		bool CalcGate(uint32_t thisBeatTime, uint16_t divisor, uint16_t gateLen);
-		
-			/// @brief Calculate whether a gate should be on, according to beatTime's current value
-			/// @param divisor number of 512th notes the gate cycle should last
-			/// @param gateLen number between 0 and 1024 indicating the gate length
-			/// @return whether the gate should be on currently
-			bool CalcGate(uint16_t divisor, uint16_t gateLen)
-			{ return CalcGate(beatTimeFinal, divisor, gateLen); }
+		/// @brief Moves beatTime (and barTicks with it) forward
+		/// @param ticks time base ticks, after the TMULT shift
+		void AdvanceBeatTime(uint32_t ticks);
+		/// @brief Puts beatTime back to the start of the first bar
+		void ResetBeatTime();
+		/// @brief Moves beatTime (and barTicks with it) straight to a position, e.g. a MIDI Continue
+		/// @param position ticks, 0 or more
+		void SetBeatTime(int64_t position);
 			
+		/// @brief Works out how long follow mode waits for a CLOCK IN pulse, from the BPM and PPQN. Slow path.
+		void UpdateClockKeepalive();
+
+		/// @brief Takes up the slow path's target tempo, now or on the next beat or bar, and glides timeBase toward it
+		/// @param deltaMicros microseconds since the last update
+		/// @param previousBarTicks barTicks as of the last update
+		void UpdateTempo(uint32_t deltaMicros, uint32_t previousBarTicks);
+
+		/// @brief Takes RESET IN pulses into the pending reset, and applies it once beatTime reaches its boundary. Runs
+		/// @brief after beatTime has been moved on for this update.
+		/// @param deltaMicros microseconds since the last update
+		/// @return true if the reset was applied
+		/// @note The boundary is the first one (see ResetQuantize) at or after where beatTime was at the pulse, worked
+		/// @note out back from now at the current speed. beatTime lands on it exactly: whatever this update moved past
+		/// @note it is carried into the new bar, so the outputs are where they would be had the update run right on it.
+		bool ProcessReset(uint32_t deltaMicros);
+
 		/// @brief Calculates from and applies swing to beatTimeFinal. to be done once per update after setting the value of beatTimeFinal to beatTime
 		void CalculateSwing();
 
@@ -102,9 +304,9 @@ class Chronos
 		
 		// -------- VARIABLES --------
 
-		/// @brief True when clock should be running on its own; Overridden by isFollowMode
+		/// @brief True when clock should be running on its own; Overridden by isFollowMode. Fast path state.
 		bool isPlayMode = false;
-		/// @brief True when clock should be synchronized to clock input; Higher priority than isPlayMode
+		/// @brief True when clock should be synchronized to clock input; Higher priority than isPlayMode. Fast path state.
 		bool isFollowMode = false;
 
 		// --------  METHODS  --------
@@ -118,7 +320,66 @@ class Chronos
 		/// @param deltaMicros microseconds since the last time this was run
 		void SlowUpdate(uint32_t deltaMicros);
 
-		/// @brief Sets the BPM and calculates microsPerTimeGradation (slow!)
+		/// @brief Edge scheduler: how long until FastUpdate next needs to run
+		/// @return microseconds until the earliest gate out changes state, MIDI clock is due or a pending reset's
+		/// @return boundary comes up, assuming nothing is changed in the meantime.
+		/// @note Capped to CHRONOS_MAX_SLEEP_US, and CHRONOS_TICK_US while swing is active
+		uint32_t GetMicrosUntilNextEdge();
+
+		/// @brief Predicts the gate out edges in a window of time, assuming nothing is changed in the meantime
+		/// @param edges buffer for the edges, filled in time order
+		/// @param maxEdges size of the buffer
+		/// @param fromCycle start of the window; the first edge is always the gate state at this cycle
+		/// @param toCycle end of the window
+		/// @param epochMicros HAL::TimeMicros() of cycle 0
+		/// @param cyclesPerMicro cycles per microsecond
+		/// @return number of edges written
+		/// @note While stopped or swinging the current gate state is simply held, so those outputs lag by the window.
+		/// @note Nothing past a pending reset's boundary is predicted either; the update on the boundary takes over.
+		/// @note A tempo glide is taken at its speed as of the last update, which puts edges out by a few uS at most
+		/// @note on the steepest glides.
+		uint32_t PredictEdges(GateEdge *edges, uint32_t maxEdges, uint64_t fromCycle, uint64_t toCycle, uint64_t epochMicros, uint32_t cyclesPerMicro);
+
+		/// @brief Sets the target BPM and calculates its time base increment (slow!). Slow path; FastUpdate glides to it
+		/// @brief as set by SetTempoGlide.
 		/// @param exactBPM the target BPM
 		void SetBPM(float exactBPM);
+
+		/// @brief Sets how the fast path takes up a new BPM. Slow path; FastUpdate picks it up.
+		/// @param glideMicros time to cover 63% of a tempo change, 0 to step straight to it
+		/// @param maxBPMPerSecond fastest the tempo may change, 0 for no limit
+		/// @param quantize hold each change until the next beat or bar starts
+		/// @note While stopped, or from 0BPM, a new tempo is taken up at once: there is nothing to glide from.
+		void SetTempoGlide(uint32_t glideMicros, float maxBPMPerSecond, TempoQuantize quantize);
+
+		/// @brief Sets which boundary RESET IN waits for, in play and follow mode alike. Slow path; FastUpdate picks it
+		/// @brief up, for pulses from then on.
+		/// @note The edge scheduler wakes the fast path on the boundary, so a quantised reset lands on it to the uS.
+		/// @note An immediate one lands on the pulse musically, but the outputs only move on the next update: at most
+		/// @note CHRONOS_MAX_SLEEP_US later.
+		void SetResetQuantize(ResetQuantize quantize);
+		/// @brief True while a RESET IN pulse waits for its boundary, as of the fast path's last update. Slow path.
+		bool IsResetPending();
+
+		/// @brief Sets how many CLOCK IN pulses make a quarter note. Slow path; a clock that is already being followed
+		/// @brief keeps its pulse spacing until it next starts.
+		void SetPPQN(PPQNType ppqn);
+		/// @brief Lets the fast path use its builds for 1, 4, 24 and 48 PPQN and the default output layout (the
+		/// @brief default), or keeps it on the generic code. Slow path; taken up when a clock next starts or the output
+		/// @brief table next changes.
+		void SetSpecialised(bool isAllowed);
+
+		/// @brief Changes what a gate out plays. Slow path; FastUpdate picks it up.
+		/// @param output gate out, 0 to NUM_GATE_OUTS - 1
+		/// @param config division, gate length, phase offset, pattern and modifiers
+		void SetOutputConfig(uint8_t output, const GateOutputConfig &config);
+		/// @brief MIDI messages queued by the fast path; the slow path is the consumer
+		MidiEventFIFO &GetMidiEvents() { return midiEvents; }
+		/// @brief Tempo of the followed clock, as last worked out by SlowUpdate. Slow path.
+		float GetEstimatedBPM() const { return estimatedBPM; }
+		/// @brief What a gate out is currently set to play (as last set by the slow path)
+		const GateOutputConfig &GetOutputConfig(uint8_t output) const { return pendingOutputTable.outputs[output]; }
+		/// @brief Sets the seed of every gate out's probability and humanize choices. Takes effect on the fast path's
+		/// @brief next update
+		void SetRandomSeed(uint32_t seed);
 };
@@ -0,0 +1,113 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+/// @brief Hardware Abstraction Layer
+/// @note Everything outside of main.cpp talks to the hardware through the HAL namespace, so the clock engine can be
+/// @note built and measured on a host machine. The implementation is picked at compile time:
+/// @note HAL_NATIVE defined:  simulated hardware (HALNative.hpp), used by the env:native target
+/// @note otherwise:           thin inline wrappers around the pico-sdk (HALPico.hpp)
+/// @note Every implementation provides the same functions:
+/// @note -------- Clock Source --------
+/// @note uint64_t TimeMicros()                         microseconds since boot
+/// @note void     SleepMicros(uint32_t us)             blocking delay
+/// @note -------- Cores and Interrupts --------
+/// @note uint32_t CoreNum()                            the core the caller runs on, 0 to HAL_NUM_CORES - 1
+/// @note uint32_t DisableInterrupts()                  masks interrupts on the calling core only; returns the previous
+/// @note                                               state for RestoreInterrupts
+/// @note void     RestoreInterrupts(uint32_t state)
+/// @note -------- Alarm --------
+/// @note void     AlarmStart(uint64_t targetMicros, AlarmCallback callback)
+/// @note                                               one repeating alarm, its interrupt on the calling core; see
+/// @note                                               AlarmCallback for how it re-arms
+/// @note -------- GPIO Bank --------
+/// @note void     GpioInitInput(uint8_t pin, bool pullUp)
+/// @note void     GpioInitOutput(uint8_t pin)
+/// @note bool     GpioGet(uint8_t pin)
+/// @note void     GpioPut(uint8_t pin, bool value)
+/// @note void     GpioPutMasked(uint32_t mask, uint32_t values)
+/// @note                                               sets every pin in mask (bit n = GPIO n) at once, in one write
+/// @note void     GpioEnableFallingEdgeIRQ(uint8_t pin, EdgeCallback callback)
+/// @note -------- PWM --------
+/// @note void     PwmInit(uint8_t pin)                 hands a pin to its PWM slice, HAL_PWM_TOP + 1 steps, duty 0
+/// @note void     PwmSet(uint8_t pin, uint16_t duty)   duty in steps of the period, 0 (off) to HAL_PWM_TOP
+/// @note -------- ADC Mux --------
+/// @note void     AdcInit()                            sets up the ADC and the mux address lines
+/// @note void     AdcSelect(uint8_t addr)              drives the mux address lines (0-7)
+/// @note uint16_t AdcRead()                            raw 12 bit conversion of the selected mux channel
+/// @note void     AdcStartScan(uint8_t addr, uint32_t samplesPerDwell, uint32_t sampleRateHz, AdcDwellCallback callback)
+/// @note                                               free-running background scan, see AdcDwellCallback
+/// @note -------- Flash Storage --------
+/// @note const uint8_t *FlashStorage()                 the last HAL_FLASH_STORAGE_SECTORS flash sectors, memory mapped
+/// @note                                               (all 0xFF when erased)
+/// @note void     FlashStorageErase(uint32_t sector)   erases one of them back to 0xFF, 0 to HAL_FLASH_STORAGE_SECTORS - 1
+/// @note void     FlashStorageProgram(uint32_t offset, const uint8_t *page)
+/// @note                                               programs one HAL_FLASH_PAGE_SIZE page at a page aligned offset;
+/// @note                                               like NOR flash, programming can only clear bits
+/// @note -------- USB MIDI --------
+/// @note bool     MidiWrite(const uint8_t *message, uint32_t length)
+/// @note                                               queues one MIDI message on the USB MIDI port; false if it
+/// @note                                               couldn't be (nothing connected, or the endpoint is full)
+/// @note void     MidiSetReceiveCallback(MidiReceiveCallback callback)
+/// @note                                               calls back with every message received on the USB MIDI port
+/// @note -------- USB Serial --------
+/// @note uint32_t SerialWriteAvailable()               bytes SerialWrite can take right now without waiting (0 while
+/// @note                                               nothing is connected)
+/// @note void     SerialWrite(const uint8_t *data, uint32_t length)
+/// @note                                               raw bytes to the USB serial port, alongside printf's text but
+/// @note                                               without its newline translation; at most SerialWriteAvailable()
+
+#include <stdint.h>
+
+namespace HAL
+{
+    /// @brief Called from interrupt context when a watched pin sees an edge
+    /// @param pin GPIO number the edge happened on
+    /// @param timeMicros TimeMicros() at the edge, taken before anything else runs in the handler
+    typedef void (*EdgeCallback)(uint8_t pin, uint64_t timeMicros);
+
+    /// @brief Called from interrupt context each time the background ADC scan has filled a dwell
+    /// @param samples raw 12 bit conversions at the current mux address, oldest first (the first ones are settling)
+    /// @param count number of samples
+    /// @return mux address to dwell on next; it is selected before the next dwell's first sample
+    typedef uint8_t (*AdcDwellCallback)(const uint16_t *samples, uint32_t count);
+
+    /// @brief Called from interrupt context when the alarm comes due. Re-arms it the way the pico-sdk's alarm pool
+    /// @brief does: a negative return that many microseconds after the time it was due (so lateness and the
+    /// @brief callback's own run time don't add up), a positive one that many after the callback returns, 0 not at all.
+    typedef int64_t (*AlarmCallback)();
+
+    /// @brief Called from the USB stack's context with each MIDI message received
+    /// @param message status byte, then any data bytes
+    /// @param length 1 to 3
+    /// @param timeMicros TimeMicros() when the USB stack handed over the transfer carrying it; messages that shared a
+    /// @param timeMicros transfer share it
+    typedef void (*MidiReceiveCallback)(const uint8_t *message, uint32_t length, uint64_t timeMicros);
+}
+
+/// Number of cores
+#define HAL_NUM_CORES 2
+
+/// Most samples one ADC scan dwell can hold
+#define HAL_ADC_SCAN_MAX_SAMPLES 32
+
+/// Highest PWM duty; the period is HAL_PWM_TOP + 1 system clocks (about 4.3kHz at 280MHz)
+#define HAL_PWM_TOP 65535
+
+/// Size of a flash sector (the erase unit)
+#define HAL_FLASH_SECTOR_SIZE 4096
+/// Sectors of flash storage, so a new copy can be written before the old one is erased
+#define HAL_FLASH_STORAGE_SECTORS 2
+#define HAL_FLASH_STORAGE_SIZE (HAL_FLASH_STORAGE_SECTORS * HAL_FLASH_SECTOR_SIZE)
+/// Size of a flash program operation
+#define HAL_FLASH_PAGE_SIZE 256
+
+#ifdef HAL_NATIVE
+#include "HALNative.hpp"
+#else
+#include "HALPico.hpp"
+#endif
@@ -0,0 +1,281 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef HAL_NATIVE
+
+#include "HAL.hpp"
+
+namespace
+{
+    uint64_t simMicros = 0;
+    bool     simPins[HAL_NUM_GPIO];
+    uint16_t simAdc[HAL_NUM_ADC_CHANNELS];
+    uint8_t  simMuxAddr = 0;
+    HAL::EdgeCallback simEdgeCallbacks[HAL_NUM_GPIO];
+    uint32_t simGpioWriteCount = 0;
+    uint16_t simPwmDuties[HAL_NUM_GPIO];
+    uint32_t simPwmWriteCount = 0;
+
+    HAL::AdcDwellCallback simScanCallback = nullptr;
+    uint32_t simScanSamplesPerDwell = 0;
+    uint32_t simScanSampleRateHz = 0;
+    /// @brief Progress through the current dwell, in samples x 1'000'000
+    uint64_t simScanProgress = 0;
+
+    uint8_t simFlash[HAL_FLASH_STORAGE_SIZE];
+    bool simFlashIsInitialized = false;
+    uint32_t simFlashEraseCount = 0;
+    /// @brief Flash operations left before the simulated power cut
+    uint32_t simFlashOperationsLeft = UINT32_MAX;
+
+    /// @brief Uses up one flash operation; false once the power has been cut
+    bool TakeFlashOperation()
+    {
+        if(simFlashOperationsLeft == 0) return false;
+        if(simFlashOperationsLeft != UINT32_MAX) simFlashOperationsLeft--;
+        return true;
+    }
+
+    MidiLogEntry simMidiLog[HAL_SIM_MIDI_LOG_SIZE];
+    uint32_t simMidiLogCount = 0;
+    HAL::MidiReceiveCallback simMidiReceiveCallback = nullptr;
+
+    uint8_t simSerialLog[HAL_SIM_SERIAL_LOG_SIZE];
+    uint32_t simSerialLogCount = 0;
+    uint32_t simSerialRoom = UINT32_MAX;
+
+    HAL::AlarmCallback simAlarmCallback = nullptr;
+    uint64_t simAlarmTarget = 0;
+    uint32_t simAlarmLate = 0;
+    uint32_t simAlarmRun = 0;
+
+    /// @brief Runs the background ADC scan over time the clock is moving forward by
+    void AdvanceScan(uint64_t us)
+    {
+        if(!simScanCallback) return;
+
+        //the mux input is held for the whole dwell, so every sample of it reads the same value
+        simScanProgress += us * simScanSampleRateHz;
+        while(simScanProgress >= uint64_t(simScanSamplesPerDwell) * 1'000'000)
+        {
+            simScanProgress -= uint64_t(simScanSamplesPerDwell) * 1'000'000;
+            uint16_t samples[HAL_ADC_SCAN_MAX_SAMPLES];
+            for(uint32_t i = 0; i < simScanSamplesPerDwell; i++) samples[i] = simAdc[simMuxAddr];
+            HAL::AdcSelect(simScanCallback(samples, simScanSamplesPerDwell));
+        }
+    }
+
+    void AdvanceTo(uint64_t micros)
+    {
+        if(micros <= simMicros) return;
+        AdvanceScan(micros - simMicros);
+        simMicros = micros;
+    }
+}
+
+//-------- HAL --------
+
+uint64_t HAL::TimeMicros()                      { return simMicros; }
+void     HAL::SleepMicros(uint32_t us)          { (void)us; }
+
+//the simulation is all one core, and has no interrupts to mask
+uint32_t HAL::CoreNum()                         { return 0; }
+uint32_t HAL::DisableInterrupts()               { return 0; }
+void     HAL::RestoreInterrupts(uint32_t state) { (void)state; }
+
+void HAL::AlarmStart(uint64_t targetMicros, AlarmCallback callback)
+{
+    simAlarmCallback = callback;
+    simAlarmTarget = targetMicros;
+}
+
+void HAL::GpioInitInput(uint8_t pin, bool pullUp)
+{
+    if(pin < HAL_NUM_GPIO) simPins[pin] = pullUp;
+}
+void HAL::GpioInitOutput(uint8_t pin)
+{
+    if(pin < HAL_NUM_GPIO) simPins[pin] = false;
+}
+bool HAL::GpioGet(uint8_t pin)                  { return pin < HAL_NUM_GPIO && simPins[pin]; }
+void HAL::GpioPut(uint8_t pin, bool value)
+{
+    if(pin < HAL_NUM_GPIO) simPins[pin] = value;
+    simGpioWriteCount++;
+}
+void HAL::GpioPutMasked(uint32_t mask, uint32_t values)
+{
+    for(int pin = 0; pin < HAL_NUM_GPIO; pin++)
+    {
+        if(mask & (1UL << pin)) simPins[pin] = values & (1UL << pin);
+    }
+    simGpioWriteCount++;
+}
+
+void HAL::GpioEnableFallingEdgeIRQ(uint8_t pin, EdgeCallback callback)
+{
+    if(pin < HAL_NUM_GPIO) simEdgeCallbacks[pin] = callback;
+}
+
+void HAL::PwmInit(uint8_t pin)
+{
+    if(pin < HAL_NUM_GPIO) simPwmDuties[pin] = 0;
+}
+void HAL::PwmSet(uint8_t pin, uint16_t duty)
+{
+    if(pin < HAL_NUM_GPIO) simPwmDuties[pin] = duty;
+    simPwmWriteCount++;
+}
+
+void     HAL::AdcInit()                         { simMuxAddr = 0; }
+void     HAL::AdcSelect(uint8_t addr)           { simMuxAddr = addr % HAL_NUM_ADC_CHANNELS; }
+uint16_t HAL::AdcRead()                         { return simAdc[simMuxAddr]; }
+
+void HAL::AdcStartScan(uint8_t addr, uint32_t samplesPerDwell, uint32_t sampleRateHz, AdcDwellCallback callback)
+{
+    AdcSelect(addr);
+    simScanSamplesPerDwell = samplesPerDwell < HAL_ADC_SCAN_MAX_SAMPLES ? samplesPerDwell : HAL_ADC_SCAN_MAX_SAMPLES;
+    simScanSampleRateHz = sampleRateHz;
+    simScanCallback = callback;
+    simScanProgress = 0;
+}
+
+const uint8_t *HAL::FlashStorage()
+{
+    if(!simFlashIsInitialized) HALSim::WipeFlash();
+    return simFlash;
+}
+void HAL::FlashStorageErase(uint32_t sector)
+{
+    if(!simFlashIsInitialized) HALSim::WipeFlash();
+    if(sector >= HAL_FLASH_STORAGE_SECTORS || !TakeFlashOperation()) return;
+    for(uint32_t i = 0; i < HAL_FLASH_SECTOR_SIZE; i++) simFlash[sector * HAL_FLASH_SECTOR_SIZE + i] = 0xFF;
+    simFlashEraseCount++;
+}
+void HAL::FlashStorageProgram(uint32_t offset, const uint8_t *page)
+{
+    if(!simFlashIsInitialized) HALSim::WipeFlash();
+    offset &= ~uint32_t(HAL_FLASH_PAGE_SIZE - 1);
+    if(offset + HAL_FLASH_PAGE_SIZE > HAL_FLASH_STORAGE_SIZE || !TakeFlashOperation()) return;
+    //NOR flash: programming only ever clears bits
+    for(uint32_t i = 0; i < HAL_FLASH_PAGE_SIZE; i++) simFlash[offset + i] &= page[i];
+}
+
+bool HAL::MidiWrite(const uint8_t *message, uint32_t length)
+{
+    if(length == 0 || length > 3) return false;
+    if(simMidiLogCount < HAL_SIM_MIDI_LOG_SIZE)
+    {
+        MidiLogEntry &entry = simMidiLog[simMidiLogCount];
+        entry.timeMicros = simMicros;
+        for(uint32_t i = 0; i < 3; i++) entry.bytes[i] = i < length ? message[i] : 0;
+        entry.length = uint8_t(length);
+    }
+    simMidiLogCount++;
+    return true;
+}
+void HAL::MidiSetReceiveCallback(MidiReceiveCallback callback) { simMidiReceiveCallback = callback; }
+
+uint32_t HAL::SerialWriteAvailable()            { return simSerialRoom; }
+void HAL::SerialWrite(const uint8_t *data, uint32_t length)
+{
+    if(length > simSerialRoom) length = simSerialRoom;
+    if(simSerialRoom != UINT32_MAX) simSerialRoom -= length;
+    for(uint32_t i = 0; i < length; i++)
+    {
+        if(simSerialLogCount < HAL_SIM_SERIAL_LOG_SIZE) simSerialLog[simSerialLogCount] = data[i];
+        simSerialLogCount++;
+    }
+}
+
+//-------- HALSim --------
+
+void HALSim::Reset()
+{
+    simMicros = 0;
+    simMuxAddr = 0;
+    for(int i = 0; i < HAL_NUM_GPIO; i++)
+    {
+        simPins[i] = false;
+        simEdgeCallbacks[i] = nullptr;
+        simPwmDuties[i] = 0;
+    }
+    simGpioWriteCount = 0;
+    simPwmWriteCount = 0;
+    for(int i = 0; i < HAL_NUM_ADC_CHANNELS; i++) simAdc[i] = 0;
+    simScanCallback = nullptr;
+    simMidiLogCount = 0;
+    simMidiReceiveCallback = nullptr;
+    simSerialLogCount = 0;
+    simSerialRoom = UINT32_MAX;
+    simFlashOperationsLeft = UINT32_MAX;
+    simAlarmCallback = nullptr;
+    simAlarmLate = 0;
+    simAlarmRun = 0;
+}
+
+void HALSim::WipeFlash()
+{
+    for(uint32_t i = 0; i < HAL_FLASH_STORAGE_SIZE; i++) simFlash[i] = 0xFF;
+    simFlashIsInitialized = true;
+}
+uint32_t HALSim::GetGpioWriteCount()            { return simGpioWriteCount; }
+uint16_t HALSim::GetPwmDuty(uint8_t pin)        { return pin < HAL_NUM_GPIO ? simPwmDuties[pin] : 0; }
+uint32_t HALSim::GetPwmWriteCount()             { return simPwmWriteCount; }
+uint32_t HALSim::GetFlashEraseCount()           { return simFlashEraseCount; }
+void HALSim::SetFlashPowerCut(uint32_t operations) { simFlashOperationsLeft = operations; }
+uint32_t HALSim::GetMidiLogCount()              { return simMidiLogCount; }
+const MidiLogEntry &HALSim::GetMidiLogEntry(uint32_t index)
+{
+    return simMidiLog[index < HAL_SIM_MIDI_LOG_SIZE ? index : HAL_SIM_MIDI_LOG_SIZE - 1];
+}
+
+uint32_t HALSim::GetSerialLogCount()            { return simSerialLogCount; }
+const uint8_t *HALSim::GetSerialLog()           { return simSerialLog; }
+void HALSim::SetSerialRoom(uint32_t bytes)      { simSerialRoom = bytes; }
+
+void HALSim::ReceiveMidi(const uint8_t *message, uint32_t length)
+{
+    if(simMidiReceiveCallback && length > 0 && length <= 3) simMidiReceiveCallback(message, length, simMicros);
+}
+
+void HALSim::SetAlarmTiming(uint32_t lateMicros, uint32_t runMicros)
+{
+    simAlarmLate = lateMicros;
+    simAlarmRun = runMicros;
+}
+
+void HALSim::AdvanceMicros(uint64_t us)
+{
+    uint64_t end = simMicros + us;
+    //a callback that runs past the end still finishes, and time ends up where it returned
+    while(simAlarmCallback && simAlarmTarget + simAlarmLate <= end)
+    {
+        //an alarm re-armed into the past fires straight away, as the alarm pool does
+        AdvanceTo(simAlarmTarget + simAlarmLate);
+        int64_t repeat = simAlarmCallback();
+        AdvanceTo(simMicros + simAlarmRun);
+        if(repeat < 0)      simAlarmTarget -= repeat;
+        else if(repeat > 0) simAlarmTarget = simMicros + uint64_t(repeat);
+        else                simAlarmCallback = nullptr;
+    }
+    AdvanceTo(end);
+}
+void HALSim::SetPin(uint8_t pin, bool level)
+{
+    if(pin >= HAL_NUM_GPIO) return;
+    bool wasHigh = simPins[pin];
+    simPins[pin] = level;
+    if(wasHigh && !level && simEdgeCallbacks[pin]) simEdgeCallbacks[pin](pin, simMicros);
+}
+bool HALSim::GetPin(uint8_t pin)                { return HAL::GpioGet(pin); }
+
+void HALSim::SetAdcChannel(uint8_t addr, uint16_t value)
+{
+    simAdc[addr % HAL_NUM_ADC_CHANNELS] = value;
+}
+
+#endif
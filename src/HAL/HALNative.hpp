@@ -0,0 +1,158 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Pico on-board LED pin, kept so shared code can reference it on the host
+#ifndef PICO_DEFAULT_LED_PIN
+#define PICO_DEFAULT_LED_PIN 25
+#endif
+
+#define HAL_NUM_GPIO 30
+#define HAL_NUM_ADC_CHANNELS 8
+
+/// @brief Simulated HAL implementation for the env:native target.
+/// @note Time only moves when the simulation advances it; SleepMicros does not advance time, so ADC settling delays
+/// @note don't distort a simulated timeline.
+namespace HAL
+{
+    //-------- Clock Source --------
+
+    uint64_t TimeMicros();
+    void     SleepMicros(uint32_t us);
+
+    //-------- Cores and Interrupts --------
+
+    uint32_t CoreNum();
+    uint32_t DisableInterrupts();
+    void     RestoreInterrupts(uint32_t state);
+
+    //-------- Alarm --------
+
+    void AlarmStart(uint64_t targetMicros, AlarmCallback callback);
+
+    //-------- GPIO Bank --------
+
+    void GpioInitInput(uint8_t pin, bool pullUp);
+    void GpioInitOutput(uint8_t pin);
+    bool GpioGet(uint8_t pin);
+    void GpioPut(uint8_t pin, bool value);
+    void GpioPutMasked(uint32_t mask, uint32_t values);
+    void GpioEnableFallingEdgeIRQ(uint8_t pin, EdgeCallback callback);
+
+    //-------- PWM --------
+
+    void PwmInit(uint8_t pin);
+    void PwmSet(uint8_t pin, uint16_t duty);
+
+    //-------- ADC Mux --------
+
+    void     AdcInit();
+    void     AdcSelect(uint8_t addr);
+    uint16_t AdcRead();
+    void     AdcStartScan(uint8_t addr, uint32_t samplesPerDwell, uint32_t sampleRateHz, AdcDwellCallback callback);
+
+    //-------- Flash Storage --------
+
+    const uint8_t *FlashStorage();
+    void           FlashStorageErase(uint32_t sector);
+    void           FlashStorageProgram(uint32_t offset, const uint8_t *page);
+
+    //-------- USB MIDI --------
+
+    bool MidiWrite(const uint8_t *message, uint32_t length);
+    void MidiSetReceiveCallback(MidiReceiveCallback callback);
+
+    //-------- USB Serial --------
+
+    uint32_t SerialWriteAvailable();
+    void     SerialWrite(const uint8_t *data, uint32_t length);
+}
+
+/// Most USB serial bytes the simulation keeps; later ones are still counted, but not kept
+#define HAL_SIM_SERIAL_LOG_SIZE (1 << 20)
+
+/// Most MIDI messages the simulated USB port keeps; later ones are still counted, but not kept
+#define HAL_SIM_MIDI_LOG_SIZE 16384
+
+/// @brief A MIDI message as it left the simulated USB port
+struct MidiLogEntry
+{
+    uint64_t timeMicros;
+    uint8_t bytes[3];
+    uint8_t length;
+};
+
+/// @brief Controls for the simulated hardware, used by host-side benchmarks
+namespace HALSim
+{
+    /// @brief Returns every pin, ADC channel and the clock to power-on state. Flash storage survives, as on hardware.
+    void Reset();
+
+    /// @brief Erases the simulated flash storage, as on a factory fresh chip
+    void WipeFlash();
+
+    /// @brief Number of GpioPut and GpioPutMasked calls since Reset; each is one write to the output register
+    uint32_t GetGpioWriteCount();
+
+    /// @brief Current PWM duty of a pin (0 if it isn't a PWM pin)
+    uint16_t GetPwmDuty(uint8_t pin);
+
+    /// @brief Number of PwmSet calls since Reset, over all pins
+    uint32_t GetPwmWriteCount();
+
+    /// @brief Number of times a simulated flash storage sector has been erased
+    uint32_t GetFlashEraseCount();
+
+    /// @brief Lets the next operations flash erases and programs through, then ignores the rest, as if the power had
+    /// @brief gone; UINT32_MAX (as Reset leaves it) for no cut
+    void SetFlashPowerCut(uint32_t operations);
+
+    /// @brief Number of MIDI messages written since Reset (only the first HAL_SIM_MIDI_LOG_SIZE are kept)
+    uint32_t GetMidiLogCount();
+
+    /// @brief A MIDI message written since Reset, stamped with the simulated time it was written at
+    /// @param index 0 (the first) to min(GetMidiLogCount(), HAL_SIM_MIDI_LOG_SIZE) - 1
+    const MidiLogEntry &GetMidiLogEntry(uint32_t index);
+
+    /// @brief Number of bytes written to the USB serial port since Reset (only the first HAL_SIM_SERIAL_LOG_SIZE are
+    /// @brief kept, in GetSerialLog)
+    uint32_t GetSerialLogCount();
+    const uint8_t *GetSerialLog();
+
+    /// @brief Sets what SerialWriteAvailable reports; each SerialWrite then uses up its length of it. Reset sets it
+    /// @brief to UINT32_MAX (a host that keeps up with anything)
+    void SetSerialRoom(uint32_t bytes);
+
+    /// @brief Delivers a MIDI message to the USB MIDI port, as if a USB packet carrying it had just arrived
+    /// @note Fires the receive callback synchronously, stamped with the current simulated time
+    void ReceiveMidi(const uint8_t *message, uint32_t length);
+
+    /// @brief Sets how the alarm fires: its callback starts lateMicros after the alarm is due (interrupt entry and the
+    /// @brief alarm pool's own handler) and returns runMicros later. Reset sets both to 0.
+    void SetAlarmTiming(uint32_t lateMicros, uint32_t runMicros);
+
+    /// @brief Moves simulated time forward, running any background ADC scan dwells and alarm callbacks that come due
+    /// @brief meanwhile
+    /// @param us microseconds to advance
+    void AdvanceMicros(uint64_t us);
+
+    /// @brief Drives a pin from the outside world (e.g. a jack or button)
+    /// @note Fires the pin's edge callback synchronously, stamped with the current simulated time
+    /// @param pin GPIO number
+    /// @param level electrical level; remember the panel inputs are active low
+    void SetPin(uint8_t pin, bool level);
+
+    /// @brief Reads a pin's current level, including values written by the firmware
+    bool GetPin(uint8_t pin);
+
+    /// @brief Sets the raw value the ADC returns when the mux is on a given address
+    /// @param addr mux address, 0-7
+    /// @param value raw ADC value, 0-4095
+    void SetAdcChannel(uint8_t addr, uint16_t value);
+}
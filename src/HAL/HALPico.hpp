@@ -0,0 +1,253 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+
+/// ADC input the mux output is wired to
+#define GPIO_ADC 26
+
+/// @brief pico-sdk HAL implementation. Everything is inline so the hot path costs the same as calling the SDK directly.
+namespace HAL
+{
+    /// @brief Pins that connect to the address select lines of the ADC MUX
+    static const uint8_t MUX_ADDR_PINS[3] = {11, 12, 13};
+
+    //-------- Clock Source --------
+
+    inline uint64_t TimeMicros()                { return time_us_64(); }
+    inline void     SleepMicros(uint32_t us)    { sleep_us(us); }
+
+    //-------- Cores and Interrupts --------
+
+    inline uint32_t CoreNum()                   { return get_core_num(); }
+    inline uint32_t DisableInterrupts()         { return save_and_disable_interrupts(); }
+    inline void RestoreInterrupts(uint32_t state) { restore_interrupts(state); }
+
+    //-------- Alarm --------
+
+    inline AlarmCallback &AlarmCallbackSlot()
+    {
+        static AlarmCallback callback = nullptr;
+        return callback;
+    }
+    inline int64_t AlarmHandler(alarm_id_t id, void *userData) { return AlarmCallbackSlot()(); }
+    /// @note Gets its own alarm pool on hardware alarm 1, so the interrupt runs on the calling core
+    inline void AlarmStart(uint64_t targetMicros, AlarmCallback callback)
+    {
+        AlarmCallbackSlot() = callback;
+        alarm_pool_t *pool = alarm_pool_create(1, 1);
+        alarm_pool_add_alarm_at(pool, from_us_since_boot(targetMicros), &AlarmHandler, nullptr, true);
+    }
+
+    //-------- GPIO Bank --------
+
+    inline void GpioInitInput(uint8_t pin, bool pullUp)
+    {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+        gpio_set_pulls(pin, pullUp, false);
+    }
+    inline void GpioInitOutput(uint8_t pin)
+    {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_OUT);
+    }
+    inline bool GpioGet(uint8_t pin)                { return gpio_get(pin); }
+    inline void GpioPut(uint8_t pin, bool value)    { gpio_put(pin, value); }
+    /// @note gpio_put_masked is a single SIO toggle write, so all the changed pins switch on the same clock cycle
+    inline void GpioPutMasked(uint32_t mask, uint32_t values) { gpio_put_masked(mask, values); }
+
+    /// @brief The pico-sdk only allows one GPIO callback per core, so every watched pin shares this one
+    inline EdgeCallback &EdgeCallbackSlot()
+    {
+        static EdgeCallback callback = nullptr;
+        return callback;
+    }
+    inline void EdgeIRQHandler(uint gpio, uint32_t events)
+    {
+        uint64_t now = time_us_64(); //stamp first, so the handler's own cost doesn't add to the timestamp
+        EdgeCallback callback = EdgeCallbackSlot();
+        if(callback) callback(gpio, now);
+    }
+    /// @brief Calls callback from the GPIO interrupt whenever pin goes low. The IRQ runs on the calling core.
+    inline void GpioEnableFallingEdgeIRQ(uint8_t pin, EdgeCallback callback)
+    {
+        EdgeCallbackSlot() = callback;
+        gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_FALL, true, &EdgeIRQHandler);
+    }
+
+    //-------- PWM --------
+
+    /// @note The two channels of a slice share its period, so pins on the same slice (e.g. 2 and 3) both get
+    /// @note HAL_PWM_TOP.
+    inline void PwmInit(uint8_t pin)
+    {
+        gpio_set_function(pin, GPIO_FUNC_PWM);
+        uint slice = pwm_gpio_to_slice_num(pin);
+        pwm_set_wrap(slice, HAL_PWM_TOP);
+        pwm_set_clkdiv_int_frac(slice, 1, 0);
+        pwm_set_gpio_level(pin, 0);
+        pwm_set_enabled(slice, true);
+    }
+    inline void PwmSet(uint8_t pin, uint16_t duty)  { pwm_set_gpio_level(pin, duty); }
+
+    //-------- Flash Storage --------
+
+    /// @brief Flash offset of the storage sectors: the last ones of the chip, well clear of the program
+    static const uint32_t FLASH_STORAGE_OFFSET = PICO_FLASH_SIZE_BYTES - HAL_FLASH_STORAGE_SIZE;
+
+    inline const uint8_t *FlashStorage()        { return (const uint8_t *)(XIP_BASE + FLASH_STORAGE_OFFSET); }
+
+    /// @note Flash can't be read while it is written, so core 1 is paused (it must have called
+    /// @note multicore_lockout_victim_init) and interrupts are off for the duration; gate outs stall meanwhile.
+    inline void FlashStorageErase(uint32_t sector)
+    {
+        multicore_lockout_start_blocking();
+        uint32_t interrupts = save_and_disable_interrupts();
+        flash_range_erase(FLASH_STORAGE_OFFSET + sector * HAL_FLASH_SECTOR_SIZE, HAL_FLASH_SECTOR_SIZE);
+        restore_interrupts(interrupts);
+        multicore_lockout_end_blocking();
+    }
+    inline void FlashStorageProgram(uint32_t offset, const uint8_t *page)
+    {
+        multicore_lockout_start_blocking();
+        uint32_t interrupts = save_and_disable_interrupts();
+        flash_range_program(FLASH_STORAGE_OFFSET + offset, page, HAL_FLASH_PAGE_SIZE);
+        restore_interrupts(interrupts);
+        multicore_lockout_end_blocking();
+    }
+
+    //-------- USB MIDI --------
+
+    /// @note TinyUSB itself is serviced by pico_stdio_usb's background task; this only fills the MIDI IN FIFO
+    inline bool MidiWrite(const uint8_t *message, uint32_t length)
+    {
+        if(!tud_midi_mounted()) return false;
+        return tud_midi_stream_write(0, message, length) == length;
+    }
+
+    inline MidiReceiveCallback &MidiReceiveCallbackSlot()
+    {
+        static MidiReceiveCallback callback = nullptr;
+        return callback;
+    }
+    /// @brief Hands every packet waiting on the MIDI OUT endpoint to the receive callback. Runs from tud_midi_rx_cb
+    /// @brief (UsbDevice.cpp), which tud_task calls once it gets round to a transfer that has landed.
+    /// @note tud_task is polled by pico_stdio_usb's background task about once a mS, so the stamp is when the transfer
+    /// @note was picked up, up to a poll interval after it arrived: on top of the wait for the USB frame, a message is
+    /// @note stamped 0 to about 2mS after it was sent.
+    inline void MidiReceiveHandler()
+    {
+        uint64_t now = time_us_64(); //stamp first, as with the gate ins
+        //message bytes in a USB MIDI event packet, by its Code Index Number (USB MIDI 1.0, table 4-1)
+        static const uint8_t CIN_LENGTHS[16] = {0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1};
+        uint8_t packet[4];
+        while(tud_midi_packet_read(packet))
+        {
+            uint32_t length = CIN_LENGTHS[packet[0] & 0x0F];
+            MidiReceiveCallback callback = MidiReceiveCallbackSlot();
+            if(length && callback) callback(packet + 1, length, now);
+        }
+    }
+    /// @note The USB stack runs on core 0, so the callback does too, whichever core set it
+    inline void MidiSetReceiveCallback(MidiReceiveCallback callback) { MidiReceiveCallbackSlot() = callback; }
+
+    //-------- USB Serial --------
+
+    inline uint32_t SerialWriteAvailable()
+    {
+        return stdio_usb_connected() ? tud_cdc_write_available() : 0;
+    }
+    /// @note Goes through pico_stdio_usb's own driver, so it takes turns with printf and the background USB task
+    inline void SerialWrite(const uint8_t *data, uint32_t length)
+    {
+        stdio_usb.out_chars((const char *)data, int(length));
+    }
+
+    //-------- ADC Mux --------
+
+    inline void AdcInit()
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            GpioInitOutput(MUX_ADDR_PINS[i]);
+        }
+        adc_init();
+        adc_gpio_init(GPIO_ADC);
+        adc_select_input(0);
+    }
+    inline void AdcSelect(uint8_t addr)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            gpio_put(MUX_ADDR_PINS[i], (addr & (0b00000001 << i)) > 0);
+        }
+    }
+    inline uint16_t AdcRead()                   { return adc_read(); }
+
+    /// @brief State of the background scan; the DMA interrupt handler can't take arguments
+    struct AdcScanState
+    {
+        int dmaChannel = -1;
+        uint32_t count = 0;
+        AdcDwellCallback callback = nullptr;
+        uint16_t samples[HAL_ADC_SCAN_MAX_SAMPLES];
+    };
+    inline AdcScanState &AdcScanStateSlot()
+    {
+        static AdcScanState state;
+        return state;
+    }
+    inline void AdcScanIRQHandler()
+    {
+        AdcScanState &state = AdcScanStateSlot();
+        dma_channel_acknowledge_irq1(state.dmaChannel);
+        //the ADC keeps converting meanwhile; those samples land in its FIFO and fall in the next dwell's settling time
+        AdcSelect(state.callback(state.samples, state.count));
+        dma_channel_transfer_to_buffer_now(state.dmaChannel, state.samples, state.count);
+    }
+    /// @brief Starts the ADC free-running into DMA, one dwell of samples per mux address. The DMA interrupt (DMA_IRQ_1)
+    /// @brief runs on the calling core and costs one short handler per dwell; nothing ever blocks on a conversion.
+    /// @param addr first mux address
+    /// @param samplesPerDwell samples taken per mux address, settling included (up to HAL_ADC_SCAN_MAX_SAMPLES)
+    /// @param sampleRateHz conversions per second, up to 500kHz
+    /// @param callback handed each dwell, picks the next mux address
+    inline void AdcStartScan(uint8_t addr, uint32_t samplesPerDwell, uint32_t sampleRateHz, AdcDwellCallback callback)
+    {
+        AdcScanState &state = AdcScanStateSlot();
+        state.count = samplesPerDwell < HAL_ADC_SCAN_MAX_SAMPLES ? samplesPerDwell : HAL_ADC_SCAN_MAX_SAMPLES;
+        state.callback = callback;
+        AdcSelect(addr);
+
+        adc_fifo_setup(true, true, 1, false, false); //FIFO on, DREQ at 1 sample, no error bit, full 12 bits
+        adc_set_clkdiv(48'000'000.0f / float(sampleRateHz) - 1.0f); //from the 48MHz ADC clock
+
+        state.dmaChannel = dma_claim_unused_channel(true);
+        dma_channel_config config = dma_channel_get_default_config(state.dmaChannel);
+        channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+        channel_config_set_read_increment(&config, false);
+        channel_config_set_write_increment(&config, true);
+        channel_config_set_dreq(&config, DREQ_ADC);
+        dma_channel_configure(state.dmaChannel, &config, state.samples, &adc_hw->fifo, state.count, true);
+        dma_channel_set_irq1_enabled(state.dmaChannel, true);
+        irq_set_exclusive_handler(DMA_IRQ_1, &AdcScanIRQHandler);
+        irq_set_enabled(DMA_IRQ_1, true);
+
+        adc_run(true);
+    }
+}
@@ -0,0 +1,135 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef HAL_NATIVE
+
+/// @brief USB device: the CDC serial port pico_stdio_usb uses for printf, plus a USB MIDI port for clock in and out.
+/// @note Built with LIB_TINYUSB_DEVICE defined (see platformio.ini), which tells pico_stdio_usb to leave the
+/// @note descriptors to us. Same VID/PID as the SDK's stdio device, so the serial port looks the same as before.
+
+#include "tusb.h"
+#include "pico/unique_id.h"
+#include "HAL.hpp"
+
+#define USB_VID 0x2E8A
+#define USB_PID 0x000A
+#define USB_BCD 0x0200
+
+#define USB_EP_CDC_NOTIFY   0x81
+#define USB_EP_CDC_OUT      0x02
+#define USB_EP_CDC_IN       0x82
+#define USB_EP_MIDI_OUT     0x03
+#define USB_EP_MIDI_IN      0x83
+#define USB_CDC_NOTIFY_SIZE 8
+#define USB_BULK_SIZE       64
+
+enum
+{
+    USB_ITF_CDC = 0,
+    USB_ITF_CDC_DATA,
+    USB_ITF_MIDI,
+    USB_ITF_MIDI_STREAMING,
+    USB_ITF_COUNT
+};
+
+enum
+{
+    USB_STR_LANGUAGE = 0,
+    USB_STR_MANUFACTURER,
+    USB_STR_PRODUCT,
+    USB_STR_SERIAL,
+    USB_STR_CDC,
+    USB_STR_MIDI,
+    USB_STR_COUNT
+};
+
+#define USB_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_MIDI_DESC_LEN)
+
+static const tusb_desc_device_t usbDeviceDescriptor =
+{
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = USB_BCD,
+    //CDC and MIDI share the device, so it is a composite with interface association descriptors
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor           = USB_VID,
+    .idProduct          = USB_PID,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = USB_STR_MANUFACTURER,
+    .iProduct           = USB_STR_PRODUCT,
+    .iSerialNumber      = USB_STR_SERIAL,
+    .bNumConfigurations = 1
+};
+
+static const uint8_t usbConfigDescriptor[] =
+{
+    TUD_CONFIG_DESCRIPTOR(1, USB_ITF_COUNT, 0, USB_CONFIG_TOTAL_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(USB_ITF_CDC, USB_STR_CDC, USB_EP_CDC_NOTIFY, USB_CDC_NOTIFY_SIZE, USB_EP_CDC_OUT, USB_EP_CDC_IN, USB_BULK_SIZE),
+    TUD_MIDI_DESCRIPTOR(USB_ITF_MIDI, USB_STR_MIDI, USB_EP_MIDI_OUT, USB_EP_MIDI_IN, USB_BULK_SIZE),
+};
+
+static const char *const usbStrings[USB_STR_COUNT] =
+{
+    nullptr,            //language, sent as a code below
+    "PlutonModular",
+    "KO Clock",
+    nullptr,            //serial, the flash chip's unique ID
+    "KO Clock Serial",
+    "KO Clock MIDI",
+};
+
+extern "C" const uint8_t *tud_descriptor_device_cb(void)
+{
+    return (const uint8_t *)&usbDeviceDescriptor;
+}
+
+extern "C" const uint8_t *tud_descriptor_configuration_cb(uint8_t index)
+{
+    (void)index;
+    return usbConfigDescriptor;
+}
+
+extern "C" const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+    (void)langid;
+    //UTF-16, first element is the length and type
+    static uint16_t descriptor[1 + 32];
+    static char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    uint32_t length;
+    if(index == USB_STR_LANGUAGE)
+    {
+        descriptor[1] = 0x0409; //English
+        length = 1;
+    }
+    else
+    {
+        if(index >= USB_STR_COUNT) return nullptr;
+        const char *text = usbStrings[index];
+        if(index == USB_STR_SERIAL)
+        {
+            if(!serial[0]) pico_get_unique_board_id_string(serial, sizeof(serial));
+            text = serial;
+        }
+        for(length = 0; length < 32 && text[length]; length++) descriptor[1 + length] = uint8_t(text[length]);
+    }
+    descriptor[0] = uint16_t((TUSB_DESC_STRING << 8) | (2 * length + 2));
+    return descriptor;
+}
+
+//-------- MIDI Receive --------
+
+//TinyUSB calls this from tud_task (pico_stdio_usb's background task, every mS) once it picks up a MIDI transfer that
+//has landed; that's when the messages are stamped, not when the transfer arrived
+extern "C" void tud_midi_rx_cb(uint8_t itf)
+{
+    (void)itf;
+    HAL::MidiReceiveHandler();
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "AdcScanner.hpp"
+
+void AdcScanner::SetChannelRate(uint8_t channel, uint8_t visitsPerRound)
+{
+    if(channel < ADC_SCAN_CHANNELS) rates[channel] = visitsPerRound;
+}
+
+void AdcScanner::BuildSchedule()
+{
+    //smooth weighted round robin: every slot, each channel gains its rate in credit and the richest one pays a round
+    int32_t credit[ADC_SCAN_CHANNELS] = {};
+    int32_t total = 0;
+    for(int i = 0; i < ADC_SCAN_CHANNELS; i++) total += rates[i];
+
+    numSlots = 0;
+    while(numSlots < total && numSlots < ADC_SCAN_MAX_SLOTS)
+    {
+        int best = -1;
+        for(int i = 0; i < ADC_SCAN_CHANNELS; i++)
+        {
+            if(rates[i] == 0) continue;
+            credit[i] += rates[i];
+            if(best < 0 || credit[i] > credit[best]) best = i;
+        }
+        credit[best] -= total;
+        schedule[numSlots++] = uint8_t(best);
+    }
+    slot = 0;
+}
+
+uint8_t AdcScanner::OnDwellDone(const uint16_t *samples, uint32_t count)
+{
+    if(numSlots == 0) return 0;
+    uint8_t channel = schedule[slot];
+
+    //average the settled part of the dwell
+    if(count > ADC_SCAN_SETTLE_SAMPLES)
+    {
+        uint32_t sum = 0;
+        for(uint32_t i = ADC_SCAN_SETTLE_SAMPLES; i < count; i++) sum += samples[i];
+        uint16_t average = uint16_t(sum / (count - ADC_SCAN_SETTLE_SAMPLES));
+
+        uint32_t updates = updateCounts[channel].load(std::memory_order_relaxed);
+        if(updates == 0)
+        {
+            //first visit: fill the whole ring, so the value doesn't ramp up from zero
+            for(int i = 0; i < ADC_SCAN_RING_SIZE; i++) rings[channel][i] = average;
+            ringSum[channel] = uint32_t(average) * ADC_SCAN_RING_SIZE;
+        }
+        else
+        {
+            uint8_t index = ringIndex[channel];
+            ringSum[channel] += average - rings[channel][index];
+            rings[channel][index] = average;
+            ringIndex[channel] = (index + 1) & (ADC_SCAN_RING_SIZE - 1);
+        }
+        values[channel].store(average, std::memory_order_relaxed);
+        averages[channel].store(uint16_t(ringSum[channel] / ADC_SCAN_RING_SIZE), std::memory_order_relaxed);
+        updateCounts[channel].store(updates + 1, std::memory_order_relaxed);
+    }
+
+    slot++;
+    if(slot >= numSlots) slot = 0;
+    return schedule[slot];
+}
@@ -0,0 +1,83 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/// Mux addresses the scanner can visit
+#define ADC_SCAN_CHANNELS 8
+/// Longest scan schedule, in dwells
+#define ADC_SCAN_MAX_SLOTS 32
+/// Conversions per second while scanning
+#define ADC_SCAN_SAMPLE_RATE 100'000
+/// Samples thrown away after each mux step while the mux and ADC input settle (50uS)
+#define ADC_SCAN_SETTLE_SAMPLES 5
+/// Samples kept and averaged per dwell
+#define ADC_SCAN_KEEP_SAMPLES 5
+#define ADC_SCAN_DWELL_SAMPLES (ADC_SCAN_SETTLE_SAMPLES + ADC_SCAN_KEEP_SAMPLES)
+/// Dwell averages kept per channel for GetAverage. Must be a power of two.
+#define ADC_SCAN_RING_SIZE 4
+
+/// @brief Scan schedule and per-channel sample rings for the background ADC mux scan (see HAL::AdcStartScan).
+/// @note Each dwell on a mux address throws away its settling samples and averages the rest into that channel's latest
+/// @note value and its ring of recent values. Channels can be visited at different rates: the schedule interleaves them
+/// @note evenly (smooth weighted round robin), so a channel with rate 2 is visited twice as often as one with rate 1,
+/// @note at even spacing. OnDwellDone runs in the DMA interrupt; GetValue is safe from anywhere.
+class AdcScanner
+{
+    private:
+        /// @brief Visits per schedule round for each channel; 0 = not scanned
+        uint8_t rates[ADC_SCAN_CHANNELS] = {};
+        /// @brief Channel of each dwell in a round
+        uint8_t schedule[ADC_SCAN_MAX_SLOTS] = {};
+        uint8_t numSlots = 0;
+        /// @brief Slot being sampled right now
+        uint8_t slot = 0;
+
+        uint16_t rings[ADC_SCAN_CHANNELS][ADC_SCAN_RING_SIZE];
+        uint8_t ringIndex[ADC_SCAN_CHANNELS] = {};
+        uint32_t ringSum[ADC_SCAN_CHANNELS] = {};
+
+        /// @brief Latest dwell average of each channel, 0-4095
+        std::atomic<uint16_t> values[ADC_SCAN_CHANNELS] = {};
+        /// @brief Mean of each channel's ring, 0-4095
+        std::atomic<uint16_t> averages[ADC_SCAN_CHANNELS] = {};
+        /// @brief Dwells completed on each channel; only written by OnDwellDone
+        std::atomic<uint32_t> updateCounts[ADC_SCAN_CHANNELS] = {};
+
+    public:
+        /// @brief Sets how often a channel is visited. Takes effect at the next BuildSchedule.
+        /// @param channel mux address
+        /// @param visitsPerRound visits per schedule round, 0 to leave the channel out
+        void SetChannelRate(uint8_t channel, uint8_t visitsPerRound);
+
+        /// @brief Lays out the schedule from the channel rates, spreading each channel's visits evenly
+        /// @note Rates adding up to more than ADC_SCAN_MAX_SLOTS are cut off at the end of the round
+        void BuildSchedule();
+
+        /// @brief Restarts the schedule
+        /// @return mux address to dwell on first
+        uint8_t Start() { slot = 0; return numSlots > 0 ? schedule[0] : 0; }
+
+        /// @brief Files a finished dwell under the channel being sampled and steps the schedule. Interrupt context.
+        /// @param samples raw conversions of the dwell, oldest first
+        /// @param count number of samples; the first ADC_SCAN_SETTLE_SAMPLES are discarded
+        /// @return mux address to dwell on next
+        uint8_t OnDwellDone(const uint16_t *samples, uint32_t count);
+
+        /// @brief Latest value of a channel (the settled samples of its last dwell, averaged), 0-4095
+        uint16_t GetValue(uint8_t channel) const { return values[channel].load(std::memory_order_relaxed); }
+        /// @brief Mean of a channel's last ADC_SCAN_RING_SIZE values: quieter, but slower to follow, 0-4095
+        uint16_t GetAverage(uint8_t channel) const { return averages[channel].load(std::memory_order_relaxed); }
+        /// @brief Dwells completed on a channel so far
+        uint32_t GetUpdateCount(uint8_t channel) const { return updateCounts[channel].load(std::memory_order_relaxed); }
+        /// @brief Dwells per schedule round
+        uint8_t GetNumSlots() const { return numSlots; }
+        /// @brief Channel visited in a slot of the schedule
+        uint8_t GetSlotChannel(uint8_t slotIndex) const { return schedule[slotIndex]; }
+};
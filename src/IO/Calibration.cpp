@@ -0,0 +1,145 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "Calibration.hpp"
+#include "HAL/HAL.hpp"
+#include "Util/CRC32.hpp"
+
+#define CAL_SLOTS_PER_SECTOR (HAL_FLASH_SECTOR_SIZE / CAL_RECORD_SIZE)
+#define CAL_NUM_SLOTS (HAL_FLASH_STORAGE_SIZE / CAL_RECORD_SIZE)
+
+//INPUT     0V      5V      -4.5V   -5V (projected)
+//scrub     2305    350     4095    4550
+//tmult     2300    330     4095    4550
+//UD        2300    340     4095    4550
+//swing     36      3010
+void Calibration::SetDefaults()
+{
+    points[CAL_CV_UD]       = {2300, 340};
+    points[CAL_CV_SCRUB]    = {2300, 340};
+    points[CAL_CV_TIMEMULT] = {2300, 340};
+    points[CAL_CV_SWING]    = {36, 3010};
+    for(int i = 0; i < CAL_NUM_CHANNELS; i++) UpdateTransform(i);
+    sequence = 0;
+}
+
+void Calibration::UpdateTransform(uint8_t channel)
+{
+    int32_t fullScale = channel == CAL_CV_SWING ? CAL_SWING_FULL_SCALE : CAL_BIPOLAR_FULL_SCALE;
+    int32_t span = int32_t(points[channel].five) - int32_t(points[channel].zero);
+    transforms[channel].zero = points[channel].zero;
+    //rounded to nearest; the span is at least CAL_MIN_SPAN, so |scale| stays under 2^19 and 4095 * scale fits an int32
+    transforms[channel].scale = ((fullScale << 16) + (span > 0 ? span / 2 : -span / 2)) / span;
+}
+
+bool Calibration::SetPoints(uint8_t channel, CalibrationPoints newPoints)
+{
+    if(channel >= CAL_NUM_CHANNELS) return false;
+    if(abs(int32_t(newPoints.five) - int32_t(newPoints.zero)) < CAL_MIN_SPAN) return false;
+    points[channel] = newPoints;
+    UpdateTransform(channel);
+    return true;
+}
+
+bool Calibration::IsValid(const CalibrationRecord &record)
+{
+    if(record.magic != CAL_RECORD_MAGIC || record.version != CAL_RECORD_VERSION) return false;
+    return record.crc == CRC32((const uint8_t *)&record, offsetof(CalibrationRecord, crc));
+}
+
+int Calibration::FindNewestSlot()
+{
+    const uint8_t *storage = HAL::FlashStorage();
+    int newest = -1;
+    uint32_t newestSequence = 0;
+    for(int slot = 0; slot < CAL_NUM_SLOTS; slot++)
+    {
+        CalibrationRecord record;
+        memcpy(&record, storage + slot * CAL_RECORD_SIZE, CAL_RECORD_SIZE);
+        if(!IsValid(record)) continue;
+        if(newest < 0 || int32_t(record.sequence - newestSequence) > 0)
+        {
+            newest = slot;
+            newestSequence = record.sequence;
+        }
+    }
+    return newest;
+}
+
+bool Calibration::IsErased(int firstSlot, int numSlots)
+{
+    const uint8_t *bytes = HAL::FlashStorage() + firstSlot * CAL_RECORD_SIZE;
+    for(int i = 0; i < numSlots * CAL_RECORD_SIZE; i++) if(bytes[i] != 0xFF) return false;
+    return true;
+}
+
+bool Calibration::Load()
+{
+    SetDefaults();
+    int newest = FindNewestSlot();
+    if(newest < 0) return false;
+
+    CalibrationRecord record;
+    memcpy(&record, HAL::FlashStorage() + newest * CAL_RECORD_SIZE, CAL_RECORD_SIZE);
+    for(int i = 0; i < CAL_NUM_CHANNELS; i++)
+    {
+        //a record from a bad calibration would still have a valid CRC; keep the default for that channel
+        SetPoints(i, record.points[i]);
+    }
+    sequence = record.sequence;
+    return true;
+}
+
+bool Calibration::Save()
+{
+    CalibrationRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = CAL_RECORD_MAGIC;
+    record.sequence = sequence + 1;
+    record.version = CAL_RECORD_VERSION;
+    for(int i = 0; i < CAL_NUM_CHANNELS; i++) record.points[i] = points[i];
+    record.crc = CRC32((const uint8_t *)&record, offsetof(CalibrationRecord, crc));
+
+    //next free slot in the sector holding the newest record: records are only ever appended, so it's the first one
+    //still erased. A full sector moves on to the other one, which is erased first if anything is left in it
+    const uint8_t *storage = HAL::FlashStorage();
+    int newest = FindNewestSlot();
+    int sector = newest < 0 ? 0 : newest / CAL_SLOTS_PER_SECTOR;
+    int freeSlot = -1;
+    for(int slot = sector * CAL_SLOTS_PER_SECTOR; slot < (sector + 1) * CAL_SLOTS_PER_SECTOR && freeSlot < 0; slot++)
+    {
+        if(IsErased(slot, 1)) freeSlot = slot;
+    }
+    int fullSector = -1;
+    if(freeSlot < 0)
+    {
+        fullSector = sector;
+        sector = (sector + 1) % HAL_FLASH_STORAGE_SECTORS;
+        if(!IsErased(sector * CAL_SLOTS_PER_SECTOR, CAL_SLOTS_PER_SECTOR)) HAL::FlashStorageErase(sector);
+        freeSlot = sector * CAL_SLOTS_PER_SECTOR;
+    }
+
+    //program the page around the slot; the rest of the page is written with what's already there
+    uint32_t slotOffset = freeSlot * CAL_RECORD_SIZE;
+    uint32_t pageOffset = slotOffset & ~uint32_t(HAL_FLASH_PAGE_SIZE - 1);
+    uint8_t page[HAL_FLASH_PAGE_SIZE];
+    memcpy(page, storage + pageOffset, HAL_FLASH_PAGE_SIZE);
+    memcpy(page + (slotOffset - pageOffset), &record, CAL_RECORD_SIZE);
+    HAL::FlashStorageProgram(pageOffset, page);
+
+    CalibrationRecord readBack;
+    memcpy(&readBack, storage + slotOffset, CAL_RECORD_SIZE);
+    if(!IsValid(readBack)) return false;
+    sequence = record.sequence;
+
+    //only now that the new record is safely in is the last copy of the old one let go
+    if(fullSector >= 0) HAL::FlashStorageErase(fullSector);
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Calibrated CV ins: UD, scrub, time mult, swing
+#define CAL_NUM_CHANNELS 4
+#define CAL_CV_UD 0
+#define CAL_CV_SCRUB 1
+#define CAL_CV_TIMEMULT 2
+#define CAL_CV_SWING 3
+
+/// Calibrated value of +5V on a bipolar CV in (-5V = -2048, 0V = 0, 5V = 2048)
+#define CAL_BIPOLAR_FULL_SCALE 2048
+/// Calibrated value of +5V on the swing CV in; the range the old fixed offset of 36 gave on the reference unit
+#define CAL_SWING_FULL_SCALE 2974
+/// Smallest difference between the 0V and 5V readings accepted as a real calibration
+#define CAL_MIN_SPAN 512
+
+/// Identifies a calibration record in flash ("KOCL")
+#define CAL_RECORD_MAGIC 0x4C434F4B
+#define CAL_RECORD_VERSION 1
+/// Bytes per record slot; each storage sector holds HAL_FLASH_SECTOR_SIZE / CAL_RECORD_SIZE of them
+#define CAL_RECORD_SIZE 32
+
+/// @brief Raw readings of one CV in at the two calibration voltages
+struct CalibrationPoints
+{
+    uint16_t zero;
+    uint16_t five;
+};
+
+/// @brief One calibration, as stored in flash
+struct CalibrationRecord
+{
+    uint32_t magic;
+    /// @brief Increases with every save; the valid record with the highest sequence is the current one
+    uint32_t sequence;
+    uint16_t version;
+    uint16_t reserved;
+    CalibrationPoints points[CAL_NUM_CHANNELS];
+    /// @brief CRC32 of everything above
+    uint32_t crc;
+};
+static_assert(sizeof(CalibrationRecord) == CAL_RECORD_SIZE, "CalibrationRecord must fill its slot exactly");
+
+/// @brief Raw ADC to calibrated value, as a subtract and a multiply-shift
+struct CalibrationTransform
+{
+    int32_t zero;
+    /// @brief Calibrated units per raw LSB, Q16 (negative on the inverting bipolar ins)
+    int32_t scale;
+
+    /// @brief Maps a raw reading, rounding to nearest. No division, so it costs the same on the M0+ as anywhere.
+    int16_t Apply(uint16_t raw) const
+    {
+        return int16_t(((int32_t(raw) - zero) * scale + 32768) >> 16);
+    }
+};
+
+/// @brief Per-unit CV calibration: defaults, the flash record, and the precomputed transforms.
+/// @note Records are appended slot by slot to one of the flash storage sectors, so a sector is only erased once
+/// @note every HAL_FLASH_SECTOR_SIZE / CAL_RECORD_SIZE saves. When the sector in use is full, the next record goes
+/// @note to the start of the other one, and the full one is only erased once that record has read back intact: there
+/// @note is always a valid record in flash, whenever the power goes. Loading picks the newest record with a valid CRC
+/// @note from either sector, so a save interrupted by a power cut falls back to the previous calibration.
+class Calibration
+{
+    private:
+        CalibrationPoints points[CAL_NUM_CHANNELS];
+        CalibrationTransform transforms[CAL_NUM_CHANNELS];
+        /// @brief Sequence of the record loaded or saved last, 0 for none
+        uint32_t sequence = 0;
+
+        /// @brief Recomputes a channel's transform from its points (the only division, done once)
+        void UpdateTransform(uint8_t channel);
+        /// @brief True if the record is complete, intact and of this version
+        static bool IsValid(const CalibrationRecord &record);
+        /// @brief Slot of the valid record with the highest sequence, over every storage sector; -1 if there is none
+        static int FindNewestSlot();
+        /// @brief True if every byte of a run of slots is still erased
+        static bool IsErased(int firstSlot, int numSlots);
+
+    public:
+        /// @brief Sets the hand-measured values of the reference unit
+        void SetDefaults();
+
+        /// @brief Loads the newest valid record from flash
+        /// @return false if there was none; the defaults are used then
+        bool Load();
+
+        /// @brief Appends the current points to flash as a new record, moving to the other sector if this one is full
+        /// @return false if the record didn't read back intact
+        bool Save();
+
+        /// @brief Sets a channel's calibration points
+        /// @return false (and changes nothing) if the points are too close together to be a real calibration
+        bool SetPoints(uint8_t channel, CalibrationPoints newPoints);
+
+        CalibrationPoints GetPoints(uint8_t channel) const { return points[channel]; }
+        const CalibrationTransform &GetTransform(uint8_t channel) const { return transforms[channel]; }
+        /// @brief Sequence of the current record, 0 if running on defaults
+        uint32_t GetSequence() const { return sequence; }
+
+        /// @brief Raw ADC reading of a CV in to calibrated units
+        int16_t Apply(uint8_t channel, uint16_t raw) const { return transforms[channel].Apply(raw); }
+};
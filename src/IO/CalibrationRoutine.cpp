@@ -0,0 +1,89 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "CalibrationRoutine.hpp"
+
+void CalibrationRoutine::Start(IOHelper &io)
+{
+    io.ProcessPlayFlag(); //the press held at power on doesn't count
+    step = Step::WaitZero;
+    SetLEDs(io, LEDState::BLINK_FAST, LEDState::SOLID_OFF, LEDState::SOLID_OFF);
+}
+
+void CalibrationRoutine::SetLEDs(IOHelper &io, LEDState reset, LEDState clock, LEDState play)
+{
+    io.SetLEDState(PanelLED::Reset, reset);
+    io.SetLEDState(PanelLED::Clock, clock);
+    io.SetLEDState(PanelLED::PlayButton, play);
+}
+
+bool CalibrationRoutine::Capture(const IOHelper &io)
+{
+    captureSums[CAL_CV_UD]       += io.CV_UD_Raw;
+    captureSums[CAL_CV_SCRUB]    += io.CV_scrub_Raw;
+    captureSums[CAL_CV_TIMEMULT] += io.CV_timeMult_Raw;
+    captureSums[CAL_CV_SWING]    += io.CV_swing_Raw;
+    return ++capturedFrames >= CAL_CAPTURE_FRAMES;
+}
+
+bool CalibrationRoutine::Finish(IOHelper &io)
+{
+    //check every channel first, so a bad one leaves the calibration in use untouched
+    Calibration candidate = io.calibration;
+    for(int i = 0; i < CAL_NUM_CHANNELS; i++)
+    {
+        CalibrationPoints points = {zeroReadings[i], uint16_t(captureSums[i] / CAL_CAPTURE_FRAMES)};
+        if(!candidate.SetPoints(i, points)) return false;
+    }
+    if(!candidate.Save()) return false;
+    io.calibration = candidate;
+    return true;
+}
+
+void CalibrationRoutine::Update(IOHelper &io, long dt)
+{
+    switch(step)
+    {
+        case Step::WaitZero:
+        case Step::WaitFive:
+            if(io.ProcessPlayFlag())
+            {
+                for(int i = 0; i < CAL_NUM_CHANNELS; i++) captureSums[i] = 0;
+                capturedFrames = 0;
+                bool isZero = step == Step::WaitZero;
+                step = isZero ? Step::CaptureZero : Step::CaptureFive;
+                SetLEDs(io, isZero ? LEDState::SOLID_ON : LEDState::SOLID_OFF, isZero ? LEDState::SOLID_OFF : LEDState::SOLID_ON, LEDState::SOLID_OFF);
+            }
+            break;
+        case Step::CaptureZero:
+            if(Capture(io))
+            {
+                for(int i = 0; i < CAL_NUM_CHANNELS; i++) zeroReadings[i] = uint16_t(captureSums[i] / CAL_CAPTURE_FRAMES);
+                step = Step::WaitFive;
+                SetLEDs(io, LEDState::SOLID_OFF, LEDState::BLINK_FAST, LEDState::SOLID_OFF);
+            }
+            break;
+        case Step::CaptureFive:
+            if(Capture(io))
+            {
+                if(Finish(io)) SetLEDs(io, LEDState::SOLID_OFF, LEDState::SOLID_OFF, LEDState::FADE_FAST);
+                else           SetLEDs(io, LEDState::BLINK_FAST, LEDState::BLINK_FAST, LEDState::BLINK_FAST);
+                step = Step::Result;
+                resultMicros = CAL_RESULT_MICROS;
+            }
+            break;
+        case Step::Result:
+            resultMicros -= dt;
+            if(resultMicros <= 0)
+            {
+                SetLEDs(io, LEDState::SOLID_OFF, LEDState::SOLID_OFF, LEDState::SOLID_OFF);
+                step = Step::Done;
+            }
+            break;
+        case Step::Done:
+            break;
+    }
+}
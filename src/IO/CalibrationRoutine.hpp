@@ -0,0 +1,64 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "IOHelper.hpp"
+
+/// CV rate frames averaged for each calibration point
+#define CAL_CAPTURE_FRAMES 256
+/// How long the result is shown before the routine ends, in microseconds
+#define CAL_RESULT_MICROS 2'000'000
+
+/// @brief Guided CV in calibration, run from the CV rate loop when PLAY is held at power on.
+/// @note 1. Reset LED blinks: patch 0V into all four CV ins, press PLAY.
+/// @note 2. Clock LED blinks: patch +5V into all four CV ins, press PLAY.
+/// @note The LED goes solid while each point is averaged. The result is saved to flash and the play LED fades; if a
+/// @note channel's readings were unusable (nothing patched, or the save failed) all LEDs blink fast instead and the
+/// @note previous calibration stays in use.
+class CalibrationRoutine
+{
+    private:
+        enum class Step
+        {
+            WaitZero,
+            CaptureZero,
+            WaitFive,
+            CaptureFive,
+            Result,
+            Done,
+        };
+        Step step = Step::Done;
+
+        /// @brief Sum of the raw readings over the current capture, per channel
+        int32_t captureSums[CAL_NUM_CHANNELS];
+        uint32_t capturedFrames = 0;
+        /// @brief Averaged 0V readings
+        uint16_t zeroReadings[CAL_NUM_CHANNELS];
+        /// @brief Time left showing the result
+        int32_t resultMicros = 0;
+
+        /// @brief Adds this frame's readings to the capture
+        /// @return true once CAL_CAPTURE_FRAMES have been summed
+        bool Capture(const IOHelper &io);
+        /// @brief Stores the captured points and saves them
+        /// @return false if any channel was rejected or the save failed
+        bool Finish(IOHelper &io);
+        void SetLEDs(IOHelper &io, LEDState reset, LEDState clock, LEDState play);
+
+    public:
+        /// @brief Starts the routine
+        void Start(IOHelper &io);
+
+        /// @brief Advances the routine. Call once per CV rate frame, after io.ReadSlowInputs and instead of the
+        /// @brief normal CV rate updates.
+        /// @param dt microseconds since the last call
+        void Update(IOHelper &io, long dt);
+
+        /// @brief True from Start until the result has been shown
+        bool IsRunning() const { return step != Step::Done; }
+};
@@ -0,0 +1,129 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#if defined(GATE_OUT_PIO) && !defined(HAL_NATIVE)
+
+#include "GateSequencer.hpp"
+#include "IOHelper.hpp"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+
+//-------- PIO Program (see GateSequencer.pio) --------
+
+static const uint16_t gateSequencerInstructions[] =
+{
+            //     .wrap_target
+    0x6006, //  0: out    pins, 6
+    0x603a, //  1: out    x, 26
+    0x0042, //  2: jmp    x--, 2
+            //     .wrap
+};
+
+static const struct pio_program gateSequencerProgram =
+{
+    gateSequencerInstructions,
+    3,
+    -1,
+};
+
+//-------- State --------
+
+namespace
+{
+    PIO pio = pio0;
+    uint sm = 0;
+    int dmaChannels[2];
+    uint32_t blocks[2][GATE_SEQ_BLOCK_WORDS];
+    GateEdge edges[GATE_SEQ_MAX_EDGES];
+    GateTimeline timeline;
+    GateEdgeSource edgeSource = nullptr;
+    uint64_t epochMicros = 0;
+    uint32_t cyclesPerMicro = 0;
+    uint32_t blockCycles = 0;
+
+    /// @brief Encodes the next block of the stream into a buffer
+    /// @return number of words written
+    uint32_t FillBlock(uint32_t *words)
+    {
+        uint64_t blockStart = timeline.GetEncodedCycle();
+        uint64_t blockEnd = blockStart + blockCycles;
+        uint32_t numEdges = edgeSource(edges, GATE_SEQ_MAX_EDGES, blockStart, blockEnd);
+        uint32_t edgesUsed;
+        return timeline.FillBlock(words, GATE_SEQ_BLOCK_WORDS, edges, numEdges, blockEnd, &edgesUsed);
+    }
+
+    /// @brief A block finished playing (the other one has already been started by the chain): refill and re-arm it
+    void __not_in_flash_func(OnBlockDone)()
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            if(!dma_channel_get_irq0_status(dmaChannels[i])) continue;
+            dma_channel_acknowledge_irq0(dmaChannels[i]);
+            uint32_t count = FillBlock(blocks[i]);
+            dma_channel_set_read_addr(dmaChannels[i], blocks[i], false);
+            dma_channel_set_trans_count(dmaChannels[i], count, false);
+        }
+    }
+}
+
+//-------- Interface --------
+
+void GateSequencer::Init(uint8_t pinBase, GateEdgeSource source)
+{
+    edgeSource = source;
+    cyclesPerMicro = clock_get_hz(clk_sys) / 1'000'000;
+    blockCycles = GATE_SEQ_BLOCK_US * cyclesPerMicro;
+
+    //--------Set up the state machine--------
+
+    sm = pio_claim_unused_sm(pio, true);
+    uint offset = pio_add_program(pio, &gateSequencerProgram);
+    for(int i = 0; i < NUM_GATE_OUTS; i++)
+    {
+        pio_gpio_init(pio, pinBase + i);
+    }
+    pio_sm_set_consistent_pindirs(pio, sm, pinBase, NUM_GATE_OUTS, true);
+    pio_sm_config config = pio_get_default_sm_config();
+    sm_config_set_wrap(&config, offset + 0, offset + 2);
+    sm_config_set_out_pins(&config, pinBase, NUM_GATE_OUTS);
+    sm_config_set_out_shift(&config, true, true, 32); //shift right, autopull every 32 bits
+    sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+    pio_sm_init(pio, sm, offset, &config);
+
+    //--------Set up the DMA ping-pong--------
+
+    dmaChannels[0] = dma_claim_unused_channel(true);
+    dmaChannels[1] = dma_claim_unused_channel(true);
+    timeline.Reset(0, 0);
+    for(int i = 0; i < 2; i++)
+    {
+        dma_channel_config dmaConfig = dma_channel_get_default_config(dmaChannels[i]);
+        channel_config_set_transfer_data_size(&dmaConfig, DMA_SIZE_32);
+        channel_config_set_read_increment(&dmaConfig, true);
+        channel_config_set_write_increment(&dmaConfig, false);
+        channel_config_set_dreq(&dmaConfig, pio_get_dreq(pio, sm, true));
+        channel_config_set_chain_to(&dmaConfig, dmaChannels[1 - i]);
+        uint32_t count = FillBlock(blocks[i]);
+        dma_channel_configure(dmaChannels[i], &dmaConfig, &pio->txf[sm], blocks[i], count, false);
+        dma_channel_set_irq0_enabled(dmaChannels[i], true);
+    }
+    irq_set_exclusive_handler(DMA_IRQ_0, OnBlockDone);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    //--------Go--------
+
+    //cycle 0 is now; both blocks were filled for an all-off start, so the first real edges arrive with block 2
+    epochMicros = time_us_64();
+    pio_sm_set_enabled(pio, sm, true);
+    dma_channel_start(dmaChannels[0]);
+}
+
+uint64_t GateSequencer::GetEpochMicros()    { return epochMicros; }
+uint32_t GateSequencer::GetCyclesPerMicro() { return cyclesPerMicro; }
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "GateTimeline.hpp"
+
+/// Length of one timeline block. Edges have to be known this far ahead of the block being played.
+#define GATE_SEQ_BLOCK_US 500
+/// Words per timeline block; the block is closed early (dropping edges) if they run out
+#define GATE_SEQ_BLOCK_WORDS 64
+/// Most edges predicted per block
+#define GATE_SEQ_MAX_EDGES 32
+
+/// @brief Fills a list of upcoming gate edges, in time order
+/// @param edges buffer for the edges
+/// @param maxEdges size of the buffer
+/// @param fromCycle first sequencer cycle of interest; edges before it have already been played
+/// @param toCycle end of the window of interest
+/// @return number of edges written
+typedef uint32_t (*GateEdgeSource)(GateEdge *edges, uint32_t maxEdges, uint64_t fromCycle, uint64_t toCycle);
+
+/// @brief Cycle-accurate gate outs: a PIO state machine plays a precomputed timeline of pin masks, fed by two
+/// @brief chained DMA channels from a double-buffered ring.
+/// @note While one block plays, the other is refilled from the DMA completion interrupt with edges from the edge
+/// @note source, so edges leave the chip on their exact cycle with no CPU work per edge. Only built with GATE_OUT_PIO.
+namespace GateSequencer
+{
+    /// @brief Claims a state machine and two DMA channels and starts playing
+    /// @param pinBase first of the six consecutive gate out pins
+    /// @param source called from the DMA interrupt to predict the edges of each block
+    void Init(uint8_t pinBase, GateEdgeSource source);
+
+    /// @brief HAL::TimeMicros() of sequencer cycle 0
+    uint64_t GetEpochMicros();
+
+    /// @brief Sequencer cycles per microsecond (the system clock in MHz)
+    uint32_t GetCyclesPerMicro();
+}
@@ -0,0 +1,52 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "GateTimeline.hpp"
+
+bool GateTimeline::EmitHold(uint32_t *words, uint32_t maxWords, uint32_t &count, uint64_t untilCycle)
+{
+    uint64_t remaining = untilCycle - encodedCycle;
+    while(remaining > 0)
+    {
+        if(count >= maxWords) return false;
+        uint32_t cycles = remaining > GATE_TIMELINE_MAX_CYCLES ? GATE_TIMELINE_MAX_CYCLES : uint32_t(remaining);
+        //never leave a tail too short to encode; split the last two words evenly instead
+        if(remaining > GATE_TIMELINE_MAX_CYCLES && remaining - cycles < GATE_TIMELINE_MIN_CYCLES) cycles = uint32_t(remaining / 2);
+        words[count++] = EncodeWord(pendingMask, cycles);
+        encodedCycle += cycles;
+        remaining -= cycles;
+    }
+    return true;
+}
+
+uint32_t GateTimeline::FillBlock(uint32_t *words, uint32_t maxWords, const GateEdge *edges, uint32_t numEdges, uint64_t blockEndCycle, uint32_t *edgesUsed)
+{
+    uint32_t count = 0;
+    uint32_t used = 0;
+
+    //one word is always kept back so the block can be closed on time
+    for(; used < numEdges; used++)
+    {
+        const GateEdge &edge = edges[used];
+        //edges too close to the end of the block (or past it) go in the next one
+        if(edge.cycle + GATE_TIMELINE_MIN_CYCLES > blockEndCycle) break;
+        //edges in the past, or too close to the previous one to encode, just replace the pending mask
+        if(edge.cycle < encodedCycle + GATE_TIMELINE_MIN_CYCLES)
+        {
+            pendingMask = edge.mask;
+            continue;
+        }
+        uint32_t wordsNeeded = uint32_t((edge.cycle - encodedCycle) / GATE_TIMELINE_MAX_CYCLES) + 1;
+        if(count + wordsNeeded + 1 > maxWords) break;
+        EmitHold(words, maxWords, count, edge.cycle);
+        pendingMask = edge.mask;
+    }
+
+    //hold the last mask until the end of the block
+    EmitHold(words, maxWords, count, blockEndCycle);
+    *edgesUsed = used;
+    return count;
+}
@@ -0,0 +1,75 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Cycles the gate sequencer PIO program spends per timeline word on top of its delay count
+#define GATE_TIMELINE_OVERHEAD 3
+/// Bits of the timeline word holding the delay count
+#define GATE_TIMELINE_DELAY_BITS 26
+/// Shortest time a timeline word can hold its pin mask
+#define GATE_TIMELINE_MIN_CYCLES GATE_TIMELINE_OVERHEAD
+/// Longest time a single timeline word can hold its pin mask; longer holds are split
+#define GATE_TIMELINE_MAX_CYCLES (((1UL << GATE_TIMELINE_DELAY_BITS) - 1) + GATE_TIMELINE_OVERHEAD)
+
+/// @brief A change of the gate out pins at an exact time
+struct GateEdge
+{
+    /// @brief Sequencer cycle the new mask takes effect on
+    uint64_t cycle;
+    /// @brief Gate out states after the edge, bit 0 = gate out 0
+    uint8_t mask;
+};
+
+/// @brief Encodes gate edges into the word stream played by the gate sequencer PIO program (GateSequencer.pio).
+/// @note Each word is (delay << 6) | mask: the program drives the six gate pins with the mask, then holds them for
+/// @note delay + GATE_TIMELINE_OVERHEAD cycles. The stream is cut into blocks of a fixed length in cycles, so the
+/// @note position of every word in time stays known and the DMA ring can be refilled one block at a time.
+class GateTimeline
+{
+    private:
+        /// @brief Cycle everything before which has been encoded
+        uint64_t encodedCycle = 0;
+        /// @brief Mask in effect from encodedCycle on
+        uint8_t pendingMask = 0;
+
+        /// @brief Holds pendingMask from encodedCycle to untilCycle
+        /// @return false if the words didn't fit
+        bool EmitHold(uint32_t *words, uint32_t maxWords, uint32_t &count, uint64_t untilCycle);
+
+    public:
+        /// @brief Builds a timeline word
+        /// @param mask gate out states
+        /// @param cycles hold time, GATE_TIMELINE_MIN_CYCLES to GATE_TIMELINE_MAX_CYCLES
+        static uint32_t EncodeWord(uint8_t mask, uint32_t cycles)
+        {
+            return (mask & 0x3F) | ((cycles - GATE_TIMELINE_OVERHEAD) << 6);
+        }
+
+        /// @brief Restarts the stream
+        /// @param startCycle cycle the next block starts on
+        /// @param mask gate out states at startCycle
+        void Reset(uint64_t startCycle, uint8_t mask)
+        {
+            encodedCycle = startCycle;
+            pendingMask = mask;
+        }
+
+        /// @brief Encodes the next block of the stream
+        /// @param words buffer for the block's words
+        /// @param maxWords size of the buffer; at least 2 so the block can always be closed
+        /// @param edges upcoming edges in time order; edges before the block are applied at its start
+        /// @param numEdges number of edges
+        /// @param blockEndCycle cycle the block ends on; the words always add up to exactly this
+        /// @param edgesUsed written with the number of edges encoded; the rest belong to later blocks
+        /// @return number of words written
+        uint32_t FillBlock(uint32_t *words, uint32_t maxWords, const GateEdge *edges, uint32_t numEdges, uint64_t blockEndCycle, uint32_t *edgesUsed);
+
+        /// @brief Cycle the next block starts on
+        uint64_t GetEncodedCycle() const { return encodedCycle; }
+};
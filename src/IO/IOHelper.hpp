@@ -7,40 +7,34 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <cmath>
-#include "pico/stdlib.h"
-#include "hardware/adc.h"
+#include "HAL/HAL.hpp"
+#include "Util/EventFIFO.hpp"
+#include "Timing/MidiClock.hpp"
+#include "AdcScanner.hpp"
+#include "Util/CVFilter.hpp"
+#include "Calibration.hpp"
+#include "LEDEnvelope.hpp"
 #include "MacroMath.h"
 
 #define NUM_GATE_OUTS 6
+/// First gate out pin; the gate outs are consecutive, in the order of GATE_OUT_PINS
+#define GATE_OUT_PIN_BASE 4
+/// GPIO mask of all the gate outs
+#define GATE_OUT_PIN_MASK (((1UL << NUM_GATE_OUTS) - 1) << GATE_OUT_PIN_BASE)
 #define NUM_LEDS 3
 
+/// Capacity of the CLOCK IN / RESET IN edge timestamp FIFOs
+#define GATE_IN_FIFO_SIZE 16
 #define GPIO_CLK 0
 #define GPIO_RST 1
 #define GPIO_PLAY 14
 
-#define GPIO_ADC 26
-
 #define GPIO_TMULT_A 15
 #define GPIO_TMULT_B 10
 
 
-enum LEDState
-{
-    SOLID_ON,
-    SOLID_OFF,
-    SOLID_HALF,
-    BLINK_SLOW,
-    BLINK_MED,
-    BLINK_FAST,
-    FADE_SLOWEST,
-    FADE_SLOW,
-    FADE_MED,
-    FADE_FAST,
-    FADE_FASTER,
-    FADE_FASTEST,
-};
-
 /// @brief Gate LEDs arent here, they're hardwired to the gate outs
 enum PanelLED
 {
@@ -51,6 +45,13 @@ enum PanelLED
 
 class IOHelper
 {
+    public:
+        /// @brief Scrub, time mult and swing CV smoothing: a 3 sample median drops spikes, then an adaptive one-pole
+        /// @brief holds still at rest (1/64 per sample) but follows a step within a couple of mS
+        typedef FilterChain<MedianFilter<3>, AdaptiveFilter<6, 6>> ScrubCVFilter;
+        /// @brief UD CV smoothing: only used in steps of 800, so it can rest even quieter
+        typedef FilterChain<MedianFilter<3>, AdaptiveFilter<7, 6>> UDCVFilter;
+
     private:
         /// @brief Gate Out Pin numbers
         /// @note The pins appear in the following order:
@@ -70,34 +71,18 @@ class IOHelper
         /// @note 2: Play Button LED
         const uint8_t LED_IO_PINS[NUM_LEDS] = {2, 3, 16};
 
-        /// @brief Pins that connect to the address select lines of the ADC MUX
-        const uint8_t MUX_ADDR_PINS[3] = {11, 12, 13};
-
         /// @brief To keep track of previous-update values; Used for debouncing
         bool WAS_PLAY  = false;
         /// @brief To keep track of previous-update values; Used for debouncing
-        bool WAS_CLK   = false;
-        /// @brief To keep track of previous-update values; Used for debouncing
-        bool WAS_RST   = false;
-        /// @brief To keep track of previous-update values; Used for debouncing
         uint8_t LAST_TM_SWITCH    = 0;
         
         
-        uint16_t LEDCycle = 0;
-
-        /// @brief Reads a value from the ADC through the MUX
-        /// @param addr MUX address
-        /// @return Raw ADC value, 0-4095
-        /// @note Includes a 20 uS settling delay to avoid cross-talk
-        int16_t ReadADC(uint8_t addr);
-
-        /// @brief RETURNED VALUES: 
-        /// @param adcValue raw value from the ADC
-        /// @param zero the ADC's raw value when the CV in is set to 0V
-        /// @param five the ADC's raw value when the CV in is set to +5V
-        /// @return Unclamped, voltage-calibrated value. -5V = -2048, 0V = 0, 5V = 2048
-        /// @note negative on bipolars only reads to -4.5V, while positive reads to about 5.5V
-        int16_t GetCalibratedValue(uint16_t adcValue, uint16_t zero, uint16_t five);
+        /// @brief Shared LED envelope clock, in LED_TICK_US ticks; used for "blinking" LED states
+        uint32_t LEDTicks = 0;
+        /// @brief Microseconds not yet counted into LEDTicks
+        uint32_t LEDTickRemainder = 0;
+        /// @brief Brightness envelope of each LED; the PWM slices do the dimming
+        LEDEnvelope LEDEnvelopes[NUM_LEDS];
 
         /// @brief Does Hysterises on an input
         /// @param var variable we're writing to, used to compare to new value 
@@ -106,6 +91,33 @@ class IOHelper
         /// @return new value of var, with hysterises applied
         int16_t DoHysteresisWrite(int16_t var, int16_t newValue, int16_t hysteresisThreshold);
 
+        /// @brief Instance the gate in edge interrupt feeds; set in Init
+        static IOHelper *edgeInstance;
+        /// @brief Edge timestamps of CLOCK IN, written by the GPIO interrupt
+        TimestampFIFO<GATE_IN_FIFO_SIZE> clockEdges;
+        /// @brief Edge timestamps of RESET IN, written by the GPIO interrupt
+        TimestampFIFO<GATE_IN_FIFO_SIZE> resetEdges;
+        /// @brief GPIO interrupt handler for the gate ins; stamps the edge and pushes it into the matching FIFO
+        static void OnGateInEdge(uint8_t pin, uint64_t timeMicros);
+        /// @brief Clock and transport messages from USB MIDI, stamped when the USB stack picks them up, written by it
+        MidiEventFIFO midiInEvents;
+        /// @brief USB MIDI receive handler; keeps Clock, Start, Continue, Stop and Song Position Pointer for the
+        /// @brief fast path and drops everything else
+        static void OnMidiReceived(const uint8_t *message, uint32_t length, uint64_t timeMicros);
+
+        /// @brief Background scan of the knob/CV mux; ReadSlowInputs only picks up its latest values
+        AdcScanner adcScanner;
+        /// @brief Instance the ADC scan interrupt feeds; set in StartAdcScan
+        static IOHelper *scanInstance;
+        /// @brief DMA interrupt handler of the ADC scan
+        static uint8_t OnAdcDwell(const uint16_t *samples, uint32_t count);
+
+        /// @brief CV in smoothing, one filter per jack (see CVFilter.hpp)
+        UDCVFilter CV_UD_Filter;
+        ScrubCVFilter CV_scrub_Filter;
+        ScrubCVFilter CV_timeMult_Filter;
+        ScrubCVFilter CV_swing_Filter;
+
     public:
 
         //-------- Outs --------
@@ -113,8 +125,9 @@ class IOHelper
         /// @brief RESET, CLOCK, PLAY
         LEDState OUT_LEDS[NUM_LEDS];
 
-        /// @brief 1, 1/2, 1/4, 1/16, UD, UD/2
-        bool OUT_GATES[NUM_GATE_OUTS];
+        /// @brief Gate out states as a GPIO mask (bit GATE_OUT_PIN_BASE + i = gate out i: 1, 1/2, 1/4, 1/16, UD, UD/2)
+        /// @note Written whole, so gates that change together are always pushed to the pins together
+        uint32_t OUT_GATE_PINS = 0;
 
 
         //-------- CV Inputs --------
@@ -136,6 +149,11 @@ class IOHelper
         /// @brief Swing CV Value.
         int16_t CV_swing        = 0;
 
+        /// @brief Maps the raw CV readings above to calibrated values (bipolar: -5V = -2048, 0V = 0, 5V = 2048).
+        /// @brief Loaded from flash in Init; CalibrationRoutine replaces it.
+        /// @note negative on bipolars only reads to -4.5V, while positive reads to about 5.5V
+        Calibration calibration;
+
         /// @brief User Division modifier
         int16_t CV_UD_Mult          = 0;
 
@@ -173,10 +191,6 @@ class IOHelper
 
         /// @brief Set when PLAY button is pressed.
         bool FLAG_PLAY  = false;
-        /// @brief Set when CLOCK IN gate goes high.
-        bool FLAG_CLK   = false;
-        /// @brief Set when RESET IN gate goes high.
-        bool FLAG_RST   = false;
 
         /// @brief Set when the state of the TMULT switch is changed.
         bool FLAG_TMULT = false;
@@ -187,8 +201,13 @@ class IOHelper
         /// @brief Initializes the IOHelper. Must be called before using.
         void Init();
 
+        /// @brief Starts the background knob/CV scan. Its interrupt runs on the calling core, so call it from the core
+        /// @brief that runs ReadSlowInputs.
+        void StartAdcScan();
+
         /// @brief "Audio rate" update. Should be called as often as reasonably possible, and at an even interval.
         /// @param dt the actual time in microseconds since the last time this was called
+        /// @note CLOCK IN and RESET IN are not polled here; they are timestamped by edge interrupts (see PopClockEdge)
         void ReadFastInputs(long dt);
 
         /// @brief "CV rate" update. Should be called as fast as reasonable, but is not as time-critical as ReadFastInputs
@@ -203,13 +222,23 @@ class IOHelper
         /// @param dt the actual time in microseconds since the last time this was called
         void WriteSlowOutputs(long dt);
 
-        /// @brief Checks if FLAG_RST is set, if so unsets it and returns true
-        /// @return true if FLAG_RST was set, false otherwise
-        bool ProcessResetFlag();
-        
-        /// @brief Checks if FLAG_CLK is set, if so unsets it and returns true
-        /// @return true if FLAG_CLK was set, false otherwise
-        bool ProcessClockFlag();
+        /// @brief Takes the oldest unprocessed RESET IN rising edge
+        /// @param edgeMicros written with the time of the edge, in HAL::TimeMicros() time
+        /// @return true if there was an edge waiting, false otherwise
+        bool PopResetEdge(uint64_t *edgeMicros) { return resetEdges.Pop(edgeMicros); }
+
+        /// @brief Takes the oldest unprocessed CLOCK IN rising edge
+        /// @param edgeMicros written with the time of the edge, in HAL::TimeMicros() time
+        /// @return true if there was an edge waiting, false otherwise
+        bool PopClockEdge(uint64_t *edgeMicros) { return clockEdges.Pop(edgeMicros); }
+
+        /// @brief Takes the oldest unprocessed USB MIDI clock or transport message
+        /// @param event written with the message and the time its USB packet arrived, in HAL::TimeMicros() time
+        /// @return true if there was a message waiting, false otherwise
+        bool PopMidiEvent(MidiEvent *event) { return midiInEvents.Pop(event); }
+
+        /// @brief True while a RESET IN edge is waiting to be processed
+        bool IsResetPending() const { return !resetEdges.IsEmpty(); }
         
         /// @brief Checks if FLAG_PLAY is set, if so unsets it and returns true
         /// @return true if FLAG_PLAY was set, false otherwise
@@ -0,0 +1,148 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Length of one LED envelope tick in microseconds; every blink and fade period is a power of two of these
+#define LED_TICK_US 100
+
+/// Entries in the gamma table, as a power of two (plus one extra for interpolation)
+#define LED_GAMMA_TABLE_BITS 8
+#define LED_GAMMA_TABLE_SIZE (1 << LED_GAMMA_TABLE_BITS)
+
+/// Perceived brightness of SOLID_HALF (0-65535); the same as the old software PWM's 5/32 duty on the button LED and
+/// 3/32 on the rect LEDs, which were picked by eye to look like half
+#define LED_HALF_LEVEL_BUTTON 31190
+#define LED_HALF_LEVEL_RECT 25428
+
+enum LEDState
+{
+    SOLID_ON,
+    SOLID_OFF,
+    SOLID_HALF,
+    BLINK_SLOW,
+    BLINK_MED,
+    BLINK_FAST,
+    FADE_SLOWEST,
+    FADE_SLOW,
+    FADE_MED,
+    FADE_FAST,
+    FADE_FASTER,
+    FADE_FASTEST,
+};
+
+/// @brief Perceived brightness to PWM duty: level^2.5, both 0-65535, built at compile time.
+/// @note Has one extra entry so interpolation never has to clamp.
+struct LEDGammaTable
+{
+    uint16_t duties[LED_GAMMA_TABLE_SIZE + 1];
+
+    /// @brief Newton's method square root, exact to a double's precision for [0, 1]
+    static constexpr double Sqrt(double x)
+    {
+        if(x <= 0) return 0;
+        double root = 1;
+        for(int i = 0; i < 20; i++) root = (root + x / root) / 2;
+        return root;
+    }
+
+    constexpr LEDGammaTable() : duties()
+    {
+        for(int i = 0; i <= LED_GAMMA_TABLE_SIZE; i++)
+        {
+            double level = double(i) / LED_GAMMA_TABLE_SIZE;
+            double duty = level * level * Sqrt(level) * 65535 + 0.5;
+            duties[i] = uint16_t(duty > 65535 ? 65535 : duty);
+        }
+    }
+};
+
+static constexpr LEDGammaTable ledGammaTable;
+
+/// @brief Brightness envelope of one panel LED, for a hardware PWM channel.
+/// @note All LEDs run off one shared tick count, so LEDs in the same state blink and fade together, and their speed
+/// @note no longer depends on how often the main loop runs. Update only reports a duty when it changed, so a solid
+/// @note LED costs no PWM writes at all.
+class LEDEnvelope
+{
+    private:
+        /// @brief Perceived brightness of SOLID_HALF, 0-65535
+        uint16_t halfLevel = LED_HALF_LEVEL_RECT;
+        /// @brief Last duty reported; starts out of range so the first Update always reports
+        int32_t lastDuty = -1;
+
+        /// @brief Square wave: off for the first half of each 2^periodBits ticks, on for the second
+        static uint16_t Blink(uint32_t ticks, uint32_t periodBits)
+        {
+            return (ticks >> (periodBits - 1)) & 1 ? 65535 : 0;
+        }
+
+        /// @brief Triangle wave: dark at the start of each 2^periodBits ticks, full brightness halfway through
+        static uint16_t Fade(uint32_t ticks, uint32_t periodBits)
+        {
+            uint32_t period = 1UL << periodBits;
+            uint32_t phase = ticks & (period - 1);
+            uint32_t triangle = phase < period / 2 ? phase : period - phase; //0 to period / 2
+            uint32_t level = triangle << (17 - periodBits);
+            return level > 65535 ? 65535 : level;
+        }
+
+    public:
+        /// @param level perceived brightness of SOLID_HALF on this LED, 0-65535
+        void SetHalfLevel(uint16_t level) { halfLevel = level; }
+
+        /// @brief Perceived brightness of a state at a point in time
+        /// @param state display pattern
+        /// @param ticks shared LED tick count (LED_TICK_US each)
+        /// @return 0-65535
+        uint16_t GetLevel(LEDState state, uint32_t ticks) const
+        {
+            switch(state)
+            {
+                case LEDState::SOLID_ON:        return 65535;
+                case LEDState::SOLID_OFF:       return 0;
+                case LEDState::SOLID_HALF:      return halfLevel;
+                case LEDState::BLINK_SLOW:      return Blink(ticks, 13);    //819mS
+                case LEDState::BLINK_MED:       return Blink(ticks, 12);    //410mS
+                case LEDState::BLINK_FAST:      return Blink(ticks, 11);    //205mS
+                case LEDState::FADE_SLOWEST:    return Fade(ticks, 16);     //6.55S
+                case LEDState::FADE_SLOW:       return Fade(ticks, 15);     //3.28S
+                case LEDState::FADE_MED:        return Fade(ticks, 14);     //1.64S
+                case LEDState::FADE_FAST:       return Fade(ticks, 13);     //819mS
+                case LEDState::FADE_FASTER:     return Fade(ticks, 11);     //205mS
+                case LEDState::FADE_FASTEST:    return Fade(ticks, 10);     //102mS
+            }
+            return 0;
+        }
+
+        /// @brief Perceived brightness to PWM duty, interpolating between gamma table entries
+        /// @param level 0-65535
+        /// @return duty, 0-65535
+        static uint16_t GammaCorrect(uint16_t level)
+        {
+            uint32_t index = level >> (16 - LED_GAMMA_TABLE_BITS);
+            uint32_t fraction = level & ((1 << (16 - LED_GAMMA_TABLE_BITS)) - 1);
+            uint32_t low = ledGammaTable.duties[index];
+            uint32_t high = ledGammaTable.duties[index + 1];
+            return low + (((high - low) * fraction) >> (16 - LED_GAMMA_TABLE_BITS));
+        }
+
+        /// @brief Works out the duty for now
+        /// @param state display pattern
+        /// @param ticks shared LED tick count (LED_TICK_US each)
+        /// @param duty written with the new PWM duty (0-65535) if it changed
+        /// @return true if the duty changed and has to be written to the PWM
+        bool Update(LEDState state, uint32_t ticks, uint16_t *duty)
+        {
+            uint16_t newDuty = GammaCorrect(GetLevel(state, ticks));
+            if(newDuty == lastDuty) return false;
+            lastDuty = newDuty;
+            *duty = newDuty;
+            return true;
+        }
+};
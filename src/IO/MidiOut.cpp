@@ -0,0 +1,25 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "MidiOut.hpp"
+#include "debug.h"
+
+uint64_t MidiOut::Service(MidiEventFIFO &events, uint64_t nowMicros)
+{
+    while(hasPending || events.Pop(&pending))
+    {
+        hasPending = true;
+        uint64_t dueMicros = pending.timeMicros + MIDI_OUT_LATENCY_US;
+        if(dueMicros > nowMicros) return dueMicros;
+        if(!HAL::MidiWrite(pending.bytes, pending.length))
+        {
+            dropped++;
+            trace(TRACE_MIDI_OUT_DROPPED, pending.bytes[0], int32_t(dropped));
+        }
+        hasPending = false;
+    }
+    return UINT64_MAX;
+}
@@ -0,0 +1,40 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "HAL/HAL.hpp"
+#include "Timing/MidiClock.hpp"
+
+/// How far behind its timestamp every MIDI message is sent. More than the slow loop's period, so each message has
+/// been picked up well before it is due and goes out on time rather than whenever the loop next comes round.
+#define MIDI_OUT_LATENCY_US 2000
+
+/// @brief Sends the fast path's timestamped MIDI messages over USB, from the CV rate loop.
+/// @note Every message leaves exactly MIDI_OUT_LATENCY_US after the moment it belongs to, so the clock's spacing is
+/// @note the fast path's, not the loop's or USB's. A message the port won't take is dropped rather than retried:
+/// @note a late clock is worse than a missing one.
+class MidiOut
+{
+    private:
+        /// @brief Oldest message taken from the FIFO but not yet due
+        MidiEvent pending;
+        bool hasPending = false;
+        /// @brief Messages the USB port refused
+        uint32_t dropped = 0;
+
+    public:
+        /// @brief Sends every message that has come due
+        /// @param events the fast path's MIDI FIFO (consumer side)
+        /// @param nowMicros HAL::TimeMicros()
+        /// @return HAL::TimeMicros() time the next waiting message is due, or UINT64_MAX if there is none; the loop
+        /// @return should come round again by then
+        uint64_t Service(MidiEventFIFO &events, uint64_t nowMicros);
+
+        /// @brief Messages dropped because the USB port wasn't connected or was full
+        uint32_t GetDroppedCount() const { return dropped; }
+};
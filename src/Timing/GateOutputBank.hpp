@@ -0,0 +1,402 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "RhythmPattern.hpp"
+#include "Util/FastRandom.hpp"
+
+/// Gate length of a full cycle; gate lengths are 0 (never on) to this (always on)
+#define GATE_LENGTH_FULL 1024
+/// Probability of a gate that always plays; probabilities are 0 (never) to this
+#define GATE_PROBABILITY_FULL 1024
+/// Most ratchets (pulses per gate)
+#define GATE_MAX_RATCHETS 16
+
+/// @brief How one gate out is derived from musical time
+struct GateOutputConfig
+{
+    /// @brief Cycle length in time base ticks. For a user division output, the cycle before the UD shift is applied.
+    uint32_t divisor = 1;
+    /// @brief Part of the cycle the gate is on for, 0 to GATE_LENGTH_FULL
+    uint16_t gateLength = GATE_LENGTH_FULL / 2;
+    /// @brief Ticks the cycle starts late by
+    uint32_t phaseOffset = 0;
+    /// @brief True if the cycle follows the UD knob and CV, i.e. is divisor << the UD shift
+    bool isUserDivision = false;
+    /// @brief Rhythm pattern, one cycle per step: bit s set means step s plays its gate, clear means it rests.
+    /// @brief See RhythmPattern for Euclidean ones.
+    uint64_t pattern = 1;
+    /// @brief Steps in the pattern, 1 (a plain division) to RHYTHM_MAX_STEPS
+    uint8_t patternSteps = 1;
+    /// @brief Chance a step's gate plays, 0 to GATE_PROBABILITY_FULL; rolled once per cycle
+    uint16_t probability = GATE_PROBABILITY_FULL;
+    /// @brief Pulses per gate, 1 to GATE_MAX_RATCHETS: the cycle is split into this many sub-cycles, each with a gate
+    /// @brief of gateLength. Cut down to the nearest count that splits the cycle into whole ticks.
+    uint8_t ratchets = 1;
+    /// @brief Most ticks a gate may start late by, picked at random once per cycle (and kept short enough that the
+    /// @brief gate still ends inside its sub-cycle)
+    uint32_t humanizeTicks = 0;
+};
+
+/// @brief A gate out fixed at compile time: a plain division, with no phase offset, pattern or modifiers. A constexpr
+/// @brief table of these is a layout GateOutputBank::AdvanceLayout can be built for.
+struct GateOutputDefinition
+{
+    /// @brief Cycle length in time base ticks, before the UD shift for a user division output (not 0)
+    uint32_t divisor;
+    uint16_t gateLength;
+    bool isUserDivision;
+};
+
+/// @brief Gate outs as a set of phase counters, one per output.
+/// @note Each output keeps its position within its own cycle and moves it along with musical time, so a gate costs
+/// @note an add and a compare per update instead of a (64 bit) modulo. Its step counter moves on at each cycle
+/// @note boundary, and only then are the pattern, probability and humanize worked out for the new step, so they
+/// @note cost nothing on the other ticks. The random choices come from FastRandom, keyed on the seed and the cycle
+/// @note count, so they replay exactly for the same seed. A counter only falls back to a division when time jumps
+/// @note by a cycle or more or its cycle changes; everything comes from the position then, so a reset to 0 always
+/// @note puts every pattern back on step 0 with the same dice. To look ahead, copy the bank and Advance the copy;
+/// @note GetMaskAt is the plain division form, for checking. AdvanceLayout is Advance built for one layout.
+/// @tparam N number of outputs, at most 32
+template <uint32_t N>
+class GateOutputBank
+{
+    static_assert(N <= 32, "gate masks are 32 bits");
+
+    private:
+        GateOutputConfig configs[N];
+        /// @brief Sub-cycle length of each output in ticks, after the UD shift and ratchets
+        uint32_t divisors[N];
+        /// @brief Phases from the delay up to the delay plus this are on; the same split as
+        /// @brief (phase * 1024 < divisor * gateLength) without humanize
+        uint32_t onTicks[N];
+        /// @brief Phase offset of each output, within its full cycle
+        uint32_t offsets[N];
+        /// @brief Ratchets of each output after rounding
+        uint32_t ratchetCounts[N];
+        /// @brief Longest humanize delay of each output after clamping
+        uint32_t maxDelays[N];
+        /// @brief Rhythm pattern of each output, masked to its steps
+        uint64_t patterns[N];
+        /// @brief Steps in each output's pattern
+        uint32_t patternSteps[N];
+
+        /// @brief Position of each output within its sub-cycle, as of lastPosition
+        uint32_t phases[N];
+        /// @brief Sub-cycle of each output within its cycle, as of lastPosition
+        uint32_t ratchets[N];
+        /// @brief Full cycles of each output since position 0 (wrapping), as of lastPosition; keys the random choices
+        uint32_t cycles[N];
+        /// @brief Step of each output's pattern, as of lastPosition
+        uint32_t steps[N];
+        /// @brief Humanize delay of each output's current gate
+        uint32_t delays[N];
+        /// @brief Bit i set if output i's current step plays; only worked out when a step changes
+        uint32_t playing = 0;
+        /// @brief Bit i set if output i never changes state (always off, or a full gate on every step)
+        uint32_t constant = 0;
+
+        /// @brief Musical time the phases describe
+        int64_t lastPosition = 0;
+        /// @brief Current UD shift, applied to user division outputs
+        uint32_t udShift = 0;
+        /// @brief Seed of the probability and humanize choices
+        uint32_t seed = 0;
+        /// @brief False until the phases have been worked out from a position, and after anything changes a cycle
+        bool isSynced = false;
+
+        void UpdateOutput(uint32_t output)
+        {
+            const GateOutputConfig &config = configs[output];
+            uint32_t cycle = uint32_t(config.divisor) << (config.isUserDivision ? udShift : 0);
+            if(cycle == 0) cycle = 1;
+            uint32_t ratchetCount = config.ratchets < 1 ? 1 : (config.ratchets > GATE_MAX_RATCHETS ? GATE_MAX_RATCHETS : config.ratchets);
+            while(cycle % ratchetCount) ratchetCount--;
+            uint32_t divisor = cycle / ratchetCount;
+            ratchetCounts[output] = ratchetCount;
+            divisors[output] = divisor;
+            onTicks[output] = uint32_t((uint64_t(divisor) * config.gateLength + GATE_LENGTH_FULL - 1) / GATE_LENGTH_FULL);
+            offsets[output] = config.phaseOffset % cycle;
+            //a delayed gate has to end before its sub-cycle does, or it would run into the next one
+            uint32_t room = onTicks[output] < divisor ? divisor - onTicks[output] - 1 : 0;
+            maxDelays[output] = config.humanizeTicks < room ? config.humanizeTicks : room;
+            uint32_t stepCount = config.patternSteps;
+            if(stepCount < 1) stepCount = 1;
+            if(stepCount > RHYTHM_MAX_STEPS) stepCount = RHYTHM_MAX_STEPS;
+            patternSteps[output] = stepCount;
+            patterns[output] = config.pattern & RhythmPattern::StepMask(stepCount);
+
+            bool isAlwaysOff = onTicks[output] == 0 || patterns[output] == 0 || config.probability == 0;
+            bool isAlwaysOn = onTicks[output] >= divisor && patterns[output] == RhythmPattern::StepMask(stepCount)
+                && config.probability >= GATE_PROBABILITY_FULL;
+            constant = (constant & ~(1UL << output)) | (uint32_t(isAlwaysOff || isAlwaysOn) << output);
+            isSynced = false;
+        }
+
+        /// @brief Whether a cycle's gate plays, and how late it starts
+        /// @param delay written with the humanize delay in ticks
+        bool Roll(uint32_t output, uint32_t cycle, uint32_t step, uint32_t *delay) const
+        {
+            uint32_t random = FastRandom::Get(seed, output, cycle);
+            *delay = FastRandom::Scale(random, maxDelays[output] + 1);
+            bool isInPattern = (patterns[output] >> step) & 1;
+            return isInPattern && (random & (GATE_PROBABILITY_FULL - 1)) < configs[output].probability;
+        }
+
+        /// @brief Moves an output to a new cycle, and makes its choices for it (once per gate)
+        void SetCycle(uint32_t output, uint32_t cycle, uint32_t step)
+        {
+            cycles[output] = cycle;
+            steps[output] = step;
+            bool isPlaying = Roll(output, cycle, step, &delays[output]);
+            playing = (playing & ~(1UL << output)) | (uint32_t(isPlaying) << output);
+        }
+
+        /// @brief Position of an output within its sub-cycle, cycle and pattern, the slow way
+        /// @param ratchet written with the sub-cycle within the cycle
+        /// @param cycle written with the full cycle count (wrapping)
+        /// @param step written with the pattern step
+        /// @return position within the sub-cycle
+        uint32_t Locate(uint32_t output, int64_t position, uint32_t *ratchet, uint32_t *cycle, uint32_t *step) const
+        {
+            int64_t divisor = divisors[output];
+            int64_t subCycles = (position - offsets[output]) / divisor;
+            int64_t phase = (position - offsets[output]) - subCycles * divisor;
+            if(phase < 0)
+            {
+                phase += divisor;
+                subCycles--;
+            }
+            int64_t ratchetCount = ratchetCounts[output];
+            int64_t fullCycles = subCycles / ratchetCount;
+            int64_t subCycle = subCycles - fullCycles * ratchetCount;
+            if(subCycle < 0)
+            {
+                subCycle += ratchetCount;
+                fullCycles--;
+            }
+            int64_t stepCount = patternSteps[output];
+            int64_t patternStep = fullCycles % stepCount;
+            *ratchet = uint32_t(subCycle);
+            *cycle = uint32_t(fullCycles);
+            *step = uint32_t(patternStep < 0 ? patternStep + stepCount : patternStep);
+            return uint32_t(phase);
+        }
+
+    public:
+        GateOutputBank()
+        {
+            for(uint32_t i = 0; i < N; i++) UpdateOutput(i);
+        }
+
+        /// @brief Changes how an output is derived; takes effect from the next Advance
+        void SetConfig(uint32_t output, const GateOutputConfig &config)
+        {
+            if(output >= N) return;
+            configs[output] = config;
+            UpdateOutput(output);
+        }
+        const GateOutputConfig &GetConfig(uint32_t output) const { return configs[output]; }
+
+        /// @brief Sets the UD shift; only does any work when it changes
+        /// @param shift user division outputs run at divisor << shift
+        void SetUDShift(uint32_t shift)
+        {
+            if(shift == udShift) return;
+            udShift = shift;
+            for(uint32_t i = 0; i < N; i++)
+            {
+                if(configs[i].isUserDivision) UpdateOutput(i);
+            }
+        }
+
+        /// @brief Sets the seed of the probability and humanize choices; only does any work when it changes
+        void SetSeed(uint32_t newSeed)
+        {
+            if(newSeed == seed) return;
+            seed = newSeed;
+            isSynced = false;
+        }
+
+        /// @brief Cycle length of an output in ticks, after the UD shift
+        uint32_t GetDivisor(uint32_t output) const { return divisors[output] * ratchetCounts[output]; }
+
+        /// @brief Moves every output's phase to a new position and works out the gates
+        /// @param position musical time in ticks; may go backwards
+        /// @return bit i set if output i is on
+        uint32_t Advance(int64_t position)
+        {
+            uint32_t mask = 0;
+            int64_t distance = position - lastPosition;
+            //anything this far is more than any cycle anyway, and the rest fits 32 bits
+            bool isNear = isSynced && distance > -(1LL << 30) && distance < (1LL << 30);
+            int32_t delta = int32_t(distance);
+            uint32_t stride = delta >= 0 ? uint32_t(delta) : uint32_t(-delta);
+            for(uint32_t i = 0; i < N; i++)
+            {
+                uint32_t divisor = divisors[i];
+                if(isNear && stride < divisor)
+                {
+                    //under a sub-cycle either way, so at most one boundary to cross
+                    uint32_t phase = phases[i];
+                    if(delta >= 0)
+                    {
+                        phase += stride;
+                        if(phase >= divisor)
+                        {
+                            phase -= divisor;
+                            if(++ratchets[i] == ratchetCounts[i])
+                            {
+                                ratchets[i] = 0;
+                                SetCycle(i, cycles[i] + 1, steps[i] + 1 == patternSteps[i] ? 0 : steps[i] + 1);
+                            }
+                        }
+                    }
+                    else if(phase >= stride)
+                    {
+                        phase -= stride;
+                    }
+                    else
+                    {
+                        phase += divisor - stride;
+                        if(ratchets[i]-- == 0)
+                        {
+                            ratchets[i] = ratchetCounts[i] - 1;
+                            SetCycle(i, cycles[i] - 1, steps[i] == 0 ? patternSteps[i] - 1 : steps[i] - 1);
+                        }
+                    }
+                    phases[i] = phase;
+                }
+                else
+                {
+                    uint32_t cycle;
+                    uint32_t step;
+                    phases[i] = Locate(i, position, &ratchets[i], &cycle, &step);
+                    SetCycle(i, cycle, step);
+                }
+                //on from the delay for onTicks; a phase before the delay wraps to a huge value
+                mask |= uint32_t(phases[i] - delays[i] < onTicks[i]) << i;
+            }
+            lastPosition = position;
+            isSynced = true;
+            //and the step has to play
+            return mask & playing;
+        }
+
+        /// @brief Whether every output is set up as a layout says, so AdvanceLayout can stand in for Advance
+        bool IsLayout(const GateOutputDefinition (&layout)[N]) const
+        {
+            for(uint32_t i = 0; i < N; i++)
+            {
+                const GateOutputConfig &config = configs[i];
+                bool isPlain = config.phaseOffset == 0 && config.ratchets <= 1 && config.humanizeTicks == 0 &&
+                    patternSteps[i] == 1 && patterns[i] == 1 && config.probability >= GATE_PROBABILITY_FULL;
+                if(!isPlain || config.divisor != layout[i].divisor || config.gateLength != layout[i].gateLength ||
+                    config.isUserDivision != layout[i].isUserDivision) return false;
+            }
+            return true;
+        }
+
+        /// @brief Advance, built for a bank set up as LAYOUT (see IsLayout). The loop is unrolled, and a fixed
+        /// @brief output's cycle and gate are constants; a user division output still follows the UD shift.
+        /// @note Every step of a plain division plays with no delay, so only the phase and cycle count move. The
+        /// @note state stays the same as Advance's, so the two can take turns and a copy can look ahead with either.
+        template <const GateOutputDefinition (&LAYOUT)[N]>
+        uint32_t AdvanceLayout(int64_t position)
+        {
+            uint32_t mask = 0;
+            int64_t distance = position - lastPosition;
+            bool isNear = isSynced && distance > -(1LL << 30) && distance < (1LL << 30);
+            int32_t delta = int32_t(distance);
+            uint32_t stride = delta >= 0 ? uint32_t(delta) : uint32_t(-delta);
+            #pragma GCC unroll 32
+            for(uint32_t i = 0; i < N; i++)
+            {
+                const GateOutputDefinition &output = LAYOUT[i];
+                uint32_t divisor = output.isUserDivision ? divisors[i] : output.divisor;
+                uint32_t on = output.isUserDivision ? onTicks[i] :
+                    uint32_t((uint64_t(output.divisor) * output.gateLength + GATE_LENGTH_FULL - 1) / GATE_LENGTH_FULL);
+                if(isNear && stride < divisor)
+                {
+                    uint32_t phase = phases[i];
+                    if(delta >= 0)
+                    {
+                        phase += stride;
+                        if(phase >= divisor)
+                        {
+                            phase -= divisor;
+                            cycles[i]++;
+                        }
+                    }
+                    else if(phase >= stride)
+                    {
+                        phase -= stride;
+                    }
+                    else
+                    {
+                        phase += divisor - stride;
+                        cycles[i]--;
+                    }
+                    phases[i] = phase;
+                }
+                else
+                {
+                    uint32_t cycle;
+                    uint32_t step;
+                    phases[i] = Locate(i, position, &ratchets[i], &cycle, &step);
+                    SetCycle(i, cycle, step);
+                }
+                mask |= uint32_t(phases[i] < on) << i;
+            }
+            lastPosition = position;
+            isSynced = true;
+            return mask;
+        }
+
+        /// @brief Gate states at any position, without touching the phase counters (the slow way)
+        /// @param position musical time in ticks
+        /// @return bit i set if output i is on
+        uint32_t GetMaskAt(int64_t position) const
+        {
+            uint32_t mask = 0;
+            for(uint32_t i = 0; i < N; i++)
+            {
+                uint32_t ratchet;
+                uint32_t cycle;
+                uint32_t step;
+                uint32_t delay;
+                uint32_t phase = Locate(i, position, &ratchet, &cycle, &step);
+                bool isPlaying = Roll(i, cycle, step, &delay);
+                mask |= uint32_t(isPlaying && phase - delay < onTicks[i]) << i;
+            }
+            return mask;
+        }
+
+        /// @brief Ticks from the last Advance until the first output may change state
+        /// @note A sub-cycle boundary counts even when the next gate rests, so this can be early, never late
+        /// @return ticks ahead, or UINT32_MAX if every output is constant (or nothing has been advanced yet)
+        uint32_t TicksUntilNextEdge() const
+        {
+            if(!isSynced) return UINT32_MAX;
+            uint32_t ticks = UINT32_MAX;
+            for(uint32_t i = 0; i < N; i++)
+            {
+                if((constant >> i) & 1) continue;
+                uint32_t phase = phases[i];
+                uint32_t untilEdge = divisors[i] - phase;
+                if((playing >> i) & 1)
+                {
+                    uint32_t delay = delays[i];
+                    if(phase < delay) untilEdge = delay - phase;
+                    else if(phase - delay < onTicks[i] && delay + onTicks[i] < divisors[i]) untilEdge = onTicks[i] - (phase - delay);
+                }
+                if(untilEdge < ticks) ticks = untilEdge;
+            }
+            return ticks;
+        }
+};
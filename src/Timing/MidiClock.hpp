@@ -0,0 +1,159 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "Util/EventFIFO.hpp"
+
+/// MIDI clocks per quarter note
+#define MIDI_CLOCK_PPQN 24
+/// MIDI clocks per Song Position Pointer unit (a 16th note)
+#define MIDI_CLOCKS_PER_SONG_POSITION 6
+
+/// MIDI system messages
+#define MIDI_TIMING_CLOCK 0xF8
+#define MIDI_START 0xFA
+#define MIDI_CONTINUE 0xFB
+#define MIDI_STOP 0xFC
+#define MIDI_SONG_POSITION 0xF2
+
+/// Capacity of the fast path's MIDI event FIFO; the slow path drains it at least every mS
+#define MIDI_EVENT_FIFO_SIZE 64
+
+/// @brief One MIDI message, stamped with the time it belongs to
+struct MidiEvent
+{
+    /// @brief HAL::TimeMicros() time of the musical event
+    uint64_t timeMicros = 0;
+    uint8_t bytes[3] = {};
+    uint8_t length = 0;
+};
+
+typedef EventFIFO<MidiEvent, MIDI_EVENT_FIFO_SIZE> MidiEventFIFO;
+
+/// @brief Turns musical time into MIDI Clock, Start/Stop/Continue and Song Position Pointer messages.
+/// @note Runs on the fast path from the same position the gate outs are stepped from. A clock is due each
+/// @note ticksPerQuarter / 24 ticks; the count moves by adding, so the only divisions are on Continue, a reset and
+/// @note to time a clock that fell between two updates (the alarm normally wakes right on it, see TicksUntilNextClock).
+/// @note Messages are stamped with the time their clock actually fell on, so the sender can hold them all back by
+/// @note the same latency instead of sending them whenever it gets round to it.
+class MidiClockGenerator
+{
+    private:
+        uint32_t ticksPerClock = 1;
+        /// @brief Position of the next clock
+        int64_t nextClockPosition = 0;
+        /// @brief Position and time of the last Update
+        int64_t lastPosition = 0;
+        uint64_t lastMicros = 0;
+        bool wasPlaying = false;
+
+        static void Send(MidiEventFIFO &events, uint64_t timeMicros, uint8_t status)
+        {
+            MidiEvent event;
+            event.timeMicros = timeMicros;
+            event.bytes[0] = status;
+            event.length = 1;
+            events.Push(event);
+        }
+
+        /// @brief Sends a Song Position Pointer for the first 16th note at or after a position, and clocks from there
+        /// @note A position less than a clock past a 16th counts as on it (its clock goes out right away), so a jump
+        /// @note that lands a few ticks late, e.g. following a MIDI clock in, doesn't skip a 16th
+        void Relocate(MidiEventFIFO &events, uint64_t timeMicros, int64_t position)
+        {
+            int64_t ticksPerSongPosition = int64_t(ticksPerClock) * MIDI_CLOCKS_PER_SONG_POSITION;
+            int64_t late = position - ticksPerClock + 1;
+            int64_t songPosition = late > 0 ? (late + ticksPerSongPosition - 1) / ticksPerSongPosition : 0;
+            MidiEvent event;
+            event.timeMicros = timeMicros;
+            event.bytes[0] = MIDI_SONG_POSITION;
+            event.bytes[1] = songPosition & 0x7F;
+            event.bytes[2] = (songPosition >> 7) & 0x7F; //14 bits; a long enough set just wraps
+            event.length = 3;
+            events.Push(event);
+            nextClockPosition = songPosition * ticksPerSongPosition;
+        }
+
+    public:
+        /// @param ticksPerQuarter resolution of the positions passed to Update; should be a multiple of 24
+        void SetTicksPerQuarter(uint32_t ticksPerQuarter)
+        {
+            ticksPerClock = ticksPerQuarter / MIDI_CLOCK_PPQN;
+            if(ticksPerClock == 0) ticksPerClock = 1;
+        }
+
+        /// @brief Queues whatever the move from the last position to this one calls for
+        /// @param position musical time in ticks; a step back is taken as a reset, and a jump forward of more than a
+        /// @param position clock (a Continue from further on, without a Stop) is relocated to the same way
+        /// @param isPlaying false sends Stop (once) and nothing else until playing again
+        /// @param nowMicros HAL::TimeMicros() of this position
+        /// @param events where the messages go
+        void Update(int64_t position, bool isPlaying, uint64_t nowMicros, MidiEventFIFO &events)
+        {
+            if(!isPlaying)
+            {
+                if(wasPlaying) Send(events, nowMicros, MIDI_STOP);
+                wasPlaying = false;
+                lastPosition = position;
+                lastMicros = nowMicros;
+                return;
+            }
+            if(!wasPlaying)
+            {
+                //from the top (within its first clock) is a Start; from anywhere else, say where first
+                if(position < int64_t(ticksPerClock))
+                {
+                    Send(events, nowMicros, MIDI_START);
+                    nextClockPosition = 0;
+                }
+                else
+                {
+                    Relocate(events, nowMicros, position);
+                    Send(events, nowMicros, MIDI_CONTINUE);
+                }
+                wasPlaying = true;
+                lastPosition = position;
+                lastMicros = nowMicros;
+            }
+            else if(position < lastPosition || position - lastPosition > int64_t(ticksPerClock))
+            {
+                //clocking through a jump would send one clock per 24th skipped, in a burst that overflows the FIFO
+                Relocate(events, nowMicros, position);
+                lastPosition = position;
+                lastMicros = nowMicros;
+            }
+
+            while(position >= nextClockPosition)
+            {
+                //when the clock fell between updates, place it in between at the speed time moved by
+                uint64_t timeMicros = nowMicros;
+                if(position > lastPosition && nextClockPosition > lastPosition)
+                {
+                    uint64_t elapsed = nowMicros - lastMicros;
+                    timeMicros = lastMicros + elapsed * uint64_t(nextClockPosition - lastPosition) / uint64_t(position - lastPosition);
+                }
+                else if(nextClockPosition <= lastPosition)
+                {
+                    timeMicros = lastMicros;
+                }
+                Send(events, timeMicros, MIDI_TIMING_CLOCK);
+                nextClockPosition += ticksPerClock;
+            }
+            lastPosition = position;
+            lastMicros = nowMicros;
+        }
+
+        /// @brief Ticks from a position to the next clock, so the fast path can wake right on it
+        /// @return ticks ahead, or UINT32_MAX when stopped
+        uint32_t TicksUntilNextClock(int64_t position) const
+        {
+            if(!wasPlaying) return UINT32_MAX;
+            int64_t ticks = nextClockPosition - position;
+            return ticks <= 0 ? 0 : (ticks >= UINT32_MAX ? UINT32_MAX - 1 : uint32_t(ticks));
+        }
+};
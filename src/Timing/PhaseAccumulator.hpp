@@ -0,0 +1,84 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Fractional bits of the phase accumulator and its increment
+#define PHASE_FRACTION_BITS 48
+
+/// @brief Free-running time base: a fixed-point phase accumulator advanced by a per-microsecond increment.
+/// @note The phase is Q16.48 ticks and wraps every 65536 ticks, so callers only ever use the whole ticks elapsed per
+/// @note Advance. The increment has 48 fractional bits, which keeps tempo error far below 1ppm at any BPM, and
+/// @note 0 BPM is simply an increment of 0.
+class PhaseAccumulator
+{
+    private:
+        /// @brief Phase in Q16.48 ticks
+        uint64_t phase = 0;
+        /// @brief Ticks per microsecond, Q48
+        uint64_t increment = 0;
+
+    public:
+        /// @brief Sets the tempo. Uses double precision, so keep it out of the fast path.
+        /// @param bpm quarter notes per minute
+        /// @param ticksPerQuarter ticks per quarter note
+        void SetBPM(float bpm, uint32_t ticksPerQuarter) { increment = IncrementForBPM(bpm, ticksPerQuarter); }
+
+        /// @brief Works out the increment for a tempo without touching the phase, so it can be done on another core
+        /// @param bpm quarter notes per minute
+        /// @param ticksPerQuarter ticks per quarter note
+        /// @return ticks per microsecond, Q48
+        static uint64_t IncrementForBPM(float bpm, uint32_t ticksPerQuarter)
+        {
+            return bpm <= 0 ? 0 : uint64_t(double(bpm) * double(ticksPerQuarter) * double(1ULL << PHASE_FRACTION_BITS) / 60'000'000.0);
+        }
+
+        /// @brief Sets the tempo from a precomputed increment (see IncrementForBPM)
+        /// @param ticksPerMicroQ48 ticks per microsecond, Q48
+        void SetIncrement(uint64_t ticksPerMicroQ48) { increment = ticksPerMicroQ48; }
+
+        /// @brief Advances the phase
+        /// @param deltaMicros microseconds since the last advance
+        /// @return whole ticks elapsed (must be under 65536 per call)
+        uint32_t Advance(uint32_t deltaMicros)
+        {
+            uint64_t last = phase;
+            phase += increment * deltaMicros;
+            return uint32_t((phase >> PHASE_FRACTION_BITS) - (last >> PHASE_FRACTION_BITS)) & 0xFFFF;
+        }
+
+        /// @brief Time until the phase has advanced by a number of whole ticks, i.e. crossed the n-th tick boundary
+        /// @param ticks whole tick boundaries ahead (1 = the next one)
+        /// @return microseconds, rounded up so the boundary has always been crossed by then; UINT32_MAX when stopped
+        uint32_t GetMicrosUntilTicks(uint32_t ticks) const
+        {
+            if(increment == 0) return UINT32_MAX;
+            if(ticks > 0xFFFF) ticks = 0xFFFF;
+            uint64_t remaining = (uint64_t(ticks) << PHASE_FRACTION_BITS) - (phase & ((1ULL << PHASE_FRACTION_BITS) - 1));
+            uint64_t micros = (remaining + increment - 1) / increment;
+            return micros > UINT32_MAX ? UINT32_MAX : uint32_t(micros);
+        }
+
+        /// @brief Same as GetMicrosUntilTicks, in cycles of a faster clock and rounded down instead
+        /// @param ticks whole tick boundaries ahead (1 = the next one)
+        /// @param cyclesPerMicro cycles of the target clock per microsecond
+        /// @return cycles from now; UINT64_MAX when stopped
+        uint64_t GetCyclesUntilTicks(uint32_t ticks, uint32_t cyclesPerMicro) const
+        {
+            if(increment == 0) return UINT64_MAX;
+            if(ticks > 0xFFFF) ticks = 0xFFFF;
+            uint64_t remaining = (uint64_t(ticks) << PHASE_FRACTION_BITS) - (phase & ((1ULL << PHASE_FRACTION_BITS) - 1));
+            //split so remaining * cyclesPerMicro can't overflow
+            return (remaining / increment) * cyclesPerMicro + (remaining % increment) * cyclesPerMicro / increment;
+        }
+
+        /// @brief Ticks per microsecond, Q48
+        uint64_t GetIncrement() const { return increment; }
+        /// @brief How far the phase is past its last whole tick, Q48 ticks
+        uint64_t GetTickFraction() const { return phase & ((1ULL << PHASE_FRACTION_BITS) - 1); }
+};
@@ -0,0 +1,25 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "PhaseLockedLoop.hpp"
+
+void PhaseLockedLoop::Start(uint32_t initialFrequency)
+{
+    frequency = initialFrequency;
+    centerFrequency = initialFrequency;
+    frequencyRate = 0;
+    pulseCount = 0;
+    lockCount = 0;
+    glitchCount = 0;
+    lastErrorQ16 = 0;
+}
+
+void PhaseLockedLoop::Rebase()
+{
+    uint64_t wholeTicks = expectedPhase & 0xFFFF'FFFF'0000'0000ULL;
+    phase -= wholeTicks;
+    expectedPhase -= wholeTicks;
+}
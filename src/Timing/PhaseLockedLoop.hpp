@@ -0,0 +1,201 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Proportional gain, as a right shift: fraction of the phase error corrected over the next pulse
+#define PLL_KP_SHIFT 2
+/// Integral gain, as a right shift: fraction of the phase error folded into the center frequency
+#define PLL_KI_SHIFT 3
+/// Rate gain, as a right shift: fraction of the phase error folded into how fast the center frequency moves
+#define PLL_KR_SHIFT 8
+/// Largest residual phase error (fraction of a pulse, Q16) a pulse may have once locked; anything further is a glitch
+#define PLL_MAX_ERROR_Q16 (65536 / 4)
+/// Pulses in a row past PLL_MAX_ERROR_Q16 that are thrown away as glitches; the next one means the clock really moved
+#define PLL_GLITCH_PULSES 1
+/// Largest phase error (fraction of a pulse, Q16) taken out over the one pulse after a tempo step; keeps the NCO running
+#define PLL_MAX_STEP_Q16 (65536 * 3 / 4)
+/// Phase error (fraction of a pulse, Q16) under which the loop counts as locked
+#define PLL_LOCK_ERROR_Q16 (65536 / 16)
+/// Consecutive pulses under PLL_LOCK_ERROR_Q16 before the loop reports lock
+#define PLL_LOCK_PULSES 4
+
+/// @brief Digital phase locked loop that follows an external clock.
+/// @note The NCO is a 64 bit phase accumulator in Q32.32 ticks, advanced by a Q32 ticks-per-microsecond frequency.
+/// @note On each pulse the phase detector compares the NCO phase at the pulse's timestamp with where the pulse should
+/// @note land on the pulse grid. A PI loop filter then nudges the frequency, never the phase, so the phase it drives
+/// @note is continuous and only ever moves forward. A slow second integrator learns how fast the frequency is moving,
+/// @note so a tempo ramp is followed without the standing phase error a PI loop has on one (a fixed fraction of a
+/// @note pulse, tens of mS at 1 PPQN).
+class PhaseLockedLoop
+{
+    private:
+        /// @brief NCO phase in Q32.32 ticks
+        uint64_t phase = 0;
+        /// @brief NCO frequency actually in use, center frequency plus the proportional correction (Q32 ticks/uS)
+        uint32_t frequency = 0;
+        /// @brief Loop filter integrator: best estimate of the clock's real frequency (Q32 ticks/uS)
+        uint32_t centerFrequency = 0;
+        /// @brief Second integrator: how far centerFrequency moves each pulse (Q32 ticks/uS), i.e. the tempo's ramp
+        int32_t frequencyRate = 0;
+        /// @brief Phase the most recent pulse should have landed on (Q32.32 ticks)
+        uint64_t expectedPhase = 0;
+        /// @brief Phase distance between two pulses (Q32.32 ticks)
+        uint64_t ticksPerPulse = 0;
+        /// @brief Timestamp of the most recent pulse
+        uint64_t lastEdgeMicros = 0;
+        /// @brief Pulses since Start, saturating; the first two are used for acquisition
+        uint8_t pulseCount = 0;
+        /// @brief Consecutive pulses within PLL_LOCK_ERROR_Q16
+        uint8_t lockCount = 0;
+        /// @brief Consecutive pulses thrown away as glitches while locked
+        uint8_t glitchCount = 0;
+        /// @brief Phase error at the most recent pulse, as a fraction of a pulse (Q16)
+        int32_t lastErrorQ16 = 0;
+
+    public:
+        /// @brief Sets the pulse spacing, e.g. CHRONOS_TICKS_PER_QUARTER / 24 PPQN
+        /// @param ticksPerPulseQ32 ticks between two pulses, Q32.32
+        void SetTicksPerPulse(uint64_t ticksPerPulseQ32) { ticksPerPulse = ticksPerPulseQ32; }
+
+        /// @brief Starts acquiring a new clock. The next pulse defines the pulse grid.
+        /// @param initialFrequency frequency to run at until the second pulse measures the real one (Q32 ticks/uS)
+        void Start(uint32_t initialFrequency);
+
+        /// @brief Advances the NCO. Must be called before OnPulse for the same update.
+        /// @param deltaMicros microseconds since the last advance
+        void Advance(uint32_t deltaMicros) { phase += uint64_t(frequency) * deltaMicros; }
+
+        /// @brief Phase detector and loop filter; call once per incoming clock pulse
+        /// @tparam TICKS_PER_PULSE the pulse spacing (Q32.32 ticks) as a constant, so the divisions by it fold at
+        /// @tparam compile time; 0 to use the one from SetTicksPerPulse. A constant has to match that one.
+        /// @param edgeMicros timestamp of the pulse
+        /// @param nowMicros current time, i.e. the time the NCO phase was last advanced to
+        template <uint64_t TICKS_PER_PULSE = 0>
+        void OnPulse(uint64_t edgeMicros, uint64_t nowMicros);
+
+        /// @brief Moves the NCO and the pulse grid back by the same whole number of ticks, so the phase restarts
+        /// @brief near zero without losing the loop's error state. Used on reset.
+        void Rebase();
+
+        /// @brief Whole ticks of NCO phase; wraps, so use differences
+        uint32_t GetTicks() const { return uint32_t(phase >> 32); }
+        /// @brief How far the NCO is past its last whole tick (Q32 ticks)
+        uint32_t GetTickFraction() const { return uint32_t(phase); }
+        /// @brief Time until the NCO has crossed the n-th whole tick boundary ahead, rounded up; UINT32_MAX when stopped
+        uint32_t GetMicrosUntilTicks(uint32_t ticks) const
+        {
+            if(frequency == 0) return UINT32_MAX;
+            uint64_t remaining = (uint64_t(ticks) << 32) - (phase & 0xFFFF'FFFFULL);
+            uint64_t micros = (remaining + frequency - 1) / frequency;
+            return micros > UINT32_MAX ? UINT32_MAX : uint32_t(micros);
+        }
+        /// @brief Time until the NCO has crossed the n-th whole tick boundary ahead, in cycles of a faster clock and
+        /// @brief rounded down; UINT64_MAX when stopped
+        uint64_t GetCyclesUntilTicks(uint32_t ticks, uint32_t cyclesPerMicro) const
+        {
+            if(frequency == 0) return UINT64_MAX;
+            uint64_t remaining = (uint64_t(ticks) << 32) - (phase & 0xFFFF'FFFFULL);
+            return (remaining / frequency) * cyclesPerMicro + (remaining % frequency) * cyclesPerMicro / frequency;
+        }
+        /// @brief Whole ticks the NCO has moved on from where the most recent pulse belongs on the pulse grid
+        /// @note Negative while the NCO hasn't got there yet (it is running behind the clock)
+        int32_t GetTicksSincePulse() const { return int32_t(int64_t(phase - expectedPhase) >> 32); }
+        /// @brief Current NCO frequency (Q32 ticks/uS)
+        uint32_t GetFrequency() const { return frequency; }
+        /// @brief True once the phase error has stayed small for PLL_LOCK_PULSES pulses
+        bool IsLocked() const { return lockCount >= PLL_LOCK_PULSES; }
+        /// @brief Phase error at the most recent pulse, as a fraction of a pulse (Q16, positive = NCO behind)
+        int32_t GetPhaseErrorQ16() const { return lastErrorQ16; }
+};
+
+template <uint64_t TICKS_PER_PULSE>
+void PhaseLockedLoop::OnPulse(uint64_t edgeMicros, uint64_t nowMicros)
+{
+    const uint64_t spacing = TICKS_PER_PULSE ? TICKS_PER_PULSE : ticksPerPulse;
+
+    //NCO phase at the moment of the edge, which may have been up to an update ago
+    uint64_t phaseAtEdge = phase - uint64_t(frequency) * (nowMicros - edgeMicros);
+
+    //-------- Acquisition --------
+
+    if(pulseCount == 0)
+    {
+        //first pulse: put the pulse grid wherever the NCO is, so nothing jumps
+        expectedPhase = phaseAtEdge;
+        lastEdgeMicros = edgeMicros;
+        pulseCount = 1;
+        return;
+    }
+    uint64_t interval = edgeMicros - lastEdgeMicros;
+    if(pulseCount == 1)
+    {
+        //second pulse: measure the real frequency directly instead of waiting for the integrator to find it
+        if(interval > 0) centerFrequency = uint32_t(spacing / interval);
+    }
+    lastEdgeMicros = edgeMicros;
+    if(pulseCount < UINT8_MAX) pulseCount++;
+
+    //-------- Phase Detector --------
+
+    uint64_t previousExpectedPhase = expectedPhase;
+    expectedPhase += spacing;
+    int64_t error = int64_t(expectedPhase - phaseAtEdge);
+    int64_t maxError = int64_t(spacing) * 8;
+    error = error > maxError ? maxError : (error < -maxError ? -maxError : error);
+    //error * 65536 / spacing, without the multiply overflowing at coarse PPQNs
+    int32_t errorQ16 = int32_t(error / int64_t(spacing >> 16));
+
+    //whole pulse slips (a missed pulse, or the NCO running far off during acquisition) move the grid, not the NCO
+    int32_t slip = (errorQ16 + (errorQ16 >= 0 ? 32768 : -32768)) / 65536;
+    int32_t residualQ16 = errorQ16 - slip * 65536;
+    if(IsLocked() && abs(residualQ16) > PLL_MAX_ERROR_Q16)
+    {
+        if(glitchCount < PLL_GLITCH_PULSES)
+        {
+            //pulse far off the grid while locked: a doubled pulse or a glitch, don't count it
+            glitchCount++;
+            expectedPhase = previousExpectedPhase;
+            return;
+        }
+        //off the grid again: the tempo has stepped. On a 3/4 or 3/2 step every third pulse still lands on the old grid,
+        //so waiting for the error to settle would hold the old tempo for good. The pulses thrown away were pulses of the
+        //new tempo, not slips, so count them; then drop lock, measure the new tempo from this pulse and the one before,
+        //and run the NCO onto the next pulse instead of easing it there
+        expectedPhase = previousExpectedPhase + uint64_t(glitchCount + 1) * spacing;
+        int64_t stepError = int64_t(expectedPhase - phaseAtEdge) / int64_t(spacing >> 16);
+        if(stepError > PLL_MAX_STEP_Q16) stepError = PLL_MAX_STEP_Q16;
+        if(stepError < -PLL_MAX_STEP_Q16) stepError = -PLL_MAX_STEP_Q16;
+        int32_t stepErrorQ16 = int32_t(stepError);
+        glitchCount = 0;
+        lockCount = 0;
+        frequencyRate = 0;
+        if(interval > 0) centerFrequency = uint32_t(spacing / interval);
+        frequency = centerFrequency + int32_t((int64_t(centerFrequency) * stepErrorQ16) >> 16);
+        lastErrorQ16 = stepErrorQ16;
+        return;
+    }
+    glitchCount = 0;
+    expectedPhase -= uint64_t(int64_t(slip)) * spacing;
+    lastErrorQ16 = residualQ16;
+
+    //-------- Loop Filter --------
+
+    //positive error means the NCO is behind, so speed up. The second pulse's error is left over from acquisition,
+    //not a ramp, so the rate only learns from the pulses after it
+    if(pulseCount > 2) frequencyRate += int32_t((int64_t(centerFrequency) * residualQ16) >> (16 + PLL_KR_SHIFT));
+    centerFrequency += frequencyRate + int32_t((int64_t(centerFrequency) * residualQ16) >> (16 + PLL_KI_SHIFT));
+    frequency = centerFrequency + int32_t((int64_t(centerFrequency) * residualQ16) >> (16 + PLL_KP_SHIFT));
+
+    if(abs(residualQ16) < PLL_LOCK_ERROR_Q16)
+    {
+        if(lockCount < UINT8_MAX) lockCount++;
+    }
+    else lockCount = 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Longest rhythm pattern; patterns are stored as one bit per step
+#define RHYTHM_MAX_STEPS 64
+
+/// @brief Builds rhythm patterns for the gate outs, as bitsets: bit s set means step s plays.
+/// @note Only used when settings change (it loops over the steps), never per tick.
+class RhythmPattern
+{
+    public:
+        /// @brief All the steps of a pattern, as a mask
+        /// @param steps pattern length, 1 to RHYTHM_MAX_STEPS
+        static uint64_t StepMask(uint32_t steps)
+        {
+            return steps >= RHYTHM_MAX_STEPS ? ~uint64_t(0) : (uint64_t(1) << steps) - 1;
+        }
+
+        /// @brief Starts a pattern partway through
+        /// @param pattern bitset, step 0 in bit 0
+        /// @param steps pattern length, 1 to RHYTHM_MAX_STEPS
+        /// @param rotation steps to skip; step s of the result is step (s + rotation) % steps of the pattern
+        static uint64_t Rotate(uint64_t pattern, uint32_t steps, uint32_t rotation)
+        {
+            pattern &= StepMask(steps);
+            rotation %= steps;
+            if(rotation == 0) return pattern;
+            return ((pattern >> rotation) | (pattern << (steps - rotation))) & StepMask(steps);
+        }
+
+        /// @brief Spreads pulses as evenly as possible over steps, with Bjorklund's algorithm
+        /// @note Gives the same sequences as Toussaint's "The Euclidean Algorithm Generates Traditional Musical
+        /// @note Rhythms", e.g. E(3,8) = x..x..x. and E(5,8) = x.xx.xx.; the first step always plays
+        /// @param steps pattern length, 1 to RHYTHM_MAX_STEPS (clamped)
+        /// @param pulses steps that play (clamped to steps)
+        /// @param rotation see Rotate
+        static uint64_t Euclidean(uint32_t steps, uint32_t pulses, uint32_t rotation)
+        {
+            if(steps < 1) steps = 1;
+            if(steps > RHYTHM_MAX_STEPS) steps = RHYTHM_MAX_STEPS;
+            if(pulses == 0) return 0;
+            if(pulses >= steps) return StepMask(steps);
+
+            //each group is a run of steps, first step in bit 0. Start with pulses groups of "x" and the rest of "."
+            //then keep appending the back groups to the front ones until at most one back group is left over
+            uint64_t groups[RHYTHM_MAX_STEPS];
+            uint8_t lengths[RHYTHM_MAX_STEPS];
+            for(uint32_t i = 0; i < steps; i++)
+            {
+                groups[i] = i < pulses ? 1 : 0;
+                lengths[i] = 1;
+            }
+            uint32_t frontCount = pulses;
+            uint32_t backCount = steps - pulses;
+            do
+            {
+                uint32_t pairs = frontCount < backCount ? frontCount : backCount;
+                for(uint32_t i = 0; i < pairs; i++)
+                {
+                    groups[i] |= groups[frontCount + i] << lengths[i];
+                    lengths[i] += lengths[frontCount + i];
+                }
+                //whichever side had groups left over becomes the new back
+                uint32_t leftover = frontCount > backCount ? frontCount - backCount : backCount - frontCount;
+                uint32_t from = frontCount > backCount ? pairs : frontCount + pairs;
+                for(uint32_t i = 0; i < leftover; i++)
+                {
+                    groups[pairs + i] = groups[from + i];
+                    lengths[pairs + i] = lengths[from + i];
+                }
+                frontCount = pairs;
+                backCount = leftover;
+            } while(backCount > 1);
+
+            uint64_t pattern = 0;
+            uint32_t length = 0;
+            for(uint32_t i = 0; i < frontCount + backCount; i++)
+            {
+                pattern |= groups[i] << length;
+                length += lengths[i];
+            }
+            return Rotate(pattern, steps, rotation);
+        }
+};
@@ -0,0 +1,91 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// Entries in one cycle of the swing curve table, as a power of two
+#define SWING_TABLE_BITS 8
+#define SWING_TABLE_SIZE (1 << SWING_TABLE_BITS)
+/// Depth of the swing curve on a 0-65535 bar, divided by the swings per bar (found experimentally, see SwingWarp)
+#define SWING_DEPTH 9300
+
+/// @brief One cycle of the swing curve, (1 - cos) / 2 in Q16, built at compile time.
+/// @note Has one extra entry so interpolation never has to wrap.
+struct SwingWarpTable
+{
+    uint32_t values[SWING_TABLE_SIZE + 1];
+
+    /// @brief Taylor series cosine, accurate to well under one Q16 step over [0, 2pi]
+    static constexpr double Cos(double x)
+    {
+        const double pi = 3.14159265358979323846;
+        if(x > pi) x -= 2 * pi;
+        double term = 1;
+        double sum = 1;
+        for(int n = 1; n < 20; n++)
+        {
+            term *= -x * x / double((2 * n - 1) * (2 * n));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr SwingWarpTable() : values()
+    {
+        const double pi = 3.14159265358979323846;
+        for(int i = 0; i <= SWING_TABLE_SIZE; i++)
+        {
+            values[i] = uint32_t((1 - Cos(2 * pi * i / SWING_TABLE_SIZE)) / 2 * 65536 + 0.5);
+        }
+    }
+};
+
+static constexpr SwingWarpTable swingWarpTable;
+
+/// @brief Bends musical time into a swing feel, all in integer math.
+/// @note The curve was found experimentally on desmos. With N swings per bar and X, Y from 0-65535 over a bar:
+/// @note y = x + cos(x / (65535 / (2pi * N))) * (9300 / N) - 9300 / N
+/// @note It is read from swingWarpTable with linear interpolation, so any number of swings per bar costs the same.
+/// @note The caller keeps the position within the bar, so nothing here divides a (64 bit) musical time.
+class SwingWarp
+{
+    private:
+        /// @brief Swing cycles per tick, Q32; multiplying the position in the bar wraps into the cycle's phase
+        uint32_t phaseStep = 0;
+        /// @brief Full depth of the curve in ticks, Q8
+        uint32_t depthQ8 = 0;
+
+    public:
+        /// @brief Sets the number of swing cycles per bar (slow, uses float)
+        /// @param swingsPerBar swing cycles per whole note, at least 1
+        /// @param ticksPerBar time base ticks per whole note
+        void SetSwingsPerBar(float swingsPerBar, uint32_t ticksPerBar)
+        {
+            if(swingsPerBar < 1) swingsPerBar = 1;
+            phaseStep = uint32_t(double(swingsPerBar) * 4294967296.0 / ticksPerBar + 0.5);
+            //peak to trough is 2 * SWING_DEPTH / N on the 65535 scale, i.e. / 128 in 512th notes
+            depthQ8 = uint32_t(2.0 * SWING_DEPTH * 2.0 / swingsPerBar * ticksPerBar / 512.0 + 0.5);
+        }
+
+        /// @brief How far swing holds back a musical time
+        /// @param barTicks position within the bar, 0 to ticksPerBar - 1
+        /// @param amount swing amount, 0 (straight) to 4096 (full curve)
+        /// @return ticks to subtract from the time; 0 on every swing cycle boundary
+        uint32_t GetDelay(uint32_t barTicks, uint32_t amount) const
+        {
+            uint32_t phase = barTicks * phaseStep; //wraps to the phase within the current swing cycle
+            uint32_t index = phase >> (32 - SWING_TABLE_BITS);
+            int32_t fraction = (phase >> (16 - SWING_TABLE_BITS)) & 0xFFFF;
+            int32_t a = swingWarpTable.values[index];
+            int32_t b = swingWarpTable.values[index + 1];
+            uint32_t warp = uint32_t(a + (((b - a) * fraction) >> 16));
+            uint32_t offsetQ8 = uint32_t((uint64_t(warp) * depthQ8) >> 16);
+            //round the delay up, so a swung edge never lands early
+            return uint32_t((uint64_t(offsetQ8) * amount + (1UL << 20) - 1) >> 20);
+        }
+};
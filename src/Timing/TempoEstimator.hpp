@@ -0,0 +1,133 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Tolerance floor for outlier rejection, as a right shift of the expected interval (1/32 = ~3%)
+#define TEMPO_TOLERANCE_SHIFT 5
+/// Outlier threshold, in multiples of the running mean absolute deviation
+#define TEMPO_MAD_MULT 4
+/// Consecutive, mutually consistent outliers before they are treated as a tempo step and the window is flushed
+#define TEMPO_STEP_COUNT 3
+
+/// @brief Constant-time estimator of the interval between incoming clock pulses.
+/// @note Keeps a running sum over a window of accepted intervals, so each pulse costs a handful of integer
+/// @note operations and a single (hardware) divide. Intervals further from the average than a multiple of the running
+/// @note mean absolute deviation are rejected, so a late, missing or doubled pulse never reaches the average. When the
+/// @note median of the last three raw intervals agrees with a run of rejected ones, the tempo really has changed and
+/// @note the window starts over from the new interval.
+/// @tparam WINDOW number of intervals averaged
+template <uint16_t WINDOW>
+class TempoEstimator
+{
+    public:
+        /// @brief Longest interval stored (longer ones are clamped), so the x16 sum of a full window stays under 2^32
+        static const uint32_t MAX_INTERVAL = ((1UL << 28) - 1) / WINDOW;
+
+    private:
+        /// @brief Circular buffer of accepted intervals, in microseconds
+        uint32_t intervals[WINDOW];
+        /// @brief Write pointer for intervals
+        uint16_t writeIndex = 0;
+        /// @brief Number of valid entries in intervals
+        uint16_t count = 0;
+        /// @brief Sum of the valid entries in intervals
+        uint32_t sum = 0;
+
+        /// @brief The last three raw (unfiltered) intervals, used for the median
+        uint32_t recent[3] = {0, 0, 0};
+        /// @brief Number of valid entries in recent
+        uint8_t recentCount = 0;
+        /// @brief Running mean absolute deviation of accepted intervals from the average, in microseconds x16
+        uint32_t deviation16 = 0;
+        /// @brief Consecutive intervals rejected as outliers
+        uint8_t rejectCounter = 0;
+
+        /// @brief Current estimate in microseconds x16, published for readers on other contexts. 0 while there is no estimate.
+        volatile uint32_t period16 = 0;
+
+        static uint32_t Median3(uint32_t a, uint32_t b, uint32_t c)
+        {
+            if(a > b) { uint32_t t = a; a = b; b = t; }
+            if(b > c) b = c;
+            return a > b ? a : b;
+        }
+
+        void Store(uint32_t interval)
+        {
+            if(count == WINDOW) sum -= intervals[writeIndex];
+            else count++;
+            intervals[writeIndex] = interval;
+            sum += interval;
+            writeIndex++;
+            if(writeIndex >= WINDOW) writeIndex = 0;
+            period16 = (sum << 4) / count;
+        }
+
+    public:
+        /// @brief Forgets every interval, e.g. when the clock source restarts
+        void Clear()
+        {
+            writeIndex = 0;
+            count = 0;
+            sum = 0;
+            recentCount = 0;
+            deviation16 = 0;
+            rejectCounter = 0;
+            period16 = 0;
+        }
+
+        /// @brief Adds the time between two consecutive clock pulses
+        /// @param interval microseconds since the previous pulse
+        /// @return false if the interval was rejected as an outlier
+        bool AddInterval(uint32_t interval)
+        {
+            if(interval > MAX_INTERVAL) interval = MAX_INTERVAL;
+
+            recent[2] = recent[1];
+            recent[1] = recent[0];
+            recent[0] = interval;
+            if(recentCount < 3) recentCount++;
+
+            //no estimate to judge against yet, trust everything
+            uint32_t average = period16 >> 4;
+            if(count == 0)
+            {
+                Store(interval);
+                return true;
+            }
+
+            uint32_t error = uint32_t(abs(int32_t(interval - average)));
+            uint32_t floor = average >> TEMPO_TOLERANCE_SHIFT;
+            uint32_t tolerance = TEMPO_MAD_MULT * (deviation16 >> 4);
+            if(tolerance < floor) tolerance = floor;
+
+            if(error > tolerance)
+            {
+                //a run of outliers that agree with each other is a tempo step, not noise: start over from here
+                rejectCounter++;
+                uint32_t median = Median3(recent[0], recent[1], recent[2]);
+                bool isConsistent = recentCount == 3 && uint32_t(abs(int32_t(interval - median))) <= (median >> TEMPO_TOLERANCE_SHIFT);
+                if(rejectCounter < TEMPO_STEP_COUNT || !isConsistent) return false;
+                writeIndex = 0;
+                count = 0;
+                sum = 0;
+                deviation16 = 0;
+                error = 0;
+            }
+            rejectCounter = 0;
+
+            deviation16 += (error << 4) / 8 - deviation16 / 8; //EWMA, 1/8 weight
+            Store(interval);
+            return true;
+        }
+
+        /// @brief Average interval between pulses in microseconds x16, 0 if there is no estimate yet
+        uint32_t GetPeriodMicros16() const { return period16; }
+};
@@ -0,0 +1,106 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "PhaseAccumulator.hpp"
+
+/// Fractional bits of the glide factor, the share of the way to the target covered per microsecond
+#define TEMPO_GLIDE_FACTOR_BITS 32
+
+/// @brief Where a tempo change is allowed to start
+enum TempoQuantize : uint8_t
+{
+    TEMPO_QUANTIZE_OFF,
+    TEMPO_QUANTIZE_BEAT,
+    TEMPO_QUANTIZE_BAR
+};
+
+/// @brief Slews a time base increment (Q48 ticks/uS, see PhaseAccumulator) toward a target, in integer math only.
+/// @note Each Advance covers deltaMicros / glide time of the way still to go, which makes a first order glide: 63% of
+/// @note a step in one glide time, 99% in under five. An optional limit then caps how far the increment may move per
+/// @note microsecond, so a big step turns into a straight ramp. Both are worked out in the slow path (FactorForGlide,
+/// @note MaxStepForRate); Advance is two multiplies and a shift. The increment only ever changes between advances
+/// @note and the phase is never touched, so the tempo bends and the musical time never jumps.
+class TempoGlide
+{
+    private:
+        /// @brief Increment now, Q48 ticks/uS
+        uint64_t increment = 0;
+        /// @brief Increment being glided toward, Q48 ticks/uS
+        uint64_t target = 0;
+        /// @brief Share of the distance to the target covered per microsecond, Q32; 0 to step straight to it
+        uint32_t factor = 0;
+        /// @brief Most the increment moves per microsecond, Q48 ticks/uS; 0 for no limit
+        uint64_t maxStep = 0;
+
+    public:
+        /// @brief Glide factor for a glide time. Slow path.
+        /// @param glideMicros time to cover 63% of a change, 0 to step
+        static uint32_t FactorForGlide(uint32_t glideMicros)
+        {
+            return glideMicros <= 1 ? 0 : uint32_t((1ULL << TEMPO_GLIDE_FACTOR_BITS) / glideMicros);
+        }
+
+        /// @brief Rate limit for a most BPM per second. Uses double precision, so keep it out of the fast path.
+        /// @param bpmPerSecond fastest the tempo may change, 0 for no limit
+        /// @param ticksPerQuarter ticks per quarter note
+        static uint64_t MaxStepForRate(float bpmPerSecond, uint32_t ticksPerQuarter)
+        {
+            if(bpmPerSecond <= 0) return 0;
+            uint64_t step = PhaseAccumulator::IncrementForBPM(bpmPerSecond, ticksPerQuarter) / 1'000'000;
+            return step > 0 ? step : 1;
+        }
+
+        /// @brief Sets how changes are taken up
+        /// @param glideFactor see FactorForGlide
+        /// @param maxStepPerMicro see MaxStepForRate
+        void SetGlide(uint32_t glideFactor, uint64_t maxStepPerMicro)
+        {
+            factor = glideFactor;
+            maxStep = maxStepPerMicro;
+        }
+
+        /// @brief Starts gliding toward a new increment from wherever the glide is now
+        void SetTarget(uint64_t ticksPerMicroQ48) { target = ticksPerMicroQ48; }
+
+        /// @brief Goes straight to an increment, with nothing left to glide
+        void Jump(uint64_t ticksPerMicroQ48) { increment = target = ticksPerMicroQ48; }
+
+        /// @brief Moves the increment on by some time
+        /// @param deltaMicros time the glide has been running for since the last advance
+        /// @return the increment to run at until the next advance
+        /// @note Increments must stay under 2^48 (about 4000BPM at CHRONOS_TICKS_PER_QUARTER) for the multiply to fit
+        uint64_t Advance(uint32_t deltaMicros)
+        {
+            if(increment == target) return increment;
+            uint64_t distance = target > increment ? target - increment : increment - target;
+            uint64_t step = distance;
+            if(factor > 0)
+            {
+                uint64_t fraction = uint64_t(factor) * deltaMicros;    //Q32, 1 or more covers the rest
+                if(fraction < (1ULL << TEMPO_GLIDE_FACTOR_BITS))
+                {
+                    step = ((distance >> 16) * fraction) >> (TEMPO_GLIDE_FACTOR_BITS - 16);
+                    if(step == 0) step = distance; //close enough that the rest rounds away
+                }
+            }
+            if(maxStep > 0)
+            {
+                uint64_t limit = maxStep * deltaMicros;
+                if(step > limit) step = limit;
+            }
+            increment = target > increment ? increment + step : increment - step;
+            return increment;
+        }
+
+        /// @brief Increment now, Q48 ticks/uS
+        uint64_t GetIncrement() const { return increment; }
+        /// @brief Increment being glided toward, Q48 ticks/uS
+        uint64_t GetTarget() const { return target; }
+        bool IsGliding() const { return increment != target; }
+};
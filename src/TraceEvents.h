@@ -0,0 +1,28 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+/// Every trace point: TRACE_EVENT(name, format). An event's ID is its place in the list, and tools/trace_decode.py
+/// reads the formats straight from this file, so keep one event per line and only ever add to the end.
+/// Formats take printf integer conversions only (the arguments are 32 bit ints).
+#define TRACE_EVENTS(TRACE_EVENT) \
+    TRACE_EVENT(TRACE_DROPPED,          "%d records lost, the trace ring was full") \
+    TRACE_EVENT(TRACE_SET_BPM,          "SetBPM %d.%03d BPM, clock in keepalive %d uS") \
+    TRACE_EVENT(TRACE_FOLLOW_START,     "following clock source %d (0 CLOCK IN, 1 USB MIDI)") \
+    TRACE_EVENT(TRACE_FOLLOW_LOST,      "clock lost, no pulse for %d uS") \
+    TRACE_EVENT(TRACE_RESET,            "reset from tick %d of the bar, %d uS after RESET IN") \
+    TRACE_EVENT(TRACE_MIDI_IN,          "USB MIDI in 0x%02X, next clock at song tick %d") \
+    TRACE_EVENT(TRACE_MIDI_OUT_DROPPED, "USB MIDI out refused 0x%02X, %d so far")
+
+#define TRACE_EVENT_ENUM(name, format) name,
+
+/// @brief Trace event IDs, see TRACE_EVENTS
+enum TraceEvent
+{
+    TRACE_EVENTS(TRACE_EVENT_ENUM)
+    TRACE_EVENT_COUNT
+};
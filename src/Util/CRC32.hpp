@@ -0,0 +1,28 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief Standard CRC-32 (IEEE 802.3, as used by zlib), bit by bit. Small and slow; meant for stored records, not
+/// @brief streams.
+/// @param data bytes to check
+/// @param length number of bytes
+/// @return the CRC
+inline uint32_t CRC32(const uint8_t *data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for(uint32_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
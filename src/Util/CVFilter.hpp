@@ -0,0 +1,130 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Fractional bits the filters keep internally, so slow settling doesn't stall on integer truncation
+#define CV_FILTER_FRACTION_BITS 8
+
+/// @brief Integer smoothing filters for CV and knob inputs, picked per channel at compile time.
+/// @note Every filter has the same interface, so they can be swapped or chained with FilterChain:
+/// @note   int32_t Process(int32_t x)  takes the next sample and returns the new output
+/// @note   void    Reset(int32_t x)    jumps straight to a steady input of x
+/// @note   int32_t Get()               the current output
+/// @note Samples are raw ADC values or anything else that fits comfortably in 20 bits.
+
+/// @brief Plain one-pole low-pass: y += (x - y) / 2^SHIFT
+/// @tparam SHIFT time constant, as a power of two of samples
+template <uint8_t SHIFT>
+class OnePoleFilter
+{
+    private:
+        int32_t y = 0;
+
+    public:
+        int32_t Process(int32_t x)
+        {
+            y += ((x << CV_FILTER_FRACTION_BITS) - y) >> SHIFT;
+            return Get();
+        }
+        void Reset(int32_t x) { y = x << CV_FILTER_FRACTION_BITS; }
+        int32_t Get() const { return (y + (1 << (CV_FILTER_FRACTION_BITS - 1))) >> CV_FILTER_FRACTION_BITS; }
+};
+
+/// @brief Adaptive one-pole in the spirit of the 1 Euro filter: heavy smoothing while the input sits still, opening up
+/// @brief as it starts to move, so noise is crushed without making real changes lag.
+/// @note The speed estimate is a smoothed distance between the input and the output. The filter coefficient is
+/// @note 2^-MIN_SHIFT plus that distance scaled by 2^-BETA_SHIFT of a sample per LSB, up to 1 (no filtering).
+/// @tparam MIN_SHIFT smoothing at rest, as a power of two of samples
+/// @tparam BETA_SHIFT how quickly the filter opens up with speed; lower opens faster
+/// @tparam SPEED_SHIFT smoothing of the speed estimate, as a power of two of samples
+template <uint8_t MIN_SHIFT, uint8_t BETA_SHIFT, uint8_t SPEED_SHIFT = 2>
+class AdaptiveFilter
+{
+    private:
+        /// @brief Output, with CV_FILTER_FRACTION_BITS
+        int32_t y = 0;
+        /// @brief Smoothed |x - y|, with CV_FILTER_FRACTION_BITS
+        int32_t speed = 0;
+
+    public:
+        int32_t Process(int32_t x)
+        {
+            int32_t difference = (x << CV_FILTER_FRACTION_BITS) - y;
+            speed += (abs(difference) - speed) >> SPEED_SHIFT;
+
+            //coefficient in Q16: the resting minimum plus the speed term, saturating at 1
+            uint32_t alpha = (65536u >> MIN_SHIFT) + (uint32_t(speed) << (16 - CV_FILTER_FRACTION_BITS) >> BETA_SHIFT);
+            if(alpha >= 65536u) y += difference;
+            else y += int32_t((int64_t(difference) * alpha) >> 16);
+            return Get();
+        }
+        void Reset(int32_t x)
+        {
+            y = x << CV_FILTER_FRACTION_BITS;
+            speed = 0;
+        }
+        int32_t Get() const { return (y + (1 << (CV_FILTER_FRACTION_BITS - 1))) >> CV_FILTER_FRACTION_BITS; }
+};
+
+/// @brief Median of the last N samples; removes isolated spikes completely and passes clean steps with (N-1)/2 samples
+/// @brief of delay
+/// @tparam N window length, odd and small (sorted by insertion every sample)
+template <uint8_t N>
+class MedianFilter
+{
+    static_assert(N % 2 == 1, "MedianFilter needs an odd window");
+
+    private:
+        int32_t window[N] = {};
+        uint8_t index = 0;
+        int32_t median = 0;
+
+    public:
+        int32_t Process(int32_t x)
+        {
+            window[index] = x;
+            index = index + 1 >= N ? 0 : index + 1;
+
+            int32_t sorted[N];
+            for(uint8_t i = 0; i < N; i++)
+            {
+                int32_t value = window[i];
+                int8_t j = int8_t(i) - 1;
+                for(; j >= 0 && sorted[j] > value; j--) sorted[j + 1] = sorted[j];
+                sorted[j + 1] = value;
+            }
+            median = sorted[N / 2];
+            return median;
+        }
+        void Reset(int32_t x)
+        {
+            for(uint8_t i = 0; i < N; i++) window[i] = x;
+            median = x;
+        }
+        int32_t Get() const { return median; }
+};
+
+/// @brief Runs two filters in series, e.g. a median to remove spikes ahead of a smoothing filter
+template <typename FIRST, typename SECOND>
+class FilterChain
+{
+    private:
+        FIRST first;
+        SECOND second;
+
+    public:
+        int32_t Process(int32_t x) { return second.Process(first.Process(x)); }
+        void Reset(int32_t x)
+        {
+            first.Reset(x);
+            second.Reset(x);
+        }
+        int32_t Get() const { return second.Get(); }
+};
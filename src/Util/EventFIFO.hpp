@@ -0,0 +1,77 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/// @brief Lock-free single-producer/single-consumer FIFO of small events (timestamps, messages).
+/// @note Safe between an interrupt handler (producer) and the code it interrupts (consumer), or between the two cores.
+/// @note Each index is only ever written by one side, so no read-modify-write atomics are needed (the M0+ has none).
+/// @tparam T event type, copied in and out
+/// @tparam SIZE capacity, must be a power of two
+template <typename T, uint32_t SIZE>
+class EventFIFO
+{
+    static_assert((SIZE & (SIZE - 1)) == 0, "EventFIFO size must be a power of two");
+
+    private:
+        T buffer[SIZE];
+        /// @brief Write index, only written by the producer. Free-running; wrapped with a mask on access.
+        std::atomic<uint32_t> head{0};
+        /// @brief Read index, only written by the consumer. Free-running; wrapped with a mask on access.
+        std::atomic<uint32_t> tail{0};
+        /// @brief Number of events dropped because the FIFO was full
+        std::atomic<uint32_t> overflows{0};
+
+    public:
+        /// @brief Adds an event. Producer side only.
+        /// @return false if the FIFO was full and the event was dropped
+        bool Push(const T &event)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) >= SIZE)
+            {
+                overflows.store(overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            buffer[h & (SIZE - 1)] = event;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief Removes the oldest event. Consumer side only.
+        /// @param event written with the oldest event, if there was one
+        /// @return false if the FIFO was empty
+        bool Pop(T *event)
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)) return false;
+            *event = buffer[t & (SIZE - 1)];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief True if there is nothing waiting. Safe from either side.
+        bool IsEmpty() const
+        {
+            return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+        }
+
+        /// @brief Discards everything waiting. Consumer side only.
+        void Clear()
+        {
+            tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        /// @brief Number of events dropped because the consumer fell behind
+        uint32_t GetOverflowCount() const { return overflows.load(std::memory_order_relaxed); }
+};
+
+/// @brief FIFO of microsecond timestamps, e.g. gate in edges
+template <uint32_t SIZE>
+using TimestampFIFO = EventFIFO<uint64_t, SIZE>;
@@ -0,0 +1,40 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief Small deterministic random numbers for the fast path: no rand(), no floats, no state to keep in sync.
+/// @note Values are a pure function of (seed, stream, counter), so the same seed gives the same sequence every time,
+/// @note and any point of it can be looked up directly, e.g. after a reset or when time steps backwards.
+/// @note The mixing is the PCG hash (one LCG step and PCG's RXS-M-XS output permutation), applied twice.
+class FastRandom
+{
+    public:
+        /// @brief One round of the PCG hash
+        static uint32_t Hash(uint32_t input)
+        {
+            uint32_t state = input * 747796405u + 2891336453u;
+            uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+            return (word >> 22u) ^ word;
+        }
+
+        /// @brief A random 32 bit value
+        /// @param seed sequence seed
+        /// @param stream independent sequence under the same seed (e.g. an output number)
+        /// @param counter position in the sequence (e.g. a cycle count)
+        static uint32_t Get(uint32_t seed, uint32_t stream, uint32_t counter)
+        {
+            return Hash(Hash(counter) ^ (seed + stream * 0x9E3779B9u));
+        }
+
+        /// @brief Scales a random value to 0 to range - 1 with a multiply instead of a modulo
+        static uint32_t Scale(uint32_t random, uint32_t range)
+        {
+            return uint32_t((uint64_t(random) * range) >> 32);
+        }
+};
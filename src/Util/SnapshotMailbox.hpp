@@ -0,0 +1,68 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+/// @brief Lock-free single-producer/single-consumer mailbox holding the latest snapshot of a struct (a seqlock).
+/// @note The writer makes the sequence number odd, copies the snapshot in and makes it even again; a reader copies the
+/// @note snapshot out and only keeps it if the sequence number was even and unchanged around the copy, so it never
+/// @note sees a half-written snapshot. Writers never wait. The snapshot is stored as relaxed atomic words, so the
+/// @note racing copies are well defined, and no read-modify-write atomics are needed (the M0+ has none).
+/// @tparam T trivially copyable snapshot type
+template <typename T>
+class SnapshotMailbox
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SnapshotMailbox needs a trivially copyable type");
+
+    private:
+        static const uint32_t NUM_WORDS = (sizeof(T) + 3) / 4;
+
+        /// @brief Odd while a write is in progress; only written by the producer
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint32_t> words[NUM_WORDS] = {};
+
+    public:
+        /// @brief Publishes a new snapshot. Producer side only.
+        void Write(const T &snapshot)
+        {
+            uint32_t buffer[NUM_WORDS] = {};
+            memcpy(buffer, &snapshot, sizeof(T));
+            uint32_t s = sequence.load(std::memory_order_relaxed);
+            sequence.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for(uint32_t i = 0; i < NUM_WORDS; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+            sequence.store(s + 2, std::memory_order_release);
+        }
+
+        /// @brief Makes one attempt at reading the latest snapshot, so it never waits on the writer. Consumer side only.
+        /// @param snapshot written with the latest snapshot, only if the read was consistent
+        /// @return false if a write was in progress; try again later and keep using the previous snapshot meanwhile
+        bool TryRead(T *snapshot) const
+        {
+            uint32_t buffer[NUM_WORDS];
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if(before & 1) return false;
+            for(uint32_t i = 0; i < NUM_WORDS; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(sequence.load(std::memory_order_relaxed) != before) return false;
+            memcpy(snapshot, buffer, sizeof(T));
+            return true;
+        }
+
+        /// @brief Reads the latest snapshot, retrying until it gets a consistent one. Consumer side only.
+        void Read(T *snapshot) const
+        {
+            while(!TryRead(snapshot)) {}
+        }
+
+        /// @brief Number of snapshots published so far
+        uint32_t GetVersion() const { return sequence.load(std::memory_order_acquire) / 2; }
+};
@@ -0,0 +1,109 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "TraceLog.hpp"
+#include "EventFIFO.hpp"
+#include "TraceEvents.h"
+
+namespace
+{
+    EventFIFO<TraceRecord, TRACE_RING_SIZE> rings[HAL_NUM_CORES];
+    /// @brief Records lost since the last one that got in, written by each ring's own core only
+    uint32_t lostSincePush[HAL_NUM_CORES] = {};
+
+    //consumer side (Drain) only
+    TraceRecord pending[HAL_NUM_CORES];
+    bool hasPending[HAL_NUM_CORES] = {};
+    /// @brief Core Drain serves first; takes turns so a busy core can't keep the other's records off a slow port
+    uint8_t firstCore = 0;
+    uint8_t drainBuffer[TRACE_DRAIN_BUFFER_SIZE];
+
+    void PutLittleEndian(uint8_t *bytes, uint64_t value, uint32_t length)
+    {
+        for(uint32_t i = 0; i < length; i++) bytes[i] = uint8_t(value >> (8 * i));
+    }
+}
+
+void TraceLog::Write(uint16_t id, uint8_t argCount, int32_t arg0, int32_t arg1, int32_t arg2)
+{
+    TraceRecord record;
+    record.timeMicros = HAL::TimeMicros();
+    record.id = id;
+    record.argCount = argCount;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    record.args[2] = arg2;
+
+    //each core only ever pushes to its own ring, so masking this core is enough to keep it single producer
+    uint32_t core = HAL::CoreNum();
+    uint32_t state = HAL::DisableInterrupts();
+    record.dropsBefore = lostSincePush[core];
+    if(rings[core].Push(record)) lostSincePush[core] = 0;
+    else                         lostSincePush[core]++;
+    HAL::RestoreInterrupts(state);
+}
+
+uint32_t TraceLog::Encode(const TraceRecord &record, uint8_t core, uint8_t *frame)
+{
+    frame[0] = TRACE_SYNC_0;
+    frame[1] = TRACE_SYNC_1;
+    frame[2] = uint8_t(core << 4 | record.argCount);
+    PutLittleEndian(frame + 3, record.id, 2);
+    PutLittleEndian(frame + 5, record.timeMicros, 8);
+    for(uint32_t i = 0; i < record.argCount; i++) PutLittleEndian(frame + 13 + 4 * i, uint32_t(record.args[i]), 4);
+
+    uint32_t length = TRACE_FRAME_SIZE(record.argCount);
+    uint8_t checksum = 0;
+    for(uint32_t i = 2; i < length - 1; i++) checksum += frame[i];
+    frame[length - 1] = checksum;
+    return length;
+}
+
+uint32_t TraceLog::Drain()
+{
+    uint32_t room = HAL::SerialWriteAvailable();
+    if(room > TRACE_DRAIN_BUFFER_SIZE) room = TRACE_DRAIN_BUFFER_SIZE;
+
+    uint32_t size = 0;
+    uint32_t sent = 0;
+    for(uint32_t turn = 0; turn < HAL_NUM_CORES; turn++)
+    {
+        uint8_t core = (firstCore + turn) % HAL_NUM_CORES;
+
+        //a record that didn't fit last time waits here, so nothing is popped until it can be sent
+        while(hasPending[core] || rings[core].Pop(&pending[core]))
+        {
+            TraceRecord &record = pending[core];
+            hasPending[core] = true;
+            uint32_t length = TRACE_FRAME_SIZE(record.argCount) + (record.dropsBefore > 0 ? TRACE_FRAME_SIZE(1) : 0);
+            if(size + length > room) break;
+            if(record.dropsBefore > 0)
+            {
+                //the gap goes just ahead of the record that ended it
+                TraceRecord report;
+                report.timeMicros = record.timeMicros;
+                report.id = TRACE_DROPPED;
+                report.argCount = 1;
+                report.args[0] = int32_t(record.dropsBefore);
+                size += Encode(report, core, drainBuffer + size);
+            }
+            size += Encode(record, core, drainBuffer + size);
+            hasPending[core] = false;
+            sent++;
+        }
+    }
+
+    firstCore = (firstCore + 1) % HAL_NUM_CORES;
+    if(size > 0) HAL::SerialWrite(drainBuffer, size);
+    return sent;
+}
+
+uint32_t TraceLog::GetDroppedCount()
+{
+    uint32_t drops = 0;
+    for(uint32_t core = 0; core < HAL_NUM_CORES; core++) drops += rings[core].GetOverflowCount();
+    return drops;
+}
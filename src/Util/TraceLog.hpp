@@ -0,0 +1,68 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "HAL/HAL.hpp"
+
+/// Records each core's trace ring holds; a power of two
+#define TRACE_RING_SIZE 128
+/// Most integer arguments one trace record carries
+#define TRACE_MAX_ARGS 3
+/// First two bytes of every trace frame on the serial port
+#define TRACE_SYNC_0 0xA5
+#define TRACE_SYNC_1 0x5A
+/// Bytes in a frame with a given number of arguments: sync, core and argument count, ID, timestamp, arguments, checksum
+#define TRACE_FRAME_SIZE(args) (2 + 1 + 2 + 8 + 4 * (args) + 1)
+/// Most bytes Drain hands the serial port in one write
+#define TRACE_DRAIN_BUFFER_SIZE 512
+
+/// @brief One trace point hit, as stored in the ring
+struct TraceRecord
+{
+    /// @brief HAL::TimeMicros() when it was logged
+    uint64_t timeMicros;
+    /// @brief TraceEvent ID, which picks the format string on the host
+    uint16_t id;
+    uint8_t argCount;
+    int32_t args[TRACE_MAX_ARGS];
+    /// @brief Records this core lost to a full ring since its last one that made it in
+    uint32_t dropsBefore;
+};
+
+/// @brief Deferred binary trace log. A call site stores a small fixed record (ID, timestamp, up to TRACE_MAX_ARGS
+/// @brief integers) and returns; nothing is formatted on the device. The CV rate loop sends the records over USB
+/// @brief serial as they are, and tools/trace_decode.py turns them back into text with the formats in TraceEvents.h.
+/// @note Each core has its own ring, so the cores never contend. A record is pushed with interrupts masked on its own
+/// @note core just for the copy, so interrupts nesting on that core can't interleave half records; the consumer
+/// @note (Drain, core 0) never masks anything. A full ring drops the record and counts it, and the next record that
+/// @note gets in carries the count, which Drain sends as a TRACE_DROPPED record just ahead of it: the decoded log
+/// @note shows exactly where and how many went missing. (Losses with nothing logged after them aren't reported.)
+/// @note Frame: TRACE_SYNC_0, TRACE_SYNC_1, core << 4 | argument count, ID (16 bit), timestamp (64 bit), arguments
+/// @note (32 bit each), checksum (8 bit sum of the bytes between the sync bytes and it). Little endian throughout.
+namespace TraceLog
+{
+    /// @brief Stores a record in the calling core's ring; use the Log overloads
+    void Write(uint16_t id, uint8_t argCount, int32_t arg0, int32_t arg1, int32_t arg2);
+
+    inline void Log(uint16_t id)                                     { Write(id, 0, 0, 0, 0); }
+    inline void Log(uint16_t id, int32_t arg0)                       { Write(id, 1, arg0, 0, 0); }
+    inline void Log(uint16_t id, int32_t arg0, int32_t arg1)         { Write(id, 2, arg0, arg1, 0); }
+    inline void Log(uint16_t id, int32_t arg0, int32_t arg1, int32_t arg2) { Write(id, 3, arg0, arg1, arg2); }
+
+    /// @brief Sends waiting records over USB serial, as many as it takes without waiting. CV rate loop, core 0 only.
+    /// @return records sent, not counting drop reports
+    uint32_t Drain();
+
+    /// @brief Writes one record's frame
+    /// @param frame at least TRACE_FRAME_SIZE(record.argCount) bytes
+    /// @return bytes written
+    uint32_t Encode(const TraceRecord &record, uint8_t core, uint8_t *frame);
+
+    /// @brief Records lost to a full ring so far, over every core
+    uint32_t GetDroppedCount();
+}
@@ -1,9 +1,18 @@
 #pragma once
 
+#ifndef DEBUG_DISABLED
 #define DEBUG_ENABLED
+#endif
 
+#include "TraceEvents.h"
+#include "Util/TraceLog.hpp"
+
+//debug() formats and prints on the spot: slow path only. trace(TRACE_..., up to 3 ints) just stores a record for the
+//CV rate loop to send, so it is fine in the fast path and interrupts; decode it with tools/trace_decode.py
 #ifdef DEBUG_ENABLED
 #define debug(...) printf(__VA_ARGS__)
+#define trace(...) TraceLog::Log(__VA_ARGS__)
 #else
-#define debug(...) ;
-#endif
\ No newline at end of file
+#define debug(...) ((void)0)
+#define trace(...) ((void)0)
+#endif
@@ -12,8 +12,10 @@
 
 #include "Chronos.hpp"
 #include "IO/IOHelper.hpp"
-
-repeating_timer_t *audioRateTimer;
+#include "IO/GateSequencer.hpp"
+#include "IO/CalibrationRoutine.hpp"
+#include "IO/MidiOut.hpp"
+#include "Util/TraceLog.hpp"
 
 uint64_t frameLastMicros = 0;
 uint64_t frameStartMicros = 0;
@@ -21,6 +23,8 @@ uint64_t deltaMicros = 0;
 
 Chronos chronos;
 IOHelper io;
+CalibrationRoutine calibrationRoutine;
+MidiOut midiOut;
 
 void update()
 {
@@ -29,7 +33,9 @@ void update()
     //printf("%d\n", io.CV_scrub );
 
     //--------Call Helper Classes' CV Rate Updates--------
-    chronos.SlowUpdate(deltaMicros);
+    //while calibrating the panel belongs to the routine; chronos keeps running on the last control it was sent
+    if(calibrationRoutine.IsRunning()) calibrationRoutine.Update(io, deltaMicros);
+    else                               chronos.SlowUpdate(deltaMicros);
 
     //--------Write CV Rate Outputs--------
     io.WriteSlowOutputs(deltaMicros);
@@ -38,8 +44,17 @@ void update()
     gpio_put(PICO_DEFAULT_LED_PIN, ((frameStartMicros/1'000) % 1'000) < 500);
 }
 
+#ifdef GATE_OUT_PIO
+//called from the DMA interrupt as each timeline block is refilled
+uint32_t predict_gate_edges(GateEdge *edges, uint32_t maxEdges, uint64_t fromCycle, uint64_t toCycle)
+{
+    return chronos.PredictEdges(edges, maxEdges, fromCycle, toCycle, GateSequencer::GetEpochMicros(), GateSequencer::GetCyclesPerMicro());
+}
+#endif
+
 uint64_t fastLastMicros = 0;
-bool audio_rate_callback(struct repeating_timer *t)
+uint64_t fastTargetMicros = 0;
+int64_t audio_rate_callback()
 {
     uint64_t now = time_us_64();
     uint64_t dt = now - fastLastMicros;
@@ -48,9 +63,46 @@ bool audio_rate_callback(struct repeating_timer *t)
     chronos.FastUpdate(dt);
     io.WriteFastOutputs(dt);
     fastLastMicros = now;
-    return true; //keep doing this
+
+    //--------Sleep until the next gate edge--------
+    //a negative return re-arms relative to when this alarm was due (a positive one would count from when this returns,
+    //adding our lateness and run time to every sleep), so work out the next target from our own "now"
+    uint64_t nextTarget = now + chronos.GetMicrosUntilNextEdge();
+    int64_t delay = int64_t(nextTarget - fastTargetMicros);
+    fastTargetMicros = nextTarget;
+    return delay > 0 ? -delay : -1;
+}
+
+/// @brief Core 1: the time critical path. Clock/reset in edges, FastUpdate and the gate outs, all interrupt driven.
+/// @note Interrupts are enabled on the core that sets them up, so everything on this path is initialized here.
+void core1_entry()
+{
+    //core 0 pauses this core while it writes the calibration to flash
+    multicore_lockout_victim_init();
+
+    //--------Initialize Helper Classes--------
+    io.Init();      //general I/O helper (its gate in edge interrupts land on this core)
+    chronos.Init(&io); //timing handler
+
+    //start chronos; the alarm re-arms itself for each upcoming gate edge (at most CHRONOS_MAX_SLEEP_US apart)
+    fastLastMicros = time_us_64();
+    fastTargetMicros = fastLastMicros + CHRONOS_TICK_US;
+    HAL::AlarmStart(fastTargetMicros, audio_rate_callback);
+#ifdef GATE_OUT_PIO
+    //gate outs are played from a predicted timeline by PIO + DMA, cycle-exact instead of at the next fast update
+    GateSequencer::Init(GATE_OUT_PIN_BASE, predict_gate_edges);
+#endif
+
+    //let core 0 start its loop, then sleep between interrupts
+    multicore_fifo_push_blocking(0);
+    while (true)
+    {
+        __wfi();
+    }
 }
 
+/// @brief Core 0: CV rate inputs, LEDs and USB. Only talks to the fast path through Chronos' mailboxes and the MIDI
+/// @brief FIFOs (clock out from Chronos, clock in to IOHelper, filled by the USB stack on this core).
 int main(void)
 {
     //--------Initialize Clock and StdIO--------
@@ -58,20 +110,23 @@ int main(void)
     busy_wait_ms(200);
     set_sys_clock_khz(280000, true);
     
-    //--------Initialize Helper Classes--------
-    io.Init();      //general I/O helper
-    chronos.Init(&io); //timing handler
+    //--------Start the fast path on core 1--------
+    multicore_launch_core1(core1_entry);
+    multicore_fifo_pop_blocking();
+    io.StartAdcScan(); //knobs and CVs are scanned in the background on this core
     chronos.SetBPM(165);
-
-    //start chronos
-    alarm_pool *chronos_pool = alarm_pool_create(1, 1);
-    audioRateTimer = new repeating_timer_t();
-    alarm_pool_add_repeating_timer_us(chronos_pool, 40, audio_rate_callback, NULL, audioRateTimer); //25kHz (40uS interval)
     
     io.SetLEDState(PanelLED::PlayButton, LEDState::BLINK_SLOW);
+
+    //--------Enter CV Calibration if PLAY is held at power on--------
+    io.ReadSlowInputs(0);
+    if(io.IN_PLAY_BTN) calibrationRoutine.Start(io);
             
     while (true)
     {
+        //--------Send MIDI that has come due (first thing, so it leaves on time)--------
+        uint64_t midiDueMicros = midiOut.Service(chronos.GetMidiEvents(), time_us_64());
+
         //--------Do Timing Variable Updates--------
         frameLastMicros = frameStartMicros;
         frameStartMicros = time_us_64();
@@ -80,9 +135,15 @@ int main(void)
         //--------Run non-time-critical tasks--------
         update();
 
+        //--------Send trace records from both cores (after the update, so its own go out this frame)--------
+        TraceLog::Drain();
+
         //check if boot button is held, and enter boot mode if so
         check_for_reset();
 
-        sleep_us(1000);
+        //sleep for a frame, or until the next MIDI message is due if that's sooner
+        uint64_t now = time_us_64();
+        midiDueMicros = min(midiDueMicros, midiOut.Service(chronos.GetMidiEvents(), now));
+        sleep_us(midiDueMicros > now ? min(midiDueMicros - now, uint64_t(1000)) : 0);
     }
 }
\ No newline at end of file
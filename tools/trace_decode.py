@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#
+
+"""Decodes the firmware's binary trace log (src/Util/TraceLog.hpp) back into text.
+
+Reads the USB serial port's byte stream from a file, stdin or the port itself. Ordinary printf text is passed
+through as it is; trace frames are printed as "[core N]  seconds  message", formatted with the strings in
+src/TraceEvents.h, so the formats only have to live in one place.
+
+    tools/trace_decode.py /dev/ttyACM0        (needs pyserial)
+    tools/trace_decode.py capture.bin
+    cat /dev/ttyACM0 | tools/trace_decode.py
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = b"\xA5\x5A"
+HEADER_SIZE = 2 + 1 + 2 + 8  # sync, core and argument count, ID, timestamp
+MAX_ARGS = 3
+
+DEFAULT_EVENTS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "TraceEvents.h")
+
+
+def load_formats(path):
+    """Event formats by ID, in the order TRACE_EVENTS lists them."""
+    formats = []
+    with open(path) as events:
+        for line in events:
+            match = re.match(r'\s*TRACE_EVENT\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', line)
+            if match:
+                formats.append((match.group(1), match.group(2).encode().decode("unicode_escape")))
+    return formats
+
+
+def frame_size(arg_count):
+    return HEADER_SIZE + 4 * arg_count + 1
+
+
+def format_frame(formats, core, event_id, time_micros, args):
+    if event_id < len(formats):
+        name, text = formats[event_id]
+        try:
+            message = text % tuple(args)
+        except (TypeError, ValueError):
+            message = "%s %s" % (name, args)
+    else:
+        message = "unknown event %d %s" % (event_id, args)
+    return "[core %d] %12.6f  %s" % (core, time_micros / 1e6, message)
+
+
+class Decoder:
+    """Splits the stream into text and frames. A frame only counts once its checksum matches, so text that happens
+    to contain the sync bytes is passed through rather than lost."""
+
+    def __init__(self, formats, out):
+        self.formats = formats
+        self.out = out
+        self.buffer = bytearray()
+        self.bad_frames = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # keep a trailing first sync byte, its partner may be in the next read
+                keep = 1 if self.buffer.endswith(SYNC[:1]) else 0
+                self.text(self.buffer[:len(self.buffer) - keep])
+                del self.buffer[:len(self.buffer) - keep]
+                return
+            self.text(self.buffer[:start])
+            del self.buffer[:start]
+            if len(self.buffer) < 3:
+                return
+            arg_count = self.buffer[2] & 0x0F
+            size = frame_size(arg_count)
+            if arg_count > MAX_ARGS:
+                self.skip()
+                continue
+            if len(self.buffer) < size:
+                return
+            frame = bytes(self.buffer[:size])
+            if sum(frame[2:size - 1]) & 0xFF != frame[size - 1]:
+                self.skip()
+                continue
+            core = frame[2] >> 4
+            event_id, time_micros = struct.unpack_from("<HQ", frame, 3)
+            args = struct.unpack_from("<%di" % arg_count, frame, HEADER_SIZE)
+            self.out.write(format_frame(self.formats, core, event_id, time_micros, args) + "\n")
+            del self.buffer[:size]
+
+    def skip(self):
+        """Not a frame after all: pass the first sync byte through as text and look again after it."""
+        self.bad_frames += 1
+        self.text(self.buffer[:1])
+        del self.buffer[:1]
+
+    def text(self, data):
+        if data:
+            self.out.write(data.decode("utf-8", errors="replace"))
+
+    def finish(self):
+        self.text(self.buffer)
+        self.buffer.clear()
+
+
+def open_input(source):
+    if source == "-":
+        return sys.stdin.buffer
+    if source.startswith("/dev/") or source.upper().startswith("COM"):
+        try:
+            import serial
+        except ImportError:
+            # a tty still reads as a file (set it raw first: stty -F <port> raw)
+            return open(source, "rb", buffering=0)
+        return serial.Serial(source, timeout=0.1)
+    return open(source, "rb")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the KO Clock's binary trace log.")
+    parser.add_argument("source", nargs="?", default="-", help="serial port, capture file, or - for stdin (default)")
+    parser.add_argument("--events", default=DEFAULT_EVENTS, help="TraceEvents.h to take the formats from")
+    options = parser.parse_args()
+
+    decoder = Decoder(load_formats(options.events), sys.stdout)
+    stream = open_input(options.source)
+    try:
+        while True:
+            data = stream.read(4096)
+            if data is None:
+                continue
+            if not data:
+                if hasattr(stream, "in_waiting"):
+                    continue  # a serial port read timed out
+                break
+            decoder.feed(data)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    decoder.finish()
+    if decoder.bad_frames:
+        sys.stderr.write("%d corrupt frames skipped\n" % decoder.bad_frames)
+
+
+if __name__ == "__main__":
+    main()